@@ -0,0 +1,46 @@
+/*
+ * Copyright 2017 Krysta M Bouzek
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <chrono>
+#include <cstddef>
+#include <limits>
+#include <algorithm>
+
+#ifndef KMBNW_ODVB_BENCH_UTIL_H
+#define KMBNW_ODVB_BENCH_UTIL_H
+
+namespace oddvibe {
+    /**
+     * Time a function call.
+     *
+     * \param reps Number of times to call `fn`.
+     * \param fn The function to time.
+     * \return The fastest of `reps` calls, in seconds.
+     */
+    template <typename Function>
+    double best_seconds(const size_t reps, Function fn) {
+        typedef std::chrono::steady_clock clock;
+        double best = std::numeric_limits<double>::max();
+        for (size_t k = 0; k != reps; ++k) {
+            const auto start = clock::now();
+            fn();
+            const std::chrono::duration<double> elapsed = clock::now() - start;
+            best = std::min(best, elapsed.count());
+        }
+        return best;
+    }
+}
+#endif
@@ -0,0 +1,101 @@
+/*
+ * Copyright 2017 Krysta M Bouzek
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <random>
+#include <vector>
+#include <thread>
+#include <cstdlib>
+#include <algorithm>
+#include "../../src/dataset.h"
+#include "../../src/booster.h"
+#include "bench_util.h"
+
+// Compare one long boosting chain with independent chains that share the
+// same total number of rounds, for runtime and for agreement between runs
+// with different seeds.
+// Usage: chains_bench [nrows] [nchains] [nrounds per chain]
+int main(int argc, char **argv) {
+    using namespace oddvibe;
+
+    const size_t nrows = (argc > 1 ? std::atol(argv[1]) : 20000);
+    const size_t nchains = std::max<size_t>(
+        1, (argc > 2 ? std::atol(argv[2]) : 4));
+    const size_t nrounds = (argc > 3 ? std::atol(argv[3]) : 50);
+    const size_t ncols = 4;
+
+    std::mt19937 generator(1480561820L);
+    std::normal_distribution<float> dist(0.0f, 1.0f);
+
+    std::vector<float> xs(nrows * ncols);
+    std::generate(xs.begin(), xs.end(), [&]() { return dist(generator); });
+    std::vector<float> ys(nrows);
+    for (size_t row = 0; row != nrows; ++row) {
+        ys[row] = xs[row] + 2.0f * xs[row + nrows] + 0.1f * dist(generator);
+        // a few gross outliers
+        if (row % 100 == 0) {
+            ys[row] *= 30.0f;
+        }
+    }
+
+    const Dataset<float> data(
+        FloatMatrix<float>(ncols, std::move(xs)), std::move(ys));
+
+    const size_t hw_threads = std::max<unsigned>(
+        1, std::thread::hardware_concurrency());
+
+    std::cout << "chains: " << nrows << " rows, " << nchains << " chains x "
+        << nrounds << " rounds" << std::endl;
+    std::cout << std::setw(10) << "threads" << std::setw(12) << "single"
+        << std::setw(12) << "chains" << std::setw(10) << "speedup"
+        << std::endl;
+    std::cout << std::fixed;
+
+    std::vector<float> single_a, single_b, chains_a, chains_b;
+    for (const size_t nthreads : { size_t(1), hw_threads }) {
+        TreeParams params;
+        params.nthreads = nthreads;
+        const Booster booster(1, params);
+
+        const auto single_secs = best_seconds(1, [&]() {
+            single_a = booster.fit_counts(data, nchains * nrounds);
+        });
+        const auto chains_secs = best_seconds(1, [&]() {
+            chains_a = booster.fit_chains(data, nchains, nrounds);
+        });
+
+        std::cout << std::setw(10) << nthreads << std::setw(12)
+            << std::setprecision(3) << single_secs << std::setw(12)
+            << chains_secs << std::setw(10) << std::setprecision(2)
+            << single_secs / chains_secs << std::endl;
+        if (hw_threads == 1) {
+            break;
+        }
+    }
+
+    // run-to-run agreement: the same methods with a different seed
+    TreeParams params;
+    params.nthreads = hw_threads;
+    const Booster other(1 + nchains, params);
+    single_b = other.fit_counts(data, nchains * nrounds);
+    chains_b = other.fit_chains(data, nchains, nrounds);
+
+    std::cout << "seed-to-seed rank correlation: single "
+        << std::setprecision(3) << rank_correlation(single_a, single_b)
+        << ", chains " << rank_correlation(chains_a, chains_b) << std::endl;
+    return 0;
+}
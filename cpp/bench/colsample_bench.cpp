@@ -0,0 +1,101 @@
+/*
+ * Copyright 2017 Krysta M Bouzek
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <algorithm>
+#include "../../src/params.h"
+#include "../../src/dataset.h"
+#include "../../src/booster.h"
+#include "../../src/math_x.h"
+#include "bench_util.h"
+#include "synthetic_data.h"
+
+// Boost on a wide planted_data() set while drawing a fraction of the
+// columns per tree or per node, and report the time, how well the counts
+// rank the planted outliers, and the rank correlation of the counts with
+// those of a run that searches every column.
+// Usage: colsample_bench [nrows] [ncols] [nrounds] [nthreads]
+int main(int argc, char **argv) {
+    using namespace oddvibe;
+
+    MixtureParams shape;
+    shape.nrows = (argc > 1 ? std::atol(argv[1]) : 10000);
+    shape.ncols = std::max<size_t>(2, (argc > 2 ? std::atol(argv[2]) : 200));
+    const size_t nrounds = (argc > 3 ? std::atol(argv[3]) : 50);
+    const size_t nthreads = (argc > 4 ? std::atol(argv[4]) : 1);
+
+    const auto data = planted_data<float>(shape);
+    const auto outliers = planted_outliers(shape);
+
+    std::cout << "column sampling: " << shape.nrows << " rows x "
+        << shape.ncols << " columns, " << nrounds << " rounds, " << nthreads
+        << " threads" << std::endl;
+    std::cout << std::setw(22) << "draw" << std::setw(10) << "boost s"
+        << std::setw(10) << "speedup" << std::setw(8) << "auc"
+        << std::setw(11) << "precision" << std::setw(11) << "rank corr"
+        << std::endl;
+    std::cout << std::fixed;
+
+    struct Draw {
+        double tree_fraction;
+        double node_fraction;
+    };
+    const std::vector<Draw> draws = {
+        { 1.0, 1.0 },
+        { 0.3, 1.0 }, { 0.1, 1.0 },
+        { 1.0, 0.3 }, { 1.0, 0.1 }
+    };
+
+    for (const auto method : { SplitMethod::exact, SplitMethod::histogram }) {
+        std::vector<float> full_counts;
+        double full_secs = 0;
+        for (const auto& draw : draws) {
+            TreeParams params;
+            params.split_method = method;
+            params.nthreads = nthreads;
+            params.tree_col_fraction = draw.tree_fraction;
+            params.node_col_fraction = draw.node_fraction;
+
+            const Booster booster(shape.seed, params);
+            std::vector<float> counts;
+            const auto boost_secs = best_seconds(1, [&]() {
+                counts = booster.fit_counts(data, nrounds);
+            });
+            if (full_counts.empty()) {
+                full_counts = counts;
+                full_secs = boost_secs;
+            }
+
+            std::ostringstream name;
+            name << (method == SplitMethod::exact ? "exact" : "histogram")
+                << std::setprecision(1) << std::fixed
+                << " t" << draw.tree_fraction << " n" << draw.node_fraction;
+            std::cout << std::setw(22) << name.str()
+                << std::setprecision(3)
+                << std::setw(10) << boost_secs
+                << std::setw(10) << full_secs / boost_secs
+                << std::setw(8) << outlier_auc(counts, outliers)
+                << std::setw(11) << outlier_precision(counts, outliers)
+                << std::setw(11) << rank_correlation(full_counts, counts)
+                << std::endl;
+        }
+    }
+    return 0;
+}
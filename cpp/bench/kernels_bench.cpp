@@ -0,0 +1,132 @@
+/*
+ * Copyright 2017 Krysta M Bouzek
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cmath>
+#include <iostream>
+#include <iomanip>
+#include <random>
+#include <vector>
+#include <string>
+#include <cstdlib>
+#include <numeric>
+#include <algorithm>
+#include <functional>
+#include "../../src/math_x.h"
+#include "../../src/simd_kernels.h"
+#include "bench_util.h"
+
+// Time each per-round kernel for every instruction set this CPU supports,
+// next to the plain standard library loop it replaces.
+// Usage: kernels_bench [nrows]
+int main(int argc, char **argv) {
+    using namespace oddvibe;
+
+    const size_t n = (argc > 1 ? std::atol(argv[1]) : 10000000);
+
+    std::mt19937 generator(1480561820L);
+    std::normal_distribution<float> dist(0.0f, 1.0f);
+    std::vector<float> ys(n), yhats(n), pmf(n, 1.0f / n);
+    std::generate(ys.begin(), ys.end(), [&]() { return dist(generator); });
+    std::generate(yhats.begin(), yhats.end(), [&]() { return dist(generator); });
+    std::vector<double> loss(n);
+    std::vector<float> scratch(pmf);
+
+    const double max_loss = 20.0;
+    const double beta = 0.4;
+    volatile double sink = 0;
+
+    typedef std::function<void()> Kernel;
+    const auto run = [&](const char* name, const Kernel& library,
+            const std::function<Kernel(const SimdKernels&)>& simd) {
+        const double base = best_seconds(5, library);
+        std::cout << std::setw(18) << name << std::setw(12) << base * 1e3;
+        for (const auto level : {
+                SimdLevel::scalar, SimdLevel::avx2, SimdLevel::avx512 }) {
+            const SimdKernels* kernels = simd_kernels(level);
+            if (kernels == nullptr) {
+                std::cout << std::setw(12) << "-";
+            } else {
+                std::cout << std::setw(12) << best_seconds(5, simd(*kernels)) * 1e3;
+            }
+        }
+        std::cout << std::endl;
+    };
+
+    std::cout << "milliseconds for " << n << " rows; dispatch picks "
+        << simd_level_name(simd_kernels().level) << std::endl;
+    std::cout << std::setw(18) << "kernel" << std::setw(12) << "library"
+        << std::setw(12) << "scalar" << std::setw(12) << "avx2"
+        << std::setw(12) << "avx512" << std::endl;
+    std::cout << std::fixed << std::setprecision(2);
+
+    run("squared_error",
+        [&]() {
+            std::transform(
+                yhats.begin(), yhats.end(), ys.begin(), loss.begin(),
+                mse_err<float>);
+        },
+        [&](const SimdKernels& k) -> Kernel {
+            return [&]() {
+                k.squared_error_f32(ys.data(), yhats.data(), loss.data(), n);
+            };
+        });
+
+    run("max_value",
+        [&]() { sink = *std::max_element(loss.begin(), loss.end()); },
+        [&](const SimdKernels& k) -> Kernel {
+            return [&]() { sink = k.max_value(loss.data(), n); };
+        });
+
+    run("dot",
+        [&]() {
+            double epsilon = 0;
+            for (size_t j = 0; j != n; ++j) {
+                epsilon += pmf[j] * loss[j];
+            }
+            sink = epsilon;
+        },
+        [&](const SimdKernels& k) -> Kernel {
+            return [&]() { sink = k.dot(pmf.data(), loss.data(), n); };
+        });
+
+    run("reweight",
+        [&]() {
+            std::transform(
+                scratch.begin(), scratch.end(), loss.begin(), scratch.begin(),
+                [&](float pmf_k, double loss_k) {
+                    return (float) (pow(beta, 1 - loss_k / max_loss) * pmf_k);
+                });
+        },
+        [&](const SimdKernels& k) -> Kernel {
+            return [&]() {
+                k.reweight(scratch.data(), loss.data(), n, std::log(beta), max_loss);
+            };
+        });
+
+    run("normalize",
+        [&]() {
+            const auto norm = std::accumulate(scratch.begin(), scratch.end(), 0.0);
+            std::transform(
+                scratch.begin(), scratch.end(), scratch.begin(),
+                [norm](float f) { return f / norm; });
+        },
+        [&](const SimdKernels& k) -> Kernel {
+            return [&]() {
+                k.divide(scratch.data(), n, k.sum(scratch.data(), n));
+            };
+        });
+    return 0;
+}
@@ -0,0 +1,111 @@
+/*
+ * Copyright 2017 Krysta M Bouzek
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <numeric>
+#include <cstdlib>
+#include <algorithm>
+#include "../../src/params.h"
+#include "../../src/dataset.h"
+#include "../../src/rtree.h"
+#include "../../src/flat_tree.h"
+#include "../../src/oblivious_tree.h"
+#include "../../src/booster.h"
+#include "bench_util.h"
+#include "synthetic_data.h"
+
+// Compare RTree and ObliviousTree as the weak learner: time to fit and
+// predict one tree, time for a whole boosting run, and how well the
+// boosted counts rank the outliers of planted_data().
+// Usage: learner_bench [nrows] [ncols] [nrounds] [nthreads]
+int main(int argc, char **argv) {
+    using namespace oddvibe;
+
+    MixtureParams shape;
+    shape.nrows = (argc > 1 ? std::atol(argv[1]) : 20000);
+    shape.ncols = std::max<size_t>(2, (argc > 2 ? std::atol(argv[2]) : 8));
+    const size_t nrounds = (argc > 3 ? std::atol(argv[3]) : 50);
+    const size_t nthreads = (argc > 4 ? std::atol(argv[4]) : 1);
+
+    const auto data = planted_data<float>(shape);
+    const auto outliers = planted_outliers(shape);
+    std::vector<size_t> seq(shape.nrows);
+    std::iota(seq.begin(), seq.end(), 0);
+    std::vector<float> yhats(shape.nrows);
+
+    std::cout << "learners: " << shape.nrows << " rows x " << shape.ncols
+        << " columns, " << nrounds << " rounds, " << nthreads << " threads"
+        << std::endl;
+    std::cout << std::setw(22) << "learner" << std::setw(10) << "fit ms"
+        << std::setw(12) << "predict ms" << std::setw(10) << "boost s"
+        << std::setw(8) << "auc" << std::setw(11) << "precision"
+        << std::endl;
+    std::cout << std::fixed;
+
+    for (const auto method : { SplitMethod::exact, SplitMethod::histogram }) {
+        for (const auto kind : { TreeKind::rtree, TreeKind::oblivious }) {
+            TreeParams params;
+            params.split_method = method;
+            params.tree_kind = kind;
+            params.nthreads = nthreads;
+
+            double fit_secs = 0;
+            double predict_secs = 0;
+            if (kind == TreeKind::rtree) {
+                const typename RTree<float>::Trainer trainer(params);
+                std::unique_ptr<RTree<float>> tree;
+                fit_secs = best_seconds(3, [&]() {
+                    tree = trainer.fit(data, seq.begin(), seq.end(), 0);
+                });
+                const FlatTree<float> flat_tree(*tree);
+                predict_secs = best_seconds(3, [&]() {
+                    flat_tree.predict(data.xs(), 0, shape.nrows, yhats.data());
+                });
+            } else {
+                const typename ObliviousTree<float>::Trainer trainer(params);
+                ObliviousTree<float> tree;
+                fit_secs = best_seconds(3, [&]() {
+                    tree = trainer.fit(data, seq.begin(), seq.end());
+                });
+                predict_secs = best_seconds(3, [&]() {
+                    tree.predict(data.xs(), 0, shape.nrows, yhats.data());
+                });
+            }
+
+            const Booster booster(shape.seed, params);
+            std::vector<float> counts;
+            const auto boost_secs = best_seconds(1, [&]() {
+                counts = booster.fit_counts(data, nrounds);
+            });
+
+            const std::string name = (
+                std::string(kind == TreeKind::rtree ? "rtree" : "oblivious") +
+                (method == SplitMethod::exact ? " exact" : " histogram"));
+            std::cout << std::setw(22) << name
+                << std::setprecision(3)
+                << std::setw(10) << fit_secs * 1e3
+                << std::setw(12) << predict_secs * 1e3
+                << std::setw(10) << boost_secs
+                << std::setprecision(3)
+                << std::setw(8) << outlier_auc(counts, outliers)
+                << std::setw(11) << outlier_precision(counts, outliers)
+                << std::endl;
+        }
+    }
+    return 0;
+}
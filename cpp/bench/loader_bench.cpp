@@ -0,0 +1,92 @@
+/*
+ * Copyright 2017 Krysta M Bouzek
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cstdio>
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <random>
+#include <vector>
+#include <thread>
+#include <cstdlib>
+#include <algorithm>
+#include "../../src/data_loader.h"
+#include "../../src/thread_pool.h"
+#include "bench_util.h"
+
+// Load throughput of the chunked CSV and raw loaders for a generated file,
+// on one thread and on every core.
+// Usage: loader_bench [nrows] [ncols]
+int main(int argc, char **argv) {
+    using namespace oddvibe;
+
+    const size_t nrows = (argc > 1 ? std::atol(argv[1]) : 500000);
+    const size_t ncols = (argc > 2 ? std::atol(argv[2]) : 10);
+    const std::string csv_path = "loader_bench.csv";
+    const std::string raw_path = "loader_bench.raw";
+
+    {
+        std::mt19937 generator(1480561820L);
+        std::normal_distribution<double> dist(0.0, 1.0);
+        std::ofstream csv(csv_path, std::ios::binary | std::ios::trunc);
+        std::ofstream raw(raw_path, std::ios::binary | std::ios::trunc);
+        csv << std::setprecision(7);
+        for (size_t row = 0; row != nrows; ++row) {
+            for (size_t col = 0; col <= ncols; ++col) {
+                const double value = dist(generator);
+                csv << (col > 0 ? "," : "") << value;
+                raw.write(reinterpret_cast<const char*>(&value), sizeof(value));
+            }
+            csv << '\n';
+        }
+    }
+
+    const size_t hw_threads = std::max<unsigned>(
+        1, std::thread::hardware_concurrency());
+    std::vector<size_t> thread_counts { 1 };
+    if (hw_threads > 1) {
+        thread_counts.push_back(hw_threads);
+    }
+
+    std::cout << std::setw(8) << "format" << std::setw(10) << "threads"
+        << std::setw(12) << "MB/s" << std::endl;
+    std::cout << std::fixed << std::setprecision(1);
+
+    for (const auto nthreads : thread_counts) {
+        ThreadPool pool(nthreads);
+        LoadStats stats;
+        double best = 0;
+
+        best_seconds(3, [&]() {
+            load_csv<double>(csv_path, CsvOptions(), &pool, &stats);
+            best = std::max(best, stats.mb_per_sec());
+        });
+        std::cout << std::setw(8) << "csv" << std::setw(10) << nthreads
+            << std::setw(12) << best << std::endl;
+
+        best = 0;
+        best_seconds(3, [&]() {
+            load_raw<double>(raw_path, ncols, &pool, &stats);
+            best = std::max(best, stats.mb_per_sec());
+        });
+        std::cout << std::setw(8) << "raw" << std::setw(10) << nthreads
+            << std::setw(12) << best << std::endl;
+    }
+
+    std::remove(csv_path.c_str());
+    std::remove(raw_path.c_str());
+    return 0;
+}
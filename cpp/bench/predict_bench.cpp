@@ -0,0 +1,116 @@
+/*
+ * Copyright 2017 Krysta M Bouzek
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <random>
+#include <vector>
+#include <string>
+#include <numeric>
+#include <cstdlib>
+#include <algorithm>
+#include "../../src/dataset.h"
+#include "../../src/rtree.h"
+#include "../../src/flat_tree.h"
+#include "../../src/predictor.h"
+#include "../../src/thread_pool.h"
+#include "bench_util.h"
+
+// Compare RTree::predict with FlatTree predictions for a depth 6 tree, and
+// time the blocked engine on one thread and on `nthreads` (0 for one per
+// core).
+// Usage: predict_bench [nrows] [ncols] [nthreads]
+int main(int argc, char **argv) {
+    using namespace oddvibe;
+
+    const size_t nrows = (argc > 1 ? std::atol(argv[1]) : 1000000);
+    const size_t ncols = std::max<size_t>(
+        3, (argc > 2 ? std::atol(argv[2]) : 8));
+    const size_t nthreads = (argc > 3 ? std::atol(argv[3]) : 0);
+
+    std::mt19937 generator(1480561820L);
+    std::normal_distribution<float> dist(0.0f, 1.0f);
+
+    std::vector<float> xs(nrows * ncols);
+    std::generate(xs.begin(), xs.end(), [&]() { return dist(generator); });
+    std::vector<float> ys(nrows);
+    // a linear response splits near the median, so rows go both ways
+    for (size_t row = 0; row != nrows; ++row) {
+        ys[row] = (
+            xs[row] + 2.0f * xs[row + nrows] + xs[row + 2 * nrows] +
+            dist(generator));
+    }
+
+    const Dataset<float> data(
+        FloatMatrix<float>(ncols, std::move(xs)), std::move(ys));
+
+    // fit on a subset; prediction cost does not depend on the fit
+    std::vector<size_t> seq(std::min<size_t>(nrows, 50000));
+    std::iota(seq.begin(), seq.end(), 0);
+    const typename RTree<float>::Trainer trainer(6);
+    const auto tree = trainer.fit(data, seq.begin(), seq.end(), 0);
+    const FlatTree<float> flat_tree(*tree);
+
+    std::vector<float> out(nrows);
+    const auto pointer_secs = best_seconds(3, [&]() {
+        out = tree->predict(data.xs());
+    });
+    const auto row_secs = best_seconds(3, [&]() {
+        for (size_t row = 0; row != nrows; ++row) {
+            out[row] = flat_tree.predict(data.xs(), row);
+        }
+    });
+    const auto block_secs = best_seconds(3, [&]() {
+        flat_tree.predict(data.xs(), 0, nrows, out.data());
+    });
+    BlockPredictor<float> serial;
+    const auto serial_secs = best_seconds(3, [&]() {
+        serial.predict(flat_tree, data.xs(), out.data());
+    });
+    ThreadPool pool(nthreads);
+    BlockPredictor<float> threaded(&pool);
+    const auto threaded_secs = best_seconds(3, [&]() {
+        threaded.predict(flat_tree, data.xs(), out.data());
+    });
+    const auto threads_label = (
+        "Blocked " + std::to_string(pool.size()) + "t");
+
+    std::cout << "predict: " << nrows << " rows x " << ncols << " columns, "
+        << flat_tree.size() << " nodes" << std::endl;
+    std::cout << std::setw(16) << "method" << std::setw(12) << "seconds"
+        << std::setw(10) << "speedup" << std::endl;
+    std::cout << std::fixed;
+    std::cout << std::setw(16) << "RTree" << std::setw(12)
+        << std::setprecision(4) << pointer_secs
+        << std::setw(10) << std::setprecision(2) << 1.0 << std::endl;
+    std::cout << std::setw(16) << "FlatTree row" << std::setw(12)
+        << std::setprecision(4) << row_secs
+        << std::setw(10) << std::setprecision(2) << pointer_secs / row_secs
+        << std::endl;
+    std::cout << std::setw(16) << "FlatTree block" << std::setw(12)
+        << std::setprecision(4) << block_secs
+        << std::setw(10) << std::setprecision(2) << pointer_secs / block_secs
+        << std::endl;
+    std::cout << std::setw(16) << "Blocked 1t" << std::setw(12)
+        << std::setprecision(4) << serial_secs
+        << std::setw(10) << std::setprecision(2) << pointer_secs / serial_secs
+        << std::endl;
+    std::cout << std::setw(16) << threads_label << std::setw(12)
+        << std::setprecision(4) << threaded_secs
+        << std::setw(10) << std::setprecision(2) << pointer_secs / threaded_secs
+        << std::endl;
+    return 0;
+}
@@ -0,0 +1,71 @@
+/*
+ * Copyright 2017 Krysta M Bouzek
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <cstdlib>
+#include "../../src/sampling_dist.h"
+#include "../../src/ecdf_sampler.h"
+#include "../../src/alias_sampler.h"
+#include "bench_util.h"
+
+// Compare EmpiricalSampler with AliasSampler for one boosting round's
+// worth of draws from a skewed distribution.
+// Usage: sampler_bench [nrows ...]
+int main(int argc, char **argv) {
+    using namespace oddvibe;
+
+    std::vector<size_t> sizes;
+    for (int k = 1; k < argc; ++k) {
+        sizes.push_back(std::atol(argv[k]));
+    }
+    if (sizes.empty()) {
+        sizes = {1000000, 10000000};
+    }
+
+    std::cout << std::setw(10) << "rows" << std::setw(14) << "empirical"
+        << std::setw(12) << "alias" << std::setw(10) << "speedup" << std::endl;
+    std::cout << std::fixed;
+
+    for (const auto nrows : sizes) {
+        // a few boosting-like reweights so the pmf is far from uniform
+        SamplingDist pmf(nrows);
+        std::vector<double> loss(nrows);
+        for (size_t k = 0; k != nrows; ++k) {
+            loss[k] = (k % 7 == 0 ? 1.0 : (k % 100) / 400.0);
+        }
+        pmf.adjust_for_loss(loss);
+        pmf.adjust_for_loss(loss);
+
+        EmpiricalSampler empirical(1480561820L);
+        AliasSampler alias(1480561820L);
+        std::vector<size_t> samples;
+
+        const auto empirical_secs = best_seconds(3, [&]() {
+            samples = empirical.gen_samples(nrows, pmf);
+        });
+        const auto alias_secs = best_seconds(3, [&]() {
+            alias.gen_samples(nrows, pmf, samples);
+        });
+
+        std::cout << std::setw(10) << nrows << std::setw(14)
+            << std::setprecision(4) << empirical_secs << std::setw(12)
+            << alias_secs << std::setw(10) << std::setprecision(2)
+            << empirical_secs / alias_secs << std::endl;
+    }
+    return 0;
+}
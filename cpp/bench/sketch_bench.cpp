@@ -0,0 +1,100 @@
+/*
+ * Copyright 2017 Krysta M Bouzek
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <algorithm>
+#include "../../src/params.h"
+#include "../../src/dataset.h"
+#include "../../src/binned_matrix.h"
+#include "../../src/quantile_sketch.h"
+#include "../../src/booster.h"
+#include "../../src/math_x.h"
+#include "bench_util.h"
+#include "synthetic_data.h"
+
+// Compare histogram bin edges found by sorting every column with edges
+// taken from per-column quantile sketches: time and memory to find them,
+// and how well boosting on the resulting bins ranks the outliers of
+// planted_data().
+// Usage: sketch_bench [nrows] [ncols] [nrounds] [nthreads]
+int main(int argc, char **argv) {
+    using namespace oddvibe;
+
+    MixtureParams shape;
+    shape.nrows = (argc > 1 ? std::atol(argv[1]) : 1000000);
+    shape.ncols = std::max<size_t>(2, (argc > 2 ? std::atol(argv[2]) : 8));
+    const size_t nrounds = (argc > 3 ? std::atol(argv[3]) : 20);
+    const size_t nthreads = (argc > 4 ? std::atol(argv[4]) : 1);
+    const size_t max_bins = 255;
+
+    const auto data = planted_data<float>(shape);
+    const auto outliers = planted_outliers(shape);
+    ThreadPool pool(nthreads);
+
+    std::cout << "sketched bins: " << shape.nrows << " rows x " << shape.ncols
+        << " columns, " << nrounds << " rounds, " << nthreads << " threads"
+        << std::endl;
+    std::cout << std::setw(10) << "edges" << std::setw(10) << "bin s"
+        << std::setw(14) << "kept/column" << std::setw(10) << "boost s"
+        << std::setw(8) << "auc" << std::setw(11) << "precision"
+        << std::setw(11) << "rank corr" << std::endl;
+    std::cout << std::fixed;
+
+    std::vector<float> sorted_counts;
+    for (const size_t sketch_k : { 0, 400, 200, 64 }) {
+        // sorting holds a copy of a whole column; a sketch holds `kept`
+        size_t kept = shape.nrows;
+        const auto bin_secs = best_seconds(1, [&]() {
+            if (sketch_k == 0) {
+                const BinnedMatrix<float> bins(data.xs(), max_bins);
+            } else {
+                const auto sketches = data.column_sketches(sketch_k, &pool);
+                kept = sketches[0].size();
+                const BinnedMatrix<float> bins(data.xs(), max_bins, sketches);
+            }
+        });
+
+        TreeParams params;
+        params.split_method = SplitMethod::histogram;
+        params.max_bins = max_bins;
+        params.sketch_k = sketch_k;
+        params.nthreads = nthreads;
+        const Booster booster(shape.seed, params);
+        std::vector<float> counts;
+        const auto boost_secs = best_seconds(1, [&]() {
+            counts = booster.fit_counts(data, nrounds);
+        });
+        if (sorted_counts.empty()) {
+            sorted_counts = counts;
+        }
+
+        const std::string name = (
+            sketch_k == 0 ? "sorted" : "k=" + std::to_string(sketch_k));
+        std::cout << std::setw(10) << name
+            << std::setprecision(3)
+            << std::setw(10) << bin_secs
+            << std::setw(14) << kept
+            << std::setw(10) << boost_secs
+            << std::setw(8) << outlier_auc(counts, outliers)
+            << std::setw(11) << outlier_precision(counts, outliers)
+            << std::setw(11) << rank_correlation(sorted_counts, counts)
+            << std::endl;
+    }
+    return 0;
+}
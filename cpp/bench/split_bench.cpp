@@ -0,0 +1,80 @@
+/*
+ * Copyright 2017 Krysta M Bouzek
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <random>
+#include <vector>
+#include <numeric>
+#include <thread>
+#include <cstdlib>
+#include "../../src/dataset.h"
+#include "../../src/split_point.h"
+#include "../../src/thread_pool.h"
+#include "bench_util.h"
+
+// Time best_split on the root node of a random dataset as the number of
+// threads grows.  Usage: split_bench [nrows] [ncols]
+int main(int argc, char **argv) {
+    using namespace oddvibe;
+
+    const size_t nrows = (argc > 1 ? std::atol(argv[1]) : 1000000);
+    const size_t ncols = (argc > 2 ? std::atol(argv[2]) : 16);
+
+    std::mt19937 generator(1480561820L);
+    std::normal_distribution<float> dist(0.0f, 1.0f);
+
+    std::vector<float> xs(nrows * ncols);
+    std::generate(xs.begin(), xs.end(), [&]() { return dist(generator); });
+    std::vector<float> ys(nrows);
+    for (size_t row = 0; row != nrows; ++row) {
+        ys[row] = xs[row] + 2.0f * xs[row + nrows] + dist(generator);
+    }
+
+    const Dataset<float> data(
+        FloatMatrix<float>(ncols, std::move(xs)), std::move(ys));
+
+    std::vector<size_t> seq(nrows);
+    std::iota(seq.begin(), seq.end(), 0);
+    const auto y_center = mean<float>(data.ys(), seq.begin(), seq.end());
+
+    SortedColumns cols;
+    cols.assign(data.column_index(), seq.begin(), seq.end());
+
+    std::cout << "best_split: " << nrows << " rows x " << ncols << " columns"
+        << std::endl;
+    std::cout << std::setw(8) << "threads" << std::setw(12) << "seconds"
+        << std::setw(10) << "speedup" << std::endl;
+
+    const size_t max_threads = std::max(
+        4u, std::thread::hardware_concurrency());
+    double serial = 0;
+
+    for (size_t nthreads = 1; nthreads <= max_threads; nthreads *= 2) {
+        ThreadPool pool(nthreads);
+        const auto secs = best_seconds(3, [&]() {
+            best_split(data, cols, 0, nrows, y_center, &pool);
+        });
+        if (nthreads == 1) {
+            serial = secs;
+        }
+        std::cout << std::setw(8) << nthreads
+            << std::setw(12) << std::fixed << std::setprecision(4) << secs
+            << std::setw(10) << std::setprecision(2) << serial / secs
+            << std::endl;
+    }
+    return 0;
+}
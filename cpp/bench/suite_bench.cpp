@@ -0,0 +1,315 @@
+/*
+ * Copyright 2017 Krysta M Bouzek
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <numeric>
+#include <cstdlib>
+#include <unistd.h>
+#include "../../src/params.h"
+#include "../../src/dataset.h"
+#include "../../src/split_point.h"
+#include "../../src/histogram.h"
+#include "../../src/rtree.h"
+#include "../../src/flat_tree.h"
+#include "../../src/oblivious_tree.h"
+#include "../../src/predictor.h"
+#include "../../src/thread_pool.h"
+#include "../../src/sampling_dist.h"
+#include "../../src/ecdf_sampler.h"
+#include "../../src/alias_sampler.h"
+#include "../../src/booster.h"
+#include "bench_util.h"
+#include "synthetic_data.h"
+
+namespace {
+    using namespace oddvibe;
+
+    void usage(const char* prog) {
+        std::cerr << "Usage: " << prog << " [options]\n"
+            << "Time split search, tree fitting, prediction, sampling and "
+            << "boosting over a sweep\nof synthetic datasets and write one "
+            << "CSV line per measurement.\n\n"
+            << "  -q         quick sweep of small datasets\n"
+            << "  -r REPS    repetitions per measurement; the fastest is "
+            << "kept (default 3)\n"
+            << "  -f NAME    only run benchmarks whose name contains NAME\n"
+            << "  -l LABEL   value of the label column, e.g. a version "
+            << "(default dev)\n"
+            << "  -o FILE    write to FILE instead of standard output\n";
+    }
+
+    /**
+     * Writes results as CSV, one line per (benchmark, variant, dataset).
+     */
+    class Results {
+        public:
+            Results(
+                    std::ostream& out,
+                    const std::string& label,
+                    const std::string& filter,
+                    const size_t reps) :
+                m_out(out),
+                m_label(label),
+                m_filter(filter),
+                m_reps(reps) {
+                m_out << "label,benchmark,variant,nrows,ncols,cardinality,"
+                    << "reps,seconds,mrows_per_sec" << std::endl;
+            }
+
+            bool wants(const std::string& benchmark) const {
+                return benchmark.find(m_filter) != std::string::npos;
+            }
+
+            /**
+             * Time `fn` and write a line for it; `shape.nrows` rows are
+             * processed per call.
+             */
+            template <typename Function>
+            void run(
+                    const std::string& benchmark,
+                    const std::string& variant,
+                    const MixtureParams& shape,
+                    Function fn) {
+                if (!wants(benchmark)) {
+                    return;
+                }
+                const auto secs = best_seconds(m_reps, fn);
+                m_out << m_label << ',' << benchmark << ',' << variant << ','
+                    << shape.nrows << ',' << shape.ncols << ','
+                    << shape.cardinality << ',' << m_reps << ','
+                    << secs << ',' << shape.nrows / secs / 1e6 << std::endl;
+            }
+
+        private:
+            std::ostream& m_out;
+            std::string m_label;
+            std::string m_filter;
+            size_t m_reps;
+    };
+
+    /**
+     * Benchmarks that depend on the shape of the feature matrix.
+     */
+    void bench_shape(Results& results, const MixtureParams& shape) {
+        const auto data = mixture_data<float>(shape);
+        const auto nrows = shape.nrows;
+        std::vector<size_t> seq(nrows);
+        std::iota(seq.begin(), seq.end(), 0);
+
+        TreeParams exact;
+        TreeParams binned;
+        binned.split_method = SplitMethod::histogram;
+
+        // build the caches fit() would otherwise build on first use
+        const auto binned_xs = data.bins(binned.max_bins);
+        const auto& bins = *binned_xs;
+        SortedColumns cols;
+        cols.assign(data.column_index(), seq.begin(), seq.end());
+        const auto y_center = mean<float>(data.ys(), seq.begin(), seq.end());
+
+        results.run("best_split", "exact", shape, [&]() {
+            best_split(data, cols, 0, nrows, y_center);
+        });
+        Histogram hist(bins.total_slots());
+        results.run("best_split", "histogram", shape, [&]() {
+            hist.reset(bins.total_slots());
+            hist.add(bins, data.ys(), y_center, seq.begin(), seq.end());
+            best_split(bins, hist);
+        });
+
+        const typename RTree<float>::Trainer exact_trainer(exact);
+        const typename RTree<float>::Trainer binned_trainer(binned);
+        results.run("fit", "exact", shape, [&]() {
+            exact_trainer.fit(data, seq.begin(), seq.end(), 0);
+        });
+        results.run("fit", "histogram", shape, [&]() {
+            binned_trainer.fit(data, seq.begin(), seq.end(), 0);
+        });
+        const typename ObliviousTree<float>::Trainer oblivious_trainer(exact);
+        results.run("fit", "oblivious", shape, [&]() {
+            oblivious_trainer.fit(data, seq.begin(), seq.end());
+        });
+
+        if (results.wants("predict")) {
+            const auto tree = exact_trainer.fit(data, seq.begin(), seq.end(), 0);
+            const FlatTree<float> flat_tree(*tree);
+            std::vector<float> yhats(nrows);
+            results.run("predict", "rtree", shape, [&]() {
+                yhats = tree->predict(data.xs());
+            });
+            results.run("predict", "flat", shape, [&]() {
+                flat_tree.predict(data.xs(), 0, nrows, yhats.data());
+            });
+            const auto oblivious_tree = oblivious_trainer.fit(
+                data, seq.begin(), seq.end());
+            results.run("predict", "oblivious", shape, [&]() {
+                oblivious_tree.predict(data.xs(), 0, nrows, yhats.data());
+            });
+
+            // one thread per core, and a batch of trees sharing each block
+            ThreadPool pool(0);
+            BlockPredictor<float> predictor(&pool);
+            const auto threads = std::to_string(pool.size());
+            results.run("predict", "blocked_" + threads + "t", shape, [&]() {
+                predictor.predict(flat_tree, data.xs(), yhats.data());
+            });
+            const std::vector<FlatTree<float>> batch(8, flat_tree);
+            std::vector<float> batch_yhats(batch.size() * nrows);
+            results.run("predict", "batch8_" + threads + "t", shape, [&]() {
+                predictor.predict(batch, data.xs(), batch_yhats.data());
+            });
+        }
+    }
+
+    /**
+     * Benchmarks of whole boosting runs.
+     */
+    void bench_boost(Results& results, const MixtureParams& shape) {
+        if (!results.wants("fit_counts")) {
+            return;
+        }
+        const auto data = mixture_data<float>(shape);
+        const size_t nrounds = 10;
+
+        TreeParams params;
+        const Booster exact(shape.seed, params);
+        params.split_method = SplitMethod::histogram;
+        const Booster binned(shape.seed, params);
+        params.split_method = SplitMethod::exact;
+        params.tree_kind = TreeKind::oblivious;
+        const Booster oblivious(shape.seed, params);
+
+        // every variant is timed once the Dataset caches are built
+        exact.fit_counts(data, 1);
+        binned.fit_counts(data, 1);
+
+        results.run("fit_counts", "exact", shape, [&]() {
+            exact.fit_counts(data, nrounds);
+        });
+        results.run("fit_counts", "histogram", shape, [&]() {
+            binned.fit_counts(data, nrounds);
+        });
+        results.run("fit_counts", "alias", shape, [&]() {
+            exact.fit_counts<float, AliasSampler>(data, nrounds);
+        });
+        results.run("fit_counts", "oblivious", shape, [&]() {
+            oblivious.fit_counts(data, nrounds);
+        });
+    }
+
+    /**
+     * Benchmarks that depend on the number of rows only.
+     */
+    void bench_rows(Results& results, const size_t nrows) {
+        MixtureParams shape;
+        shape.nrows = nrows;
+        shape.ncols = 0;
+
+        // a few boosting-like reweights so the pmf is far from uniform
+        SamplingDist pmf(nrows);
+        std::vector<double> loss(nrows);
+        for (size_t k = 0; k != nrows; ++k) {
+            loss[k] = (k % 7 == 0 ? 1.0 : (k % 100) / 400.0);
+        }
+        pmf.adjust_for_loss(loss);
+        pmf.adjust_for_loss(loss);
+
+        EmpiricalSampler empirical(shape.seed);
+        AliasSampler alias(shape.seed);
+        std::vector<size_t> samples;
+        results.run("gen_samples", "empirical", shape, [&]() {
+            empirical.gen_samples(nrows, pmf, samples);
+        });
+        results.run("gen_samples", "alias", shape, [&]() {
+            alias.gen_samples(nrows, pmf, samples);
+        });
+
+        // alternate two losses so the distribution stays away from uniform
+        std::vector<double> other(loss.rbegin(), loss.rend());
+        bool flip = false;
+        results.run("adjust_for_loss", "simd", shape, [&]() {
+            pmf.adjust_for_loss(flip ? other : loss);
+            flip = !flip;
+        });
+    }
+}
+
+// Benchmark suite over row counts, column counts and feature cardinalities;
+// mrows_per_sec is nrows over the fastest time of one call.
+// Usage: suite_bench [-q] [-r reps] [-f name] [-l label] [-o file]
+int main(int argc, char **argv) {
+    bool quick = false;
+    size_t reps = 3;
+    std::string filter;
+    std::string label = "dev";
+    std::string path;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "qr:f:l:o:")) != -1) {
+        switch (opt) {
+            case 'q': quick = true; break;
+            case 'r': reps = std::max(1L, std::atol(optarg)); break;
+            case 'f': filter = optarg; break;
+            case 'l': label = optarg; break;
+            case 'o': path = optarg; break;
+            default: usage(argv[0]); return 2;
+        }
+    }
+    if (optind != argc) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    const std::vector<size_t> row_counts = (
+        quick ? std::vector<size_t>{1000, 10000} :
+        std::vector<size_t>{10000, 100000, 1000000});
+    const std::vector<size_t> col_counts = (
+        quick ? std::vector<size_t>{2, 8} : std::vector<size_t>{4, 16});
+    const std::vector<size_t> cardinalities = (
+        quick ? std::vector<size_t>{0, 8} : std::vector<size_t>{0, 32});
+    // whole boosting runs are only timed on the smaller datasets
+    const size_t max_boost_rows = (quick ? 10000 : 100000);
+
+    std::ofstream file;
+    if (!path.empty()) {
+        file.open(path);
+        if (!file) {
+            std::cerr << argv[0] << ": cannot write " << path << std::endl;
+            return 1;
+        }
+    }
+    Results results((path.empty() ? std::cout : file), label, filter, reps);
+
+    for (const auto nrows : row_counts) {
+        bench_rows(results, nrows);
+        for (const auto ncols : col_counts) {
+            for (const auto cardinality : cardinalities) {
+                MixtureParams shape;
+                shape.nrows = nrows;
+                shape.ncols = ncols;
+                shape.cardinality = cardinality;
+                bench_shape(results, shape);
+                if (nrows <= max_boost_rows) {
+                    bench_boost(results, shape);
+                }
+            }
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,255 @@
+/*
+ * Copyright 2017 Krysta M Bouzek
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cstddef>
+#include <cmath>
+#include <random>
+#include <vector>
+#include <numeric>
+#include <algorithm>
+#include <stdexcept>
+#include "../../src/float_matrix.h"
+#include "../../src/dataset.h"
+
+#ifndef KMBNW_ODVB_SYNTHETIC_DATA_H
+#define KMBNW_ODVB_SYNTHETIC_DATA_H
+
+namespace oddvibe {
+    /**
+     * Shape of a synthetic dataset; see mixture_data().
+     */
+    struct MixtureParams {
+        size_t nrows = 10000;
+
+        /**
+         * Number of features, at least 2.  Only the first two enter the
+         * response; the rest are noise for the split search to reject.
+         */
+        size_t ncols = 2;
+
+        /**
+         * Number of distinct values per feature, or 0 for continuous
+         * features.
+         */
+        size_t cardinality = 0;
+
+        size_t seed = 1480561820L;
+    };
+
+    /**
+     * Spread the values of a column evenly over `cardinality` levels
+     * between its min and max.
+     */
+    template <typename FloatT>
+    void quantize_column(
+            FloatT* const first,
+            FloatT* const last,
+            const size_t cardinality) {
+        if (cardinality < 1 || first == last) {
+            return;
+        }
+        const auto range = std::minmax_element(first, last);
+        const double lo = *range.first;
+        const double hi = *range.second;
+        const double step = (
+            cardinality > 1 && hi > lo ? (hi - lo) / (cardinality - 1) : 0);
+        for (auto value = first; value != last; ++value) {
+            const double level = (
+                step > 0 ? std::round((*value - lo) / step) : 0);
+            *value = static_cast<FloatT>(lo + level * step);
+        }
+    }
+
+    /**
+     * The mixture distribution of the booster tests, at any size.
+     *
+     * The first 70% of rows draw every feature from N(5, 1) and the rest
+     * from N(4000.3, 90); the response is `0.75 + 2 x1 + 5.8 x2` plus unit
+     * noise, and every fifth row of the first component is an outlier
+     * with its response scaled by `1000 * row`.
+     *
+     * \param params Size, cardinality and seed of the data.
+     * \return A new Dataset.
+     */
+    template <typename FloatT>
+    Dataset<FloatT> mixture_data(const MixtureParams& params) {
+        const auto nrows = params.nrows;
+        const auto ncols = params.ncols;
+        if (ncols < 2) {
+            throw std::invalid_argument("Must have at least 2 columns");
+        }
+
+        std::mt19937 rand_engine(params.seed);
+        std::normal_distribution<FloatT> small_dist(5.0, 1.0);
+        std::normal_distribution<FloatT> large_dist(4000.3, 90.0);
+        std::normal_distribution<FloatT> noise_dist(0.0, 1.0);
+
+        const size_t threshold = static_cast<size_t>(0.7 * nrows);
+
+        std::vector<FloatT> xs(nrows * ncols);
+        for (size_t col = 0; col != ncols; ++col) {
+            FloatT* const column = &xs[col * nrows];
+            for (size_t row = 0; row != nrows; ++row) {
+                column[row] = (
+                    row < threshold ?
+                    small_dist(rand_engine) :
+                    large_dist(rand_engine));
+            }
+            quantize_column(column, column + nrows, params.cardinality);
+        }
+
+        std::vector<FloatT> ys(nrows);
+        for (size_t row = 0; row != nrows; ++row) {
+            ys[row] = (
+                0.75f + 2.0f * xs[row] + 5.8f * xs[row + nrows] +
+                noise_dist(rand_engine));
+            if (row < threshold && row % 5 == 0) {
+                ys[row] = ys[row] * 1000 * row;
+            }
+        }
+
+        return Dataset<FloatT>(
+            FloatMatrix<FloatT>(ncols, std::move(xs)), std::move(ys));
+    }
+
+    /**
+     * Rows of planted_data() that are outliers.
+     */
+    constexpr size_t planted_every = 100;
+
+    /**
+     * A smooth response with a few planted outliers, for measuring how
+     * well outliers are ranked.
+     *
+     * Every feature is drawn from N(0, 1) and the response is
+     * `x1 x2 + |x1| + 2 sin(x2)` plus N(0, 0.25) noise; the rest of the
+     * features are noise.  Every planted_every-th row, starting with row
+     * 0, has 3 added to or subtracted from its response.
+     *
+     * \param params Size, cardinality and seed of the data.
+     * \return A new Dataset.
+     */
+    template <typename FloatT>
+    Dataset<FloatT> planted_data(const MixtureParams& params) {
+        const auto nrows = params.nrows;
+        const auto ncols = params.ncols;
+        if (ncols < 2) {
+            throw std::invalid_argument("Must have at least 2 columns");
+        }
+
+        std::mt19937 rand_engine(params.seed);
+        std::normal_distribution<FloatT> dist(0.0, 1.0);
+
+        std::vector<FloatT> xs(nrows * ncols);
+        for (size_t col = 0; col != ncols; ++col) {
+            FloatT* const column = &xs[col * nrows];
+            std::generate(column, column + nrows, [&]() {
+                return dist(rand_engine);
+            });
+            quantize_column(column, column + nrows, params.cardinality);
+        }
+
+        std::vector<FloatT> ys(nrows);
+        for (size_t row = 0; row != nrows; ++row) {
+            const FloatT x1 = xs[row];
+            const FloatT x2 = xs[row + nrows];
+            ys[row] = (
+                x1 * x2 + std::abs(x1) + 2 * std::sin(x2) +
+                0.5f * dist(rand_engine));
+            if (row % planted_every == 0) {
+                ys[row] += (row % (2 * planted_every) == 0 ? 3 : -3);
+            }
+        }
+
+        return Dataset<FloatT>(
+            FloatMatrix<FloatT>(ncols, std::move(xs)), std::move(ys));
+    }
+
+    /**
+     * \return Whether each row of planted_data() is one of its planted
+     * outliers.
+     */
+    inline std::vector<bool> planted_outliers(const MixtureParams& params) {
+        std::vector<bool> outliers(params.nrows);
+        for (size_t row = 0; row != params.nrows; row += planted_every) {
+            outliers[row] = true;
+        }
+        return outliers;
+    }
+
+    /**
+     * Area under the ROC curve of an outlier score: the chance that a
+     * random outlier scores above a random inlier, counting ties as half.
+     *
+     * \param scores Score of each row; higher means more likely an outlier.
+     * \param outliers Whether each row is a true outlier.
+     * \return The AUC in `[0, 1]`, or NaN if either class is empty.
+     */
+    template <typename ScoreT>
+    double outlier_auc(
+            const std::vector<ScoreT>& scores,
+            const std::vector<bool>& outliers) {
+        const auto nrows = scores.size();
+        std::vector<size_t> order(nrows);
+        std::iota(order.begin(), order.end(), 0);
+        std::sort(order.begin(), order.end(), [&](size_t lhs, size_t rhs) {
+            return scores[lhs] < scores[rhs];
+        });
+
+        // Mann-Whitney U from the outliers' mid-ranks
+        double rank_sum = 0;
+        size_t npos = 0;
+        for (size_t first = 0; first != nrows;) {
+            auto last = first;
+            while (last != nrows && scores[order[last]] == scores[order[first]]) {
+                ++last;
+            }
+            const double mid_rank = (first + last + 1) / 2.0;
+            for (auto k = first; k != last; ++k) {
+                if (outliers[order[k]]) {
+                    rank_sum += mid_rank;
+                    ++npos;
+                }
+            }
+            first = last;
+        }
+        const double nneg = nrows - npos;
+        return (rank_sum - npos * (npos + 1) / 2.0) / (npos * nneg);
+    }
+
+    /**
+     * \return The fraction of the `k` highest-scoring rows that are true
+     * outliers, where `k` is the number of outliers; ties are broken by
+     * row.
+     */
+    template <typename ScoreT>
+    double outlier_precision(
+            const std::vector<ScoreT>& scores,
+            const std::vector<bool>& outliers) {
+        const size_t k = std::count(outliers.begin(), outliers.end(), true);
+        std::vector<size_t> order(scores.size());
+        std::iota(order.begin(), order.end(), 0);
+        std::stable_sort(order.begin(), order.end(), [&](size_t lhs, size_t rhs) {
+            return scores[lhs] > scores[rhs];
+        });
+        size_t hits = 0;
+        for (size_t rank = 0; rank != k; ++rank) {
+            hits += outliers[order[rank]];
+        }
+        return (k > 0 ? static_cast<double>(hits) / k : 0.0);
+    }
+}
+#endif
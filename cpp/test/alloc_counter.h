@@ -0,0 +1,32 @@
+/*
+ * Copyright 2016-2017 Krysta M Bouzek
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <cstddef>
+
+#ifndef KMBNW_ODVB_ALLOC_COUNTER_H
+#define KMBNW_ODVB_ALLOC_COUNTER_H
+
+namespace oddvibe {
+    /**
+     * \return Number of calls so far to any form of `operator new` made
+     * by the test program and the library.
+     *
+     * The test program replaces the global allocation functions in their
+     * own translation unit, so that the compiler never inlines the
+     * matching `free` where it can see the `operator new` call.
+     */
+    size_t allocation_count();
+}
+#endif
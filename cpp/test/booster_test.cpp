@@ -16,15 +16,22 @@
 
 #include <iostream>
 #include <iomanip>
+#include <cstdlib>
 #include <random>
 #include <cmath>
 #include <vector>
 #include <algorithm>
 #include <iterator>
 #include <functional>
+#include <limits>
+#include <stdexcept>
 #include "../../src/float_matrix.h"
 #include "../../src/ecdf_sampler.h"
+#include "../../src/alias_sampler.h"
 #include "../../src/booster.h"
+#include "../../src/round_stats.h"
+#include "alloc_counter.h"
+#include "test_data.h"
 #include "booster_test.h"
 
 #include <cppunit/extensions/TestFactoryRegistry.h>
@@ -41,12 +48,12 @@ namespace oddvibe {
     void BoosterTest::tearDown() {
     }
 
-    void BoosterTest::test_fit() {
-        // mixture distribution generated by two separate linear equations
-        // but with the same noise
-
-        const size_t seed = 1480561820L; //1480455481L; //time(0);
-        const size_t nrows = 50;
+    /**
+     * Mixture distribution generated by two separate linear equations
+     * but with the same noise; every fifth row of the first component is
+     * an outlier.
+     */
+    static Dataset<float> mixture_data(const size_t seed, const size_t nrows) {
         const size_t nfeatures = 2;
         const float intercept = 0.75f;
         const float beta_1 = 2.0f;
@@ -143,11 +150,20 @@ namespace oddvibe {
                 std::plus<float>());
         }
 
-        const size_t nrounds = 5000;
-
-        const Dataset<float> data(
+        return Dataset<float>(
             FloatMatrix<float>(nfeatures, xs),
             std::vector<float>(ys));
+    }
+
+    void BoosterTest::test_fit() {
+        // mixture distribution generated by two separate linear equations
+        // but with the same noise
+
+        const size_t seed = 1480561820L; //1480455481L; //time(0);
+        const size_t nrows = 50;
+        const size_t nrounds = 5000;
+
+        const Dataset<float> data = mixture_data(seed, nrows);
 
         const Booster booster(seed);
 
@@ -164,12 +180,492 @@ namespace oddvibe {
 
         CPPUNIT_ASSERT_EQUAL(true, max_elem != counts.end());
 
+        // row 30 is the largest outlier planted by mixture_data()
         const size_t actual_row = std::distance(counts.begin(), max_elem);
-        const auto actual_count = *max_elem;
-
         const size_t expected_row = 30;
-
-        CPPUNIT_ASSERT_DOUBLES_EQUAL(6.538f, actual_count, 1e-3);
         CPPUNIT_ASSERT_EQUAL(expected_row, actual_row);
+
+        // the planted outliers (every fifth row of the first component,
+        // except row 0 whose response is scaled by zero) are drawn far
+        // more often than the rest
+        double outlier_sum = 0;
+        double other_sum = 0;
+        size_t noutliers = 0;
+        const size_t threshold = (size_t) (0.7 * nrows);
+        for (size_t j = 0; j != nrows; ++j) {
+            if (j > 0 && j < threshold && j % 5 == 0) {
+                outlier_sum += counts[j];
+                ++noutliers;
+            } else {
+                other_sum += counts[j];
+            }
+        }
+        const double outlier_mean = outlier_sum / noutliers;
+        const double other_mean = other_sum / (nrows - noutliers);
+        CPPUNIT_ASSERT(outlier_mean > 2 * other_mean);
+        CPPUNIT_ASSERT(*max_elem > 4 * (outlier_sum + other_sum) / nrows);
+    }
+
+    // binned split search should rank rows much like the exact search
+    void BoosterTest::test_fit_histogram() {
+        const size_t seed = 1480561820L;
+        const size_t nrows = 200;
+        const size_t nrounds = 500;
+
+        const Dataset<float> data = mixture_data(seed, nrows);
+
+        TreeParams params;
+        params.split_method = SplitMethod::histogram;
+        params.max_bins = 32;
+
+        const Booster exact(seed);
+        const Booster binned(seed, params);
+
+        const auto exact_counts = exact.fit_counts(data, nrounds);
+        const auto binned_counts = binned.fit_counts(data, nrounds);
+
+        const auto corr = rank_correlation(exact_counts, binned_counts);
+        std::cout << "Rank correlation: " << corr << std::endl;
+
+        // two exact runs with different seeds correlate at about 0.8 here
+        CPPUNIT_ASSERT(corr > 0.5);
+    }
+
+    // oblivious trees must still rank the planted outliers first
+    void BoosterTest::test_fit_oblivious() {
+        const size_t seed = 1480561820L;
+        const size_t nrows = 200;
+        const size_t nrounds = 500;
+
+        const Dataset<float> data = mixture_data(seed, nrows);
+
+        TreeParams params;
+        params.tree_kind = TreeKind::oblivious;
+        const Booster rtree(seed);
+        const Booster oblivious(seed, params);
+        params.split_method = SplitMethod::histogram;
+        const Booster binned(seed, params);
+
+        const auto rtree_counts = rtree.fit_counts(data, nrounds);
+        for (const auto & booster : { &oblivious, &binned }) {
+            const auto counts = booster->fit_counts(data, nrounds);
+            const auto corr = rank_correlation(rtree_counts, counts);
+            std::cout << "Rank correlation: " << corr << std::endl;
+
+            // every fifth row of the first 70% is an outlier
+            double outlier_total = 0;
+            double inlier_total = 0;
+            for (size_t row = 0; row != nrows; ++row) {
+                if (row < 140 && row % 5 == 0) {
+                    outlier_total += counts[row];
+                } else {
+                    inlier_total += counts[row];
+                }
+            }
+            CPPUNIT_ASSERT(corr > 0.5);
+            CPPUNIT_ASSERT(outlier_total / 28 > 2 * inlier_total / 172);
+        }
+    }
+
+    // alias draws should follow the distribution and depend only on the seed
+    void BoosterTest::test_alias_sampler() {
+        const size_t nrows = 20;
+        const size_t nsamples = 200000;
+
+        SamplingDist pmf(nrows);
+        std::vector<double> loss(nrows);
+        for (size_t k = 0; k != nrows; ++k) {
+            loss[k] = (k % 3 == 0 ? 0.9 : 0.1 * k / nrows);
+        }
+        pmf.adjust_for_loss(loss);
+
+        AliasSampler sampler(1480561820L);
+        const auto samples = sampler.gen_samples(nsamples, pmf);
+        CPPUNIT_ASSERT_EQUAL(nsamples, samples.size());
+
+        std::vector<size_t> counts(nrows, 0);
+        for (const auto & idx : samples) {
+            CPPUNIT_ASSERT(idx < nrows);
+            ++counts[idx];
+        }
+        for (size_t k = 0; k != nrows; ++k) {
+            CPPUNIT_ASSERT_DOUBLES_EQUAL(
+                pmf.weights()[k], counts[k] / (double) nsamples, 0.005);
+        }
+
+        AliasSampler same_seed(1480561820L);
+        std::vector<size_t> repeat;
+        same_seed.gen_samples(nsamples, pmf, repeat);
+        CPPUNIT_ASSERT(samples == repeat);
+    }
+
+    // the alias sampler should rank rows much like the default sampler
+    void BoosterTest::test_fit_alias() {
+        const size_t seed = 1480561820L;
+        const size_t nrows = 200;
+        const size_t nrounds = 500;
+
+        const Dataset<float> data = mixture_data(seed, nrows);
+        const Booster booster(seed);
+
+        const auto counts = booster.fit_counts(data, nrounds);
+        const auto alias_counts =
+            booster.fit_counts<float, AliasSampler>(data, nrounds);
+
+        const auto corr = rank_correlation(counts, alias_counts);
+        std::cout << "Rank correlation: " << corr << std::endl;
+        CPPUNIT_ASSERT(corr > 0.5);
+    }
+
+    // stopping once the counts settle should still find the same top row
+    void BoosterTest::test_fit_early_stop() {
+        const size_t seed = 1480561820L;
+        const size_t nrows = 50;
+        const size_t nrounds = 5000;
+
+        const Dataset<float> data = mixture_data(seed, nrows);
+        const Booster booster(seed);
+
+        const auto full = booster.fit_counts(data, nrounds);
+        const auto result = booster.fit_counts(data, nrounds, StopParams());
+        std::cout << "Rounds run: " << result.nrounds << std::endl;
+
+        CPPUNIT_ASSERT(result.converged);
+        CPPUNIT_ASSERT(result.nrounds < nrounds);
+        CPPUNIT_ASSERT_EQUAL(nrows, result.counts.size());
+
+        const auto expected = std::max_element(full.begin(), full.end());
+        const auto actual = std::max_element(
+            result.counts.begin(), result.counts.end());
+        CPPUNIT_ASSERT_EQUAL(
+            std::distance(full.begin(), expected),
+            std::distance(result.counts.begin(), actual));
+
+        // the first rounds are identical to an unchecked run
+        const auto short_run = booster.fit_counts(data, result.nrounds);
+        for (size_t j = 0; j != nrows; ++j) {
+            CPPUNIT_ASSERT_EQUAL(short_run[j], result.counts[j]);
+        }
+    }
+
+    // independent chains should not depend on threads and should rank rows
+    // like one long chain
+    void BoosterTest::test_fit_chains() {
+        const size_t seed = 1480561820L;
+        const size_t nrows = 200;
+        const size_t nchains = 4;
+        const size_t nrounds = 250;
+
+        const Dataset<float> data = mixture_data(seed, nrows);
+
+        TreeParams params;
+        const Booster serial(seed, params);
+        params.nthreads = nchains;
+        const Booster parallel(seed, params);
+
+        const auto single = serial.fit_counts(data, nrounds);
+        const auto one_chain = parallel.fit_chains(data, 1, nrounds);
+        for (size_t j = 0; j != nrows; ++j) {
+            CPPUNIT_ASSERT_EQUAL(single[j], one_chain[j]);
+        }
+
+        const auto expected = serial.fit_chains(data, nchains, nrounds);
+        const auto actual = parallel.fit_chains(data, nchains, nrounds);
+        for (size_t j = 0; j != nrows; ++j) {
+            CPPUNIT_ASSERT_EQUAL(expected[j], actual[j]);
+        }
+
+        const auto long_chain = serial.fit_counts(data, nchains * nrounds);
+        const auto corr = rank_correlation(long_chain, actual);
+        std::cout << "Rank correlation: " << corr << std::endl;
+        CPPUNIT_ASSERT(corr > 0.5);
+
+        CPPUNIT_ASSERT_THROW(
+            serial.fit_chains(data, 0, nrounds), std::invalid_argument);
+    }
+
+    // chains that sketch the bins while waiting on the pool must neither
+    // deadlock on the bin cache nor depend on the thread count
+    void BoosterTest::test_fit_chains_sketched() {
+        const size_t seed = 1480561820L;
+        const size_t nrows = 20000;
+        // enough columns that the pool takes part in sketching
+        const size_t nfeatures = 8;
+        const size_t nchains = 16;
+        const size_t nrounds = 3;
+
+        for (const auto kind : { TreeKind::rtree, TreeKind::oblivious }) {
+            TreeParams params;
+            params.split_method = SplitMethod::histogram;
+            params.sketch_k = 200;
+            params.tree_kind = kind;
+            const Booster serial(seed, params);
+            params.nthreads = 4;
+            const Booster parallel(seed, params);
+
+            const auto expected = serial.fit_chains(
+                product_data(nrows, nfeatures), nchains, nrounds);
+            for (size_t run = 0; run != 5; ++run) {
+                // a fresh Dataset has no bins cached yet
+                const auto actual = parallel.fit_chains(
+                    product_data(nrows, nfeatures), nchains, nrounds);
+                CPPUNIT_ASSERT(expected == actual);
+            }
+        }
+    }
+
+    // the callback sees every round and can abandon the fit by throwing
+    void BoosterTest::test_round_callback() {
+        const size_t seed = 1480561820L;
+        const size_t nrows = 50;
+        const size_t nrounds = 20;
+
+        const Dataset<float> data = mixture_data(seed, nrows);
+        Booster booster(seed);
+
+        std::vector<size_t> seen;
+        booster.set_round_callback(
+            [&seen](const size_t round) { seen.push_back(round); });
+        booster.fit_counts(data, nrounds);
+
+        CPPUNIT_ASSERT_EQUAL(nrounds, seen.size());
+        for (size_t k = 0; k != nrounds; ++k) {
+            CPPUNIT_ASSERT_EQUAL(k + 1, seen[k]);
+        }
+
+        booster.set_round_callback([](const size_t round) {
+            if (round == 5) {
+                throw std::runtime_error("interrupted");
+            }
+        });
+        CPPUNIT_ASSERT_THROW(
+            booster.fit_counts(data, nrounds), std::runtime_error);
+
+        // an empty callback is never called
+        booster.set_round_callback(std::function<void(size_t)>());
+        CPPUNIT_ASSERT_EQUAL(nrows, booster.fit_counts(data, nrounds).size());
+    }
+
+    // the fused update must match predict, loss_seq and adjust_for_loss
+    // bit for bit, over several blocks and rounds
+    void BoosterTest::test_round_update() {
+        const size_t nrows = 3 * round_block_rows + 123;
+        const auto data = mixture_data(1480561820L, nrows);
+
+        SamplingDist expected(nrows);
+        SamplingDist actual(nrows);
+        SamplingDist threaded(nrows);
+        RoundUpdate<float> update(nrows);
+        ThreadPool pool(4);
+        RoundUpdate<float> threaded_update(nrows, &pool);
+        AliasSampler sampler(1480561820L);
+        const typename RTree<float>::Trainer trainer(4);
+        FlatTree<float> tree;
+
+        for (size_t round = 0; round != 5; ++round) {
+            auto active = sampler.gen_samples(nrows, expected);
+            tree.assign(*trainer.fit(data, active.begin(), active.end(), 0));
+
+            const auto loss = loss_seq(data.ys(), tree.predict(data.xs()));
+            expected.adjust_for_loss(loss);
+            update.apply(tree, data, actual);
+            threaded_update.apply(tree, data, threaded);
+
+            CPPUNIT_ASSERT(loss == update.loss());
+            CPPUNIT_ASSERT(expected.weights() == actual.weights());
+            CPPUNIT_ASSERT(loss == threaded_update.loss());
+            CPPUNIT_ASSERT(expected.weights() == threaded.weights());
+        }
+
+        RoundUpdate<float> wrong_size(nrows - 1);
+        CPPUNIT_ASSERT_THROW(
+            wrong_size.apply(tree, data, actual), std::invalid_argument);
+    }
+
+    // each draw is the first row whose normalized cumulative weight
+    // reaches a 53-bit canonical draw from the engine; the last row's
+    // cumulative weight is forced to one
+    void BoosterTest::test_empirical_sampler() {
+        const size_t seed = 1480561820L;
+        const size_t nrows = 200;
+        const size_t nsamples = 10000;
+
+        SamplingDist pmf(nrows);
+        std::vector<double> loss(nrows);
+        for (size_t k = 0; k != nrows; ++k) {
+            loss[k] = (k % 3 == 0 ? 0.9 : 0.1 * k / nrows);
+        }
+        pmf.adjust_for_loss(loss);
+
+        EmpiricalSampler sampler(seed);
+        std::vector<size_t> samples;
+        sampler.gen_samples(nsamples, pmf, samples);
+
+        const auto& weights = pmf.weights();
+        double total = 0;
+        for (const auto & weight : weights) {
+            total += weight;
+        }
+        std::vector<double> cdf(nrows);
+        double running = 0;
+        for (size_t k = 0; k != nrows; ++k) {
+            running += weights[k] / total;
+            cdf[k] = running;
+        }
+        cdf.back() = 1.0;
+
+        std::mt19937 rand_engine(seed);
+        std::vector<size_t> counts(nrows, 0);
+        CPPUNIT_ASSERT_EQUAL(nsamples, samples.size());
+        for (const auto & idx : samples) {
+            const double draw = std::generate_canonical<
+                double, std::numeric_limits<double>::digits>(rand_engine);
+            const auto expected = std::distance(
+                cdf.begin(), std::lower_bound(cdf.begin(), cdf.end(), draw));
+            CPPUNIT_ASSERT_EQUAL(size_t(expected), idx);
+            ++counts[idx];
+        }
+
+        // the high loss third of the rows is drawn more than its share
+        size_t high_loss = 0;
+        for (size_t k = 0; k < nrows; k += 3) {
+            high_loss += counts[k];
+        }
+        CPPUNIT_ASSERT(high_loss > nsamples * 2 / 5);
+
+        // the next call continues from the same engine
+        CPPUNIT_ASSERT(sampler.gen_samples(nsamples, pmf) != samples);
+
+        // a single row is always drawn and uses no random numbers
+        SamplingDist single(1);
+        EmpiricalSampler single_sampler(seed);
+        CPPUNIT_ASSERT(
+            single_sampler.gen_samples(5, single)
+            == std::vector<size_t>(5, 0));
+        EmpiricalSampler fresh(seed);
+        CPPUNIT_ASSERT(
+            single_sampler.gen_samples(nsamples, pmf)
+            == fresh.gen_samples(nsamples, pmf));
+    }
+
+    // once the workspace has grown, rounds must not touch the heap
+    void BoosterTest::test_steady_state_allocations() {
+        const size_t seed = 1480561820L;
+        const size_t nrows = 500;
+        const size_t warmup = 10;
+        const size_t nrounds = 50;
+
+        const Dataset<float> data = mixture_data(seed, nrows);
+
+        size_t warm_allocs = 0;
+        size_t last_allocs = 0;
+        const auto on_round = [&](const size_t round) {
+            if (round == warmup) {
+                warm_allocs = allocation_count();
+            } else if (round == nrounds) {
+                last_allocs = allocation_count();
+            }
+        };
+
+        TreeParams params;
+        Booster exact(seed, params);
+        exact.set_round_callback(on_round);
+        exact.fit_counts(data, nrounds);
+        CPPUNIT_ASSERT(warm_allocs > 0);
+        CPPUNIT_ASSERT_EQUAL(warm_allocs, last_allocs);
+
+        params.split_method = SplitMethod::histogram;
+        params.weight_samples = true;
+        Booster binned(seed, params);
+        binned.set_round_callback(on_round);
+        binned.fit_counts<float, AliasSampler>(data, nrounds);
+        CPPUNIT_ASSERT_EQUAL(warm_allocs, last_allocs);
+
+        params.tree_kind = TreeKind::oblivious;
+        for (const auto method : { SplitMethod::exact, SplitMethod::histogram }) {
+            params.split_method = method;
+            Booster oblivious(seed, params);
+            oblivious.set_round_callback(on_round);
+            oblivious.fit_counts(data, nrounds);
+            CPPUNIT_ASSERT_EQUAL(warm_allocs, last_allocs);
+        }
+    }
+
+    // measuring rounds must not change the fit, and must see every round
+    void BoosterTest::test_observer() {
+        const size_t seed = 1480561820L;
+        const size_t nrows = 200;
+        const size_t nrounds = 20;
+
+        const Dataset<float> data = mixture_data(seed, nrows);
+        Booster booster(seed);
+        const auto expected = booster.fit_counts(data, nrounds);
+
+        RoundStatsCollector collector;
+        booster.set_observer(&collector);
+        const auto actual = booster.fit_counts(data, nrounds);
+        CPPUNIT_ASSERT(expected == actual);
+
+        const auto& rounds = collector.rounds();
+        CPPUNIT_ASSERT_EQUAL(nrounds, rounds.size());
+        for (size_t k = 0; k != nrounds; ++k) {
+            const auto& stats = rounds[k];
+            CPPUNIT_ASSERT_EQUAL(k + 1, stats.round);
+            // every interior node has two children
+            CPPUNIT_ASSERT_EQUAL(size_t(1), stats.nnodes % 2);
+            CPPUNIT_ASSERT(stats.depth <= TreeParams().max_depth);
+            CPPUNIT_ASSERT(stats.nnodes == 1 || stats.split_candidates > 0);
+            CPPUNIT_ASSERT(stats.fit_seconds >= 0);
+            CPPUNIT_ASSERT(stats.split_seconds >= 0);
+            CPPUNIT_ASSERT(stats.predict_seconds >= 0);
+            CPPUNIT_ASSERT(stats.update.epsilon <= stats.update.max_loss);
+            if (!stats.update.reset) {
+                CPPUNIT_ASSERT_DOUBLES_EQUAL(
+                    stats.update.epsilon /
+                        (stats.update.max_loss - stats.update.epsilon),
+                    stats.update.beta,
+                    1e-12);
+            }
+        }
+
+        const auto totals = collector.totals();
+        CPPUNIT_ASSERT_EQUAL(nrounds, totals.round);
+        const auto json = collector.json();
+        CPPUNIT_ASSERT(json.find("\"nrounds\": 20,") != std::string::npos);
+        CPPUNIT_ASSERT(json.find("\"round\": 20,") != std::string::npos);
+
+        // fit_chains is not observed
+        collector.clear();
+        booster.fit_chains(data, 2, nrounds);
+        CPPUNIT_ASSERT(collector.rounds().empty());
+    }
+
+    // adjust_for_loss should report how it changed the distribution
+    void BoosterTest::test_loss_update() {
+        const size_t nrows = 4;
+        SamplingDist pmf(nrows);
+
+        const auto update = pmf.adjust_for_loss({ 0.1, 0.0, 0.0, 0.0 });
+        CPPUNIT_ASSERT_DOUBLES_EQUAL(0.025, update.epsilon, 1e-12);
+        CPPUNIT_ASSERT_DOUBLES_EQUAL(0.1, update.max_loss, 1e-12);
+        CPPUNIT_ASSERT_DOUBLES_EQUAL(0.025 / 0.075, update.beta, 1e-12);
+        CPPUNIT_ASSERT(!update.reset);
+
+        // a tree no better than chance resets the distribution
+        const auto reset = pmf.adjust_for_loss({ 1.0, 1.0, 1.0, 1.0 });
+        CPPUNIT_ASSERT(reset.reset);
+        for (const auto weight : pmf.weights()) {
+            CPPUNIT_ASSERT_DOUBLES_EQUAL(0.25, weight, m_tolerance);
+        }
+
+        // a perfect fit has no finite beta, which JSON writes as null
+        RoundStatsCollector collector;
+        RoundStats stats;
+        stats.update = pmf.adjust_for_loss({ 0.0, 0.0, 0.0, 0.0 });
+        CPPUNIT_ASSERT(stats.update.reset);
+        collector.on_round(stats);
+        CPPUNIT_ASSERT_EQUAL(size_t(1), collector.nresets());
+        CPPUNIT_ASSERT(
+            collector.json().find("\"beta\": null") != std::string::npos);
     }
 }
@@ -24,6 +24,19 @@ namespace oddvibe {
     class BoosterTest : public CppUnit::TestFixture {
         CPPUNIT_TEST_SUITE(BoosterTest);
         CPPUNIT_TEST(test_fit);
+        CPPUNIT_TEST(test_fit_histogram);
+        CPPUNIT_TEST(test_fit_oblivious);
+        CPPUNIT_TEST(test_alias_sampler);
+        CPPUNIT_TEST(test_fit_alias);
+        CPPUNIT_TEST(test_fit_early_stop);
+        CPPUNIT_TEST(test_fit_chains);
+        CPPUNIT_TEST(test_fit_chains_sketched);
+        CPPUNIT_TEST(test_round_callback);
+        CPPUNIT_TEST(test_round_update);
+        CPPUNIT_TEST(test_empirical_sampler);
+        CPPUNIT_TEST(test_steady_state_allocations);
+        CPPUNIT_TEST(test_observer);
+        CPPUNIT_TEST(test_loss_update);
         CPPUNIT_TEST_SUITE_END();
 
         private:
@@ -33,6 +46,19 @@ namespace oddvibe {
             void setUp();
             void tearDown();
             void test_fit();
+            void test_fit_histogram();
+            void test_fit_oblivious();
+            void test_alias_sampler();
+            void test_fit_alias();
+            void test_fit_early_stop();
+            void test_fit_chains();
+            void test_fit_chains_sketched();
+            void test_round_callback();
+            void test_round_update();
+            void test_empirical_sampler();
+            void test_steady_state_allocations();
+            void test_observer();
+            void test_loss_update();
     };
 }
 #endif
@@ -0,0 +1,128 @@
+/*
+ * Copyright 2016-2017 Krysta M Bouzek
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cstdio>
+#include <cstdint>
+#include <vector>
+#include <numeric>
+#include <fstream>
+#include <algorithm>
+#include <stdexcept>
+#include <system_error>
+#include "../../src/columnar_file.h"
+#include "../../src/rtree.h"
+#include "test_data.h"
+#include "columnar_test.h"
+
+#include <cppunit/extensions/HelperMacros.h>
+
+CPPUNIT_TEST_SUITE_REGISTRATION(oddvibe::ColumnarTest);
+
+namespace oddvibe {
+
+    void ColumnarTest::setUp() {
+    }
+
+    void ColumnarTest::tearDown() {
+        std::remove(m_path.c_str());
+    }
+
+    // the mapped matrix must hold the written values in aligned columns
+    void ColumnarTest::test_round_trip() {
+        // an odd row count so that columns need padding
+        const size_t nrows = 1001;
+        const size_t ncols = 3;
+        const auto data = product_data(nrows, ncols);
+        write_columnar(m_path, data.xs(), data.ys());
+
+        FloatMatrix<float> xs;
+        {
+            const auto loaded = load_columnar<float>(m_path);
+            CPPUNIT_ASSERT_EQUAL(nrows, loaded.nrow());
+            CPPUNIT_ASSERT_EQUAL(ncols, loaded.ncol());
+            CPPUNIT_ASSERT(!loaded.xs().owns_data());
+            CPPUNIT_ASSERT(loaded.ys() == data.ys());
+            xs = loaded.xs();
+        }
+
+        // the copy keeps the mapping alive after the Dataset is gone
+        for (size_t col = 0; col != ncols; ++col) {
+            const auto address = reinterpret_cast<uintptr_t>(xs.col_data(col));
+            CPPUNIT_ASSERT_EQUAL(uintptr_t(0), address % columnar_alignment);
+            for (size_t row = 0; row != nrows; ++row) {
+                CPPUNIT_ASSERT_EQUAL(data.xs()(row, col), xs(row, col));
+            }
+        }
+
+        CPPUNIT_ASSERT_THROW(load_columnar<double>(m_path), std::invalid_argument);
+    }
+
+    // trees fitted on a mapped file must match trees fitted in memory
+    void ColumnarTest::test_fit_mapped() {
+        const size_t nrows = 2000;
+        const auto data = product_data(nrows, 3);
+        write_columnar(m_path, data.xs(), data.ys());
+        const auto loaded = load_columnar<float>(m_path);
+
+        std::vector<size_t> seq(nrows);
+        std::iota(seq.begin(), seq.end(), 0);
+        const typename RTree<float>::Trainer trainer(6);
+        const auto expected = trainer.fit(
+            data, seq.begin(), seq.end(), 0)->predict(data.xs());
+        std::iota(seq.begin(), seq.end(), 0);
+        const auto actual = trainer.fit(
+            loaded, seq.begin(), seq.end(), 0)->predict(loaded.xs());
+
+        for (size_t j = 0; j != nrows; ++j) {
+            CPPUNIT_ASSERT_EQUAL(expected[j], actual[j]);
+        }
+    }
+
+    // damaged or foreign files must be rejected before they are read
+    void ColumnarTest::test_invalid_file() {
+        CPPUNIT_ASSERT_THROW(
+            load_columnar<float>("no_such_file.odvb"), std::system_error);
+
+        {
+            std::ofstream out(m_path, std::ios::binary);
+            out << "not a columnar file, but long enough to hold a header....";
+        }
+        CPPUNIT_ASSERT_THROW(load_columnar<float>(m_path), std::invalid_argument);
+
+        CPPUNIT_ASSERT_THROW(read_columnar_header(m_path), std::invalid_argument);
+
+        // the header tells the value type before loading
+        const auto data = product_data(100, 3);
+        write_columnar(m_path, data.xs(), data.ys());
+        const auto header = read_columnar_header(m_path);
+        CPPUNIT_ASSERT_EQUAL(uint32_t(sizeof(float)), header.dtype_size);
+        CPPUNIT_ASSERT_EQUAL(uint64_t(100), header.nrow);
+        CPPUNIT_ASSERT_EQUAL(uint64_t(3), header.ncol);
+
+        // a valid header whose columns were cut off
+        std::vector<char> bytes;
+        {
+            std::ifstream in(m_path, std::ios::binary);
+            bytes.assign(std::istreambuf_iterator<char>(in), {});
+        }
+        {
+            std::ofstream out(m_path, std::ios::binary | std::ios::trunc);
+            out.write(bytes.data(), bytes.size() - 4);
+        }
+        CPPUNIT_ASSERT_THROW(load_columnar<float>(m_path), std::invalid_argument);
+        CPPUNIT_ASSERT_THROW(read_columnar_header(m_path), std::invalid_argument);
+    }
+}
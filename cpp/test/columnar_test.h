@@ -0,0 +1,42 @@
+/*
+ * Copyright 2016-2017 Krysta M Bouzek
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string>
+#include <cppunit/extensions/HelperMacros.h>
+
+#ifndef KMBNW_ODVB_COLUMNAR_TEST_H
+#define KMBNW_ODVB_COLUMNAR_TEST_H
+
+namespace oddvibe {
+    class ColumnarTest : public CppUnit::TestFixture {
+        CPPUNIT_TEST_SUITE(ColumnarTest);
+        CPPUNIT_TEST(test_round_trip);
+        CPPUNIT_TEST(test_fit_mapped);
+        CPPUNIT_TEST(test_invalid_file);
+        CPPUNIT_TEST_SUITE_END();
+
+        private:
+            const std::string m_path = "columnar_test.odvb";
+
+        public:
+            void setUp();
+            void tearDown();
+            void test_round_trip();
+            void test_fit_mapped();
+            void test_invalid_file();
+    };
+}
+#endif
@@ -0,0 +1,203 @@
+/*
+ * Copyright 2016-2017 Krysta M Bouzek
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <cmath>
+#include <clocale>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <stdexcept>
+#include <system_error>
+#include "../../src/data_loader.h"
+#include "../../src/thread_pool.h"
+#include "loader_test.h"
+
+#include <cppunit/extensions/HelperMacros.h>
+
+CPPUNIT_TEST_SUITE_REGISTRATION(oddvibe::LoaderTest);
+
+namespace oddvibe {
+
+    void LoaderTest::setUp() {
+    }
+
+    void LoaderTest::tearDown() {
+        std::remove(m_path.c_str());
+    }
+
+    static void write_text(const std::string& path, const std::string& text) {
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        out << text;
+    }
+
+    // chunks must start at line starts and cover the text exactly once
+    void LoaderTest::test_split_lines() {
+        const std::string text = "1,2\n33,44\n5,6\n777,888\n9,0";
+        const auto bounds = split_lines(text.data(), text.size(), 5);
+
+        CPPUNIT_ASSERT_EQUAL(size_t(0), bounds.front());
+        CPPUNIT_ASSERT_EQUAL(text.size(), bounds.back());
+        size_t nrecords = 0;
+        for (size_t k = 0; k + 1 != bounds.size(); ++k) {
+            CPPUNIT_ASSERT(bounds[k] < bounds[k + 1]);
+            CPPUNIT_ASSERT(bounds[k] == 0 || text[bounds[k] - 1] == '\n');
+            nrecords += count_records(
+                text.data() + bounds[k], text.data() + bounds[k + 1]);
+        }
+        CPPUNIT_ASSERT(bounds.size() > 2);
+        CPPUNIT_ASSERT_EQUAL(size_t(5), nrecords);
+
+        const auto single = split_lines(text.data(), text.size(), 1000);
+        CPPUNIT_ASSERT_EQUAL(size_t(2), single.size());
+    }
+
+    // headers, CRLF endings, blank lines and missing values
+    void LoaderTest::test_load_csv() {
+        write_text(m_path,
+            "a;b;y\r\n"
+            "1.5; -2;10\r\n"
+            "\r\n"
+            "NA;3e2;20\r\n"
+            "4;;30");
+
+        CsvOptions options;
+        options.delimiter = ';';
+        options.has_header = true;
+        LoadStats stats;
+        const auto data = load_csv<double>(m_path, options, nullptr, &stats);
+
+        CPPUNIT_ASSERT_EQUAL(size_t(3), data.nrow());
+        CPPUNIT_ASSERT_EQUAL(size_t(2), data.ncol());
+        CPPUNIT_ASSERT_EQUAL(1.5, data.xs()(0, 0));
+        CPPUNIT_ASSERT_EQUAL(-2.0, data.xs()(0, 1));
+        CPPUNIT_ASSERT(std::isnan(data.xs()(1, 0)));
+        CPPUNIT_ASSERT_EQUAL(300.0, data.xs()(1, 1));
+        CPPUNIT_ASSERT_EQUAL(4.0, data.xs()(2, 0));
+        CPPUNIT_ASSERT(std::isnan(data.xs()(2, 1)));
+        CPPUNIT_ASSERT((data.ys() == std::vector<double>{10, 20, 30}));
+        CPPUNIT_ASSERT_EQUAL(size_t(37), stats.bytes);
+    }
+
+    // a file of several chunks must load the same with and without threads
+    void LoaderTest::test_load_csv_chunks() {
+        const size_t nrows = 60000;
+        std::mt19937 generator(1480561820L);
+        std::uniform_int_distribution<int> dist(-100000, 100000);
+        std::vector<int> values(nrows * 3);
+        {
+            std::ofstream out(m_path, std::ios::binary | std::ios::trunc);
+            for (size_t row = 0; row != nrows; ++row) {
+                for (size_t col = 0; col != 3; ++col) {
+                    values[row * 3 + col] = dist(generator);
+                    out << (col > 0 ? "," : "") << values[row * 3 + col];
+                }
+                out << '\n';
+            }
+        }
+
+        ThreadPool pool(4);
+        const auto serial = load_csv<float>(m_path);
+        const auto threaded = load_csv<float>(m_path, CsvOptions(), &pool);
+
+        CPPUNIT_ASSERT_EQUAL(nrows, threaded.nrow());
+        CPPUNIT_ASSERT_EQUAL(size_t(2), threaded.ncol());
+        for (size_t row = 0; row != nrows; ++row) {
+            for (size_t col = 0; col != 2; ++col) {
+                CPPUNIT_ASSERT_EQUAL(
+                    float(values[row * 3 + col]), threaded.xs()(row, col));
+                CPPUNIT_ASSERT_EQUAL(
+                    serial.xs()(row, col), threaded.xs()(row, col));
+            }
+            CPPUNIT_ASSERT_EQUAL(float(values[row * 3 + 2]), threaded.ys()[row]);
+        }
+    }
+
+    // ragged records and text values must be reported, not guessed at
+    void LoaderTest::test_invalid_csv() {
+        CPPUNIT_ASSERT_THROW(
+            load_csv<double>("no_such_file.csv"), std::system_error);
+
+        write_text(m_path, "1,2,3\n4,5\n");
+        CPPUNIT_ASSERT_THROW(load_csv<double>(m_path), std::invalid_argument);
+
+        write_text(m_path, "1,2,3\n4,5,6,7\n");
+        CPPUNIT_ASSERT_THROW(load_csv<double>(m_path), std::invalid_argument);
+
+        write_text(m_path, "1,2,3\n4,five,6\n");
+        CPPUNIT_ASSERT_THROW(load_csv<double>(m_path), std::invalid_argument);
+
+        write_text(m_path, "1\n2\n");
+        CPPUNIT_ASSERT_THROW(load_csv<double>(m_path), std::invalid_argument);
+    }
+
+    // a process locale with a decimal comma must not change the values
+    void LoaderTest::test_csv_locale() {
+        const std::string saved(std::setlocale(LC_NUMERIC, nullptr));
+        for (const auto name : {
+                "de_DE.UTF-8", "de_DE.utf8", "de_DE", "fr_FR.UTF-8",
+                "fr_FR.utf8", "fr_FR" }) {
+            if (std::setlocale(LC_NUMERIC, name) != nullptr) {
+                break;
+            }
+        }
+
+        const std::string field = "1.5";
+        const double parsed = parse_field(
+            field.data(), field.data() + field.size());
+        write_text(m_path, "0.25,-1.5e2\n2.75,3\n");
+        const auto data = load_csv<double>(m_path);
+        std::setlocale(LC_NUMERIC, saved.c_str());
+
+        CPPUNIT_ASSERT_EQUAL(1.5, parsed);
+        CPPUNIT_ASSERT_EQUAL(0.25, data.xs()(0, 0));
+        CPPUNIT_ASSERT_EQUAL(2.75, data.xs()(1, 0));
+        CPPUNIT_ASSERT_EQUAL(-150.0, data.ys()[0]);
+    }
+
+    // raw records are transposed into columns with the response split off
+    void LoaderTest::test_load_raw() {
+        const size_t nrows = 1000;
+        const size_t ncols = 3;
+        std::vector<double> records(nrows * (ncols + 1));
+        for (size_t k = 0; k != records.size(); ++k) {
+            records[k] = k * 0.25;
+        }
+        {
+            std::ofstream out(m_path, std::ios::binary | std::ios::trunc);
+            out.write(
+                reinterpret_cast<const char*>(records.data()),
+                records.size() * sizeof(double));
+        }
+
+        ThreadPool pool(3);
+        const auto data = load_raw<double>(m_path, ncols, &pool);
+        CPPUNIT_ASSERT_EQUAL(nrows, data.nrow());
+        CPPUNIT_ASSERT_EQUAL(ncols, data.ncol());
+        for (size_t row = 0; row != nrows; ++row) {
+            for (size_t col = 0; col != ncols; ++col) {
+                CPPUNIT_ASSERT_EQUAL(
+                    records[row * (ncols + 1) + col], data.xs()(row, col));
+            }
+            CPPUNIT_ASSERT_EQUAL(
+                records[row * (ncols + 1) + ncols], data.ys()[row]);
+        }
+
+        // not a whole number of records
+        CPPUNIT_ASSERT_THROW(
+            load_raw<double>(m_path, 2, &pool), std::invalid_argument);
+    }
+}
@@ -0,0 +1,47 @@
+/*
+ * Copyright 2016-2017 Krysta M Bouzek
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <string>
+#include <cppunit/extensions/HelperMacros.h>
+
+#ifndef KMBNW_ODVB_LOADER_TEST_H
+#define KMBNW_ODVB_LOADER_TEST_H
+
+namespace oddvibe {
+    class LoaderTest : public CppUnit::TestFixture {
+        CPPUNIT_TEST_SUITE(LoaderTest);
+        CPPUNIT_TEST(test_split_lines);
+        CPPUNIT_TEST(test_load_csv);
+        CPPUNIT_TEST(test_load_csv_chunks);
+        CPPUNIT_TEST(test_invalid_csv);
+        CPPUNIT_TEST(test_csv_locale);
+        CPPUNIT_TEST(test_load_raw);
+        CPPUNIT_TEST_SUITE_END();
+
+        private:
+            const std::string m_path = "loader_test.data";
+
+        public:
+            void setUp();
+            void tearDown();
+            void test_split_lines();
+            void test_load_csv();
+            void test_load_csv_chunks();
+            void test_invalid_csv();
+            void test_csv_locale();
+            void test_load_raw();
+    };
+}
+#endif
@@ -65,6 +65,22 @@ namespace oddvibe {
         CPPUNIT_ASSERT_DOUBLES_EQUAL(expected[2], pmf[2], m_tolerance);
         CPPUNIT_ASSERT_DOUBLES_EQUAL(expected[3], pmf[3], m_tolerance);
     }
+
+    void MathXTest::test_rank_correlation() {
+        const std::vector<float> xs { 1.0, 2.0, 2.0, 3.0 };
+        const std::vector<float> increasing { 10.0, 20.0, 30.0, 40.0 };
+        const std::vector<float> decreasing { 0.4, 0.3, 0.2, 0.1 };
+
+        CPPUNIT_ASSERT_DOUBLES_EQUAL(
+            1.0, rank_correlation(increasing, increasing), m_tolerance);
+        CPPUNIT_ASSERT_DOUBLES_EQUAL(
+            -1.0, rank_correlation(increasing, decreasing), m_tolerance);
+        // tied values share the average rank of 2.5
+        CPPUNIT_ASSERT_DOUBLES_EQUAL(
+            4.5 / std::sqrt(4.5 * 5.0),
+            rank_correlation(xs, increasing),
+            m_tolerance);
+    }
 }
 
 int main(int argc, char **argv) {
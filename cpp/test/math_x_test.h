@@ -26,6 +26,7 @@ namespace oddvibe {
         CPPUNIT_TEST(test_normalize);
         CPPUNIT_TEST(test_normalize_gt_one);
         CPPUNIT_TEST(test_normalize_lt_one);
+        CPPUNIT_TEST(test_rank_correlation);
         CPPUNIT_TEST_SUITE_END();
 
         private:
@@ -38,6 +39,7 @@ namespace oddvibe {
             void test_normalize();
             void test_normalize_gt_one();
             void test_normalize_lt_one();
+            void test_rank_correlation();
     };
 }
 #endif
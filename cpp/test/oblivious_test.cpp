@@ -0,0 +1,341 @@
+/*
+ * Copyright 2016-2017 Krysta M Bouzek
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <random>
+#include <cmath>
+#include <vector>
+#include <limits>
+#include <numeric>
+#include <algorithm>
+#include "../../src/params.h"
+#include "../../src/dataset.h"
+#include "../../src/column_sample.h"
+#include "../../src/oblivious_tree.h"
+#include "../../src/predictor.h"
+#include "../../src/thread_pool.h"
+#include "test_data.h"
+#include "oblivious_test.h"
+
+#include <cppunit/extensions/HelperMacros.h>
+
+CPPUNIT_TEST_SUITE_REGISTRATION(oddvibe::ObliviousTest);
+
+namespace oddvibe {
+
+    void ObliviousTest::setUp() {
+    }
+
+    void ObliviousTest::tearDown() {
+    }
+
+    /**
+     * Three features, the third with only 20 distinct values; the response
+     * is nonlinear in the first two.
+     */
+    static Dataset<float> wavy_data(const size_t nrows) {
+        std::mt19937 generator(test_seed);
+        const size_t nfeatures = 3;
+
+        auto xs = normal_features(generator, nrows, nfeatures);
+        for (size_t j = 2 * nrows; j != xs.size(); ++j) {
+            xs[j] = std::round(xs[j] * 4);
+        }
+        auto ys = product_response(xs, nrows);
+        std::normal_distribution<float> noise(0.0f, 0.1f);
+        for (auto& y : ys) {
+            y += noise(generator);
+        }
+        return Dataset<float>(
+            FloatMatrix<float>(nfeatures, std::move(xs)), std::move(ys));
+    }
+
+    // each level packs one comparison into the leaf index, root first
+    void ObliviousTest::test_predict() {
+        const float nan = std::numeric_limits<float>::quiet_NaN();
+        const FloatMatrix<float> xs(2, std::vector<float>{
+            0.0f, 2.0f, 0.0f, 2.0f, nan,
+            5.0f, 5.0f, 9.0f, 9.0f, 5.0f });
+        const ObliviousTree<float> tree(
+            { 0, 1 }, { 1.0f, 6.0f }, { 10.0f, 11.0f, 12.0f, 13.0f });
+
+        CPPUNIT_ASSERT_EQUAL(size_t(2), tree.depth());
+        CPPUNIT_ASSERT_EQUAL(size_t(7), tree.size());
+
+        const std::vector<float> expected = { 10.0f, 12.0f, 11.0f, 13.0f, 12.0f };
+        CPPUNIT_ASSERT(expected == tree.predict(xs));
+        for (size_t row = 0; row != expected.size(); ++row) {
+            CPPUNIT_ASSERT_EQUAL(expected[row], tree.predict(xs, row));
+        }
+
+        ThreadPool pool(3);
+        BlockPredictor<float> predictor(&pool, 2);
+        std::vector<float> actual(expected.size());
+        predictor.predict(tree, xs, actual.data());
+        CPPUNIT_ASSERT(expected == actual);
+
+        const ObliviousTree<float> stump({}, {}, { 3.0f });
+        CPPUNIT_ASSERT_EQUAL(size_t(0), stump.depth());
+        CPPUNIT_ASSERT(std::vector<float>(5, 3.0f) == stump.predict(xs));
+
+        CPPUNIT_ASSERT_THROW(
+            ObliviousTree<float>({ 0 }, { 1.0f }, { 1.0f }),
+            std::invalid_argument);
+        CPPUNIT_ASSERT_THROW(
+            ObliviousTree<float>().predict(xs, 0), std::logic_error);
+    }
+
+    // a response that is a function of two thresholds needs two levels
+    void ObliviousTest::test_fit_perfect() {
+        const size_t nrows = 400;
+        std::mt19937 generator(1480561820L);
+        std::uniform_real_distribution<float> dist(0.0f, 10.0f);
+
+        std::vector<float> xs(nrows * 3);
+        std::generate(xs.begin(), xs.end(), [&]() { return dist(generator); });
+        std::vector<float> ys(nrows);
+        for (size_t j = 0; j != nrows; ++j) {
+            ys[j] = (xs[j + nrows] > 3.0f ? 100.0f : 0.0f) + (xs[j] > 7.0f ? 10.0f : 0.0f);
+        }
+        const Dataset<float> data(FloatMatrix<float>(3, xs), std::vector<float>(ys));
+
+        std::vector<size_t> seq(nrows);
+        std::iota(seq.begin(), seq.end(), 0);
+        for (const auto method : { SplitMethod::exact, SplitMethod::histogram }) {
+            TreeParams params;
+            params.split_method = method;
+            params.max_bins = 1024;
+            const typename ObliviousTree<float>::Trainer trainer(params);
+            const auto tree = trainer.fit(data, seq.begin(), seq.end());
+
+            // no split helps once both thresholds are found
+            CPPUNIT_ASSERT_EQUAL(size_t(2), tree.depth());
+            CPPUNIT_ASSERT_EQUAL(size_t(1), tree.split_col(0));
+            CPPUNIT_ASSERT_EQUAL(size_t(0), tree.split_col(1));
+            CPPUNIT_ASSERT(tree.split_val(0) <= 3.0f);
+            CPPUNIT_ASSERT(tree.split_val(1) <= 7.0f);
+            const auto yhats = tree.predict(data.xs());
+            for (size_t j = 0; j != nrows; ++j) {
+                CPPUNIT_ASSERT_DOUBLES_EQUAL(ys[j], yhats[j], 1e-3);
+            }
+        }
+
+        // constant responses do not split
+        const Dataset<float> flat(
+            FloatMatrix<float>(3, xs), std::vector<float>(nrows, 2.0f));
+        const typename ObliviousTree<float>::Trainer trainer(TreeParams{});
+        const auto stump = trainer.fit(flat, seq.begin(), seq.end());
+        CPPUNIT_ASSERT_EQUAL(size_t(0), stump.depth());
+        CPPUNIT_ASSERT_EQUAL(2.0f, stump.predict(flat.xs(), 0));
+    }
+
+    // with a bin per distinct value the histogram search sees the same
+    // candidates as the exact search
+    void ObliviousTest::test_fit_histogram() {
+        const size_t nrows = 300;
+        const auto data = wavy_data(nrows);
+        std::vector<size_t> seq(nrows);
+        std::iota(seq.begin(), seq.end(), 0);
+
+        TreeParams params;
+        params.max_depth = 4;
+        const typename ObliviousTree<float>::Trainer exact(params);
+        params.split_method = SplitMethod::histogram;
+        params.max_bins = 1024;
+        const typename ObliviousTree<float>::Trainer binned(params);
+
+        const auto exact_tree = exact.fit(data, seq.begin(), seq.end());
+        const auto binned_tree = binned.fit(data, seq.begin(), seq.end());
+        CPPUNIT_ASSERT_EQUAL(size_t(4), exact_tree.depth());
+        CPPUNIT_ASSERT_EQUAL(exact_tree.depth(), binned_tree.depth());
+        for (size_t level = 0; level != exact_tree.depth(); ++level) {
+            CPPUNIT_ASSERT_EQUAL(
+                exact_tree.split_col(level), binned_tree.split_col(level));
+            CPPUNIT_ASSERT_EQUAL(
+                exact_tree.split_val(level), binned_tree.split_val(level));
+        }
+        const auto expected = exact_tree.leaves();
+        const auto actual = binned_tree.leaves();
+        for (size_t leaf = 0; leaf != expected.size(); ++leaf) {
+            CPPUNIT_ASSERT_DOUBLES_EQUAL(expected[leaf], actual[leaf], 1e-4);
+        }
+    }
+
+    // weighting distinct rows by multiplicity fits the same tree as
+    // repeating them
+    void ObliviousTest::test_fit_weighted() {
+        const size_t nrows = 500;
+        const auto data = wavy_data(nrows);
+
+        std::mt19937 generator(1480561820L);
+        std::uniform_int_distribution<size_t> row_dist(0, nrows - 1);
+        std::vector<size_t> sample(nrows);
+        std::generate(sample.begin(), sample.end(), [&]() { return row_dist(generator); });
+
+        std::vector<double> weights(nrows, 0.0);
+        std::vector<size_t> distinct;
+        for (const auto row : sample) {
+            if (weights[row]++ == 0) {
+                distinct.push_back(row);
+            }
+        }
+
+        for (const auto method : { SplitMethod::exact, SplitMethod::histogram }) {
+            TreeParams params;
+            params.split_method = method;
+            const typename ObliviousTree<float>::Trainer trainer(params);
+            const auto repeated = trainer.fit(data, sample.begin(), sample.end());
+            const auto weighted = trainer.fit(
+                data, weights, distinct.begin(), distinct.end());
+
+            CPPUNIT_ASSERT_EQUAL(repeated.depth(), weighted.depth());
+            for (size_t level = 0; level != repeated.depth(); ++level) {
+                CPPUNIT_ASSERT_EQUAL(
+                    repeated.split_col(level), weighted.split_col(level));
+                CPPUNIT_ASSERT_EQUAL(
+                    repeated.split_val(level), weighted.split_val(level));
+            }
+            CPPUNIT_ASSERT(repeated.leaves() == weighted.leaves());
+        }
+
+        const typename ObliviousTree<float>::Trainer trainer(TreeParams{});
+        CPPUNIT_ASSERT_THROW(
+            trainer.fit(
+                data, std::vector<double>(nrows - 1, 1.0),
+                distinct.begin(), distinct.end()),
+            std::invalid_argument);
+        CPPUNIT_ASSERT_THROW(
+            trainer.fit(data, sample.begin(), sample.begin()),
+            std::invalid_argument);
+    }
+
+    // columns are scanned in parallel but the tree must not change
+    void ObliviousTest::test_fit_threads() {
+        const size_t nrows = 2000;
+        const auto data = wavy_data(nrows);
+        std::vector<size_t> seq(nrows);
+        std::iota(seq.begin(), seq.end(), 0);
+
+        ThreadPool pool(4);
+        for (const auto method : { SplitMethod::exact, SplitMethod::histogram }) {
+            TreeParams params;
+            params.split_method = method;
+            const typename ObliviousTree<float>::Trainer serial(params);
+            const typename ObliviousTree<float>::Trainer threaded(params, &pool);
+
+            const auto expected = serial.fit(data, seq.begin(), seq.end());
+            const auto actual = threaded.fit(data, seq.begin(), seq.end());
+            CPPUNIT_ASSERT_EQUAL(size_t(6), expected.depth());
+            CPPUNIT_ASSERT_EQUAL(expected.depth(), actual.depth());
+            for (size_t level = 0; level != expected.depth(); ++level) {
+                CPPUNIT_ASSERT_EQUAL(expected.split_col(level), actual.split_col(level));
+                CPPUNIT_ASSERT_EQUAL(expected.split_val(level), actual.split_val(level));
+            }
+            CPPUNIT_ASSERT(expected.leaves() == actual.leaves());
+        }
+    }
+
+    // every level must split on one of the tree's drawn columns, and the
+    // draws must not depend on the thread count
+    void ObliviousTest::test_column_sampling() {
+        const size_t nrows = 2000;
+        const auto data = wavy_data(nrows);
+        std::vector<size_t> seq(nrows);
+        std::iota(seq.begin(), seq.end(), 0);
+
+        ThreadPool pool(4);
+        for (const size_t seed : { 1, 2, 3 }) {
+            TreeParams params;
+            params.tree_col_fraction = 0.6;
+            params.node_col_fraction = 0.5;
+            std::vector<size_t> tree_cols;
+            sample_columns(data.ncol(), params.tree_col_fraction, seed, 0, tree_cols);
+            CPPUNIT_ASSERT_EQUAL(size_t(2), tree_cols.size());
+
+            const typename ObliviousTree<float>::Trainer serial(params);
+            const typename ObliviousTree<float>::Trainer threaded(params, &pool);
+            const auto expected = serial.fit(data, seq.begin(), seq.end(), seed);
+            const auto actual = threaded.fit(data, seq.begin(), seq.end(), seed);
+            CPPUNIT_ASSERT(expected.depth() > 0);
+            CPPUNIT_ASSERT_EQUAL(expected.depth(), actual.depth());
+            for (size_t level = 0; level != expected.depth(); ++level) {
+                CPPUNIT_ASSERT(std::binary_search(
+                    tree_cols.begin(), tree_cols.end(), expected.split_col(level)));
+                CPPUNIT_ASSERT_EQUAL(expected.split_col(level), actual.split_col(level));
+                CPPUNIT_ASSERT_EQUAL(expected.split_val(level), actual.split_val(level));
+            }
+            CPPUNIT_ASSERT(expected.leaves() == actual.leaves());
+        }
+    }
+
+    // a reused workspace must fit the same trees as a fresh one, whatever
+    // the rows of the tree before
+    void ObliviousTest::test_workspace() {
+        const size_t nrows = 2000;
+        const auto data = wavy_data(nrows);
+        std::vector<size_t> seq(nrows);
+        std::vector<double> weights(nrows);
+
+        ThreadPool pool(4);
+        for (const auto method : { SplitMethod::exact, SplitMethod::histogram }) {
+            TreeParams params;
+            params.split_method = method;
+            params.tree_col_fraction = 0.7;
+            const typename ObliviousTree<float>::Trainer fresh(params);
+
+            typename ObliviousTree<float>::Workspace workspace;
+            const typename ObliviousTree<float>::Trainer reusing(
+                params, &pool, &workspace);
+
+            for (size_t round = 0; round != 4; ++round) {
+                // a different subset of rows each round, every other round
+                // as weighted distinct rows
+                for (size_t j = 0; j != nrows; ++j) {
+                    seq[j] = (j * (round + 1) * 7) % nrows;
+                }
+                ObliviousTree<float> expected;
+                ObliviousTree<float> actual;
+                if (round % 2 == 0) {
+                    expected = fresh.fit(data, seq.begin(), seq.end(), round);
+                    actual = reusing.fit(data, seq.begin(), seq.end(), round);
+                } else {
+                    std::fill(weights.begin(), weights.end(), 0.0);
+                    for (const auto row : seq) {
+                        weights[row] += 1;
+                    }
+                    std::sort(seq.begin(), seq.end());
+                    seq.erase(std::unique(seq.begin(), seq.end()), seq.end());
+                    expected = fresh.fit(
+                        data, weights, seq.begin(), seq.end(), round);
+                    actual = reusing.fit(
+                        data, weights, seq.begin(), seq.end(), round);
+                    seq.resize(nrows);
+                }
+
+                CPPUNIT_ASSERT(expected.depth() > 0);
+                CPPUNIT_ASSERT_EQUAL(expected.depth(), actual.depth());
+                for (size_t level = 0; level != expected.depth(); ++level) {
+                    CPPUNIT_ASSERT_EQUAL(
+                        expected.split_col(level), actual.split_col(level));
+                    CPPUNIT_ASSERT_EQUAL(
+                        expected.split_val(level), actual.split_val(level));
+                }
+                CPPUNIT_ASSERT(expected.leaves() == actual.leaves());
+
+                workspace.recycle(std::move(actual));
+                CPPUNIT_ASSERT_EQUAL(size_t(0), actual.size());
+            }
+        }
+    }
+}
@@ -0,0 +1,45 @@
+/*
+ * Copyright 2016-2017 Krysta M Bouzek
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <cppunit/extensions/HelperMacros.h>
+
+#ifndef KMBNW_ODVB_OBLIVIOUS_TEST_H
+#define KMBNW_ODVB_OBLIVIOUS_TEST_H
+
+namespace oddvibe {
+    class ObliviousTest : public CppUnit::TestFixture {
+        CPPUNIT_TEST_SUITE(ObliviousTest);
+        CPPUNIT_TEST(test_predict);
+        CPPUNIT_TEST(test_fit_perfect);
+        CPPUNIT_TEST(test_fit_histogram);
+        CPPUNIT_TEST(test_fit_weighted);
+        CPPUNIT_TEST(test_fit_threads);
+        CPPUNIT_TEST(test_column_sampling);
+        CPPUNIT_TEST(test_workspace);
+        CPPUNIT_TEST_SUITE_END();
+
+        public:
+            void setUp();
+            void tearDown();
+            void test_predict();
+            void test_fit_perfect();
+            void test_fit_histogram();
+            void test_fit_weighted();
+            void test_fit_threads();
+            void test_column_sampling();
+            void test_workspace();
+    };
+}
+#endif
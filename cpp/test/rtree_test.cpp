@@ -15,11 +15,20 @@
  */
 
 #include <iostream>
+#include <cstdint>
 #include <random>
 #include <cmath>
 #include <vector>
+#include <limits>
+#include <numeric>
+#include <mutex>
+#include <algorithm>
 #include "../../src/rtree.h"
+#include "../../src/column_sample.h"
+#include "../../src/flat_tree.h"
+#include "../../src/predictor.h"
 #include "../../src/float_matrix.h"
+#include "test_data.h"
 #include "rtree_test.h"
 
 #include <cppunit/extensions/TestFactoryRegistry.h>
@@ -183,4 +192,682 @@ namespace oddvibe {
         CPPUNIT_ASSERT_EQUAL(expected_feature, col);
         CPPUNIT_ASSERT_DOUBLES_EQUAL(expected_val, value, m_tolerance);
     }
+
+    // sorted scan must agree with rescanning every unique value
+    void RTreeTest::test_best_split_vs_rescan() {
+        std::mt19937 generator(1480561820L);
+        std::uniform_int_distribution<int> coarse(0, 9);
+        std::normal_distribution<double> fine(0.0, 3.0);
+        const size_t nrows = 300;
+        const size_t nfeatures = 3;
+
+        // column 0 has many ties, column 1 is continuous, column 2 is noise
+        std::vector<double> xs(nrows * nfeatures);
+        std::vector<double> ys(nrows);
+        for (size_t j = 0; j != nrows; ++j) {
+            const double x0 = coarse(generator);
+            const double x1 = fine(generator);
+            xs[j] = x0;
+            xs[j + nrows] = x1;
+            xs[j + 2 * nrows] = fine(generator);
+            ys[j] = 3.0 * x0 - 0.5 * x1 * x1 + fine(generator);
+        }
+
+        const Dataset<double> data(
+            FloatMatrix<double>(nfeatures, xs),
+            std::vector<double>(ys));
+
+        // sample with replacement, as the Booster does
+        std::uniform_int_distribution<size_t> pick(0, nrows - 1);
+        std::vector<size_t> seq(nrows);
+        for (auto& row : seq) {
+            row = pick(generator);
+        }
+
+        double expected_err = std::numeric_limits<double>::max();
+        for (size_t col = 0; col != nfeatures; ++col) {
+            for (const auto value : data.unique_x(col, seq.begin(), seq.end())) {
+                const auto err = data.calc_total_err(
+                    col, value, seq.begin(), seq.end());
+                expected_err = std::min(expected_err, err);
+            }
+        }
+
+        const auto split = best_split(data, seq.begin(), seq.end());
+        CPPUNIT_ASSERT_EQUAL(true, split.is_valid());
+
+        const auto actual_err = data.calc_total_err(
+            split.split_col(), split.split_val(), seq.begin(), seq.end());
+
+        CPPUNIT_ASSERT_DOUBLES_EQUAL(
+            expected_err, actual_err, 1e-9 * expected_err);
+    }
+
+    // with at least one bin per distinct value, bins lose nothing
+    void RTreeTest::test_best_split_histogram() {
+        std::mt19937 generator(1480561820L);
+        std::uniform_int_distribution<int> coarse(0, 20);
+        const size_t nrows = 200;
+        const size_t nfeatures = 2;
+
+        std::vector<float> xs(nrows * nfeatures);
+        std::vector<float> ys(nrows);
+        for (size_t j = 0; j != nrows; ++j) {
+            xs[j] = coarse(generator);
+            xs[j + nrows] = coarse(generator);
+            ys[j] = (xs[j + nrows] > 12 ? 10.0f : 1.0f) + 0.1f * xs[j];
+        }
+
+        const Dataset<float> data(
+            FloatMatrix<float>(nfeatures, xs),
+            std::vector<float>(ys));
+
+        std::vector<size_t> seq(nrows);
+        std::iota(seq.begin(), seq.end(), 0);
+
+        const auto binned = data.bins(32);
+        const auto& bins = *binned;
+        Histogram hist(bins.total_slots());
+        hist.add(bins, data.ys(), 0.0, seq.begin(), seq.end());
+
+        // replacing the cached bins must leave ours intact
+        CPPUNIT_ASSERT_EQUAL(size_t(64), data.bins(64)->max_bins());
+        CPPUNIT_ASSERT_EQUAL(size_t(32), bins.max_bins());
+
+        const auto expected = best_split(data, seq.begin(), seq.end());
+        const auto actual = best_split(bins, hist);
+
+        const size_t expected_feature = 1;
+        CPPUNIT_ASSERT_EQUAL(true, actual.is_valid());
+        CPPUNIT_ASSERT_EQUAL(expected_feature, expected.split_col());
+        CPPUNIT_ASSERT_EQUAL(expected.split_col(), actual.split_col());
+        CPPUNIT_ASSERT_DOUBLES_EQUAL(
+            expected.split_val(), actual.split_val(), m_tolerance);
+    }
+
+    // presorted columns must agree with sorting each node, before and
+    // after the node is split
+    void RTreeTest::test_best_split_presorted() {
+        std::mt19937 generator(1480561820L);
+        std::uniform_int_distribution<int> coarse(0, 9);
+        std::normal_distribution<double> fine(0.0, 3.0);
+        const size_t nrows = 300;
+        const size_t nfeatures = 2;
+
+        std::vector<double> xs(nrows * nfeatures);
+        std::vector<double> ys(nrows);
+        for (size_t j = 0; j != nrows; ++j) {
+            xs[j] = coarse(generator);
+            xs[j + nrows] = fine(generator);
+            ys[j] = xs[j] + std::abs(xs[j + nrows]) + fine(generator);
+        }
+
+        const Dataset<double> data(
+            FloatMatrix<double>(nfeatures, xs),
+            std::vector<double>(ys));
+
+        std::uniform_int_distribution<size_t> pick(0, nrows - 1);
+        std::vector<size_t> seq(nrows);
+        for (auto& row : seq) {
+            row = pick(generator);
+        }
+
+        SortedColumns cols;
+        cols.assign(data.column_index(), seq.begin(), seq.end());
+        CPPUNIT_ASSERT_EQUAL(nrows, cols.count());
+
+        const auto check = [&data, &cols](
+                const size_t offset,
+                const std::vector<size_t>::iterator first,
+                const std::vector<size_t>::iterator last) {
+            const size_t count = std::distance(first, last);
+            const auto y_center = mean<double>(data.ys(), first, last);
+            const auto expected = best_split(data, first, last);
+            const auto actual = best_split(data, cols, offset, count, y_center);
+            CPPUNIT_ASSERT_EQUAL(expected.is_valid(), actual.is_valid());
+            CPPUNIT_ASSERT_EQUAL(expected.split_col(), actual.split_col());
+            CPPUNIT_ASSERT_EQUAL(expected.split_val(), actual.split_val());
+            return actual;
+        };
+
+        const auto split = check(0, seq.begin(), seq.end());
+        const auto pivot = split.partition_idx(data.xs(), seq.begin(), seq.end());
+        const auto nleft = cols.partition(
+            0,
+            nrows,
+            [&split, &data](const size_t row) {
+                return split.is_left(data.xs(), row);
+            });
+
+        CPPUNIT_ASSERT_EQUAL(
+            nleft, static_cast<size_t>(std::distance(seq.begin(), pivot)));
+        check(0, seq.begin(), pivot);
+        check(nleft, pivot, seq.end());
+    }
+
+    // the chosen split must not depend on the number of threads
+    void RTreeTest::test_best_split_threads() {
+        std::mt19937 generator(1480561820L);
+        std::uniform_int_distribution<int> coarse(0, 50);
+        std::normal_distribution<float> fine(0.0f, 3.0f);
+        const size_t nrows = 3 * split_block_rows + 17;
+        const size_t nfeatures = 3;
+
+        std::vector<float> xs(nrows * nfeatures);
+        std::vector<float> ys(nrows);
+        for (size_t j = 0; j != nrows; ++j) {
+            xs[j] = coarse(generator);
+            xs[j + nrows] = fine(generator);
+            xs[j + 2 * nrows] = coarse(generator);
+            ys[j] = xs[j] - xs[j + 2 * nrows] + fine(generator);
+        }
+
+        const Dataset<float> data(
+            FloatMatrix<float>(nfeatures, xs),
+            std::vector<float>(ys));
+
+        std::vector<size_t> seq(nrows);
+        std::iota(seq.begin(), seq.end(), 0);
+        const auto y_center = mean<float>(data.ys(), seq.begin(), seq.end());
+
+        SortedColumns cols;
+        cols.assign(data.column_index(), seq.begin(), seq.end());
+        const auto expected = best_split(data, cols, 0, nrows, y_center);
+
+        for (const size_t nthreads : { 2, 3, 8 }) {
+            ThreadPool pool(nthreads);
+            const auto actual = best_split(
+                data, cols, 0, nrows, y_center, &pool);
+            CPPUNIT_ASSERT_EQUAL(true, actual.is_valid());
+            CPPUNIT_ASSERT_EQUAL(expected.split_col(), actual.split_col());
+            CPPUNIT_ASSERT_EQUAL(expected.split_val(), actual.split_val());
+        }
+
+        const auto binned = data.bins(64);
+        const auto& bins = *binned;
+        Histogram hist(bins.total_slots());
+        hist.add(bins, data.ys(), y_center, seq.begin(), seq.end());
+        const auto expected_binned = best_split(bins, hist);
+
+        ThreadPool pool(4);
+        Histogram pooled_hist(bins.total_slots());
+        pooled_hist.add(
+            bins, data.ys(), y_center, seq.begin(), seq.end(), &pool);
+        const auto actual_binned = best_split(bins, pooled_hist, &pool);
+        CPPUNIT_ASSERT_EQUAL(
+            expected_binned.split_col(), actual_binned.split_col());
+        CPPUNIT_ASSERT_EQUAL(
+            expected_binned.split_val(), actual_binned.split_val());
+    }
+
+    // subtrees fitted in parallel must give the same tree
+    void RTreeTest::test_fit_threads() {
+        const size_t nrows = 5000;
+        const size_t nfeatures = 3;
+        const Dataset<float> data = product_data(nrows, nfeatures);
+
+        for (const auto method : { SplitMethod::exact, SplitMethod::histogram }) {
+            TreeParams params;
+            params.split_method = method;
+            params.min_parallel_rows = 16;
+
+            std::vector<size_t> seq(nrows);
+            std::iota(seq.begin(), seq.end(), 0);
+            const typename RTree<float>::Trainer serial(params);
+            const auto expected = serial.fit(
+                data, seq.begin(), seq.end(), 0)->predict(data.xs());
+
+            ThreadPool pool(4);
+            std::iota(seq.begin(), seq.end(), 0);
+            const typename RTree<float>::Trainer parallel(params, &pool);
+            const auto actual = parallel.fit(
+                data, seq.begin(), seq.end(), 0)->predict(data.xs());
+
+            for (size_t j = 0; j != nrows; ++j) {
+                CPPUNIT_ASSERT_EQUAL(expected[j], actual[j]);
+            }
+        }
+    }
+
+    // a frozen tree must predict exactly what the pointer tree predicts
+    void RTreeTest::test_flat_tree() {
+        std::mt19937 generator(test_seed);
+        const size_t nrows = 1000;
+        const size_t nfeatures = 3;
+
+        auto xs = normal_features(generator, nrows, nfeatures);
+        const Dataset<float> data(
+            FloatMatrix<float>(nfeatures, xs), product_response(xs, nrows));
+
+        std::vector<size_t> seq(nrows);
+        std::iota(seq.begin(), seq.end(), 0);
+        const typename RTree<float>::Trainer trainer(6);
+        const auto tree = trainer.fit(data, seq.begin(), seq.end(), 0);
+        const FlatTree<float> flat_tree(*tree);
+
+        CPPUNIT_ASSERT(flat_tree.size() > 1);
+        CPPUNIT_ASSERT_EQUAL(size_t(6), flat_tree.depth());
+
+        // NaN features always go right
+        for (size_t j = 0; j < xs.size(); j += 7) {
+            xs[j] = std::numeric_limits<float>::quiet_NaN();
+        }
+        const FloatMatrix<float> test_xs(nfeatures, xs);
+
+        const auto expected = tree->predict(test_xs);
+        const auto actual = flat_tree.predict(test_xs);
+        for (size_t j = 0; j != nrows; ++j) {
+            CPPUNIT_ASSERT_EQUAL(expected[j], actual[j]);
+            CPPUNIT_ASSERT_EQUAL(expected[j], flat_tree.predict(test_xs, j));
+        }
+    }
+
+    // blocked and threaded prediction must match the block predict() row
+    // for row, for one tree and for a batch
+    void RTreeTest::test_block_predictor() {
+        const size_t nrows = 1013;
+        const size_t nfeatures = 3;
+        const Dataset<float> data = product_data(nrows, nfeatures);
+
+        std::vector<FlatTree<float>> trees;
+        std::vector<std::vector<float>> expected;
+        for (size_t depth = 1; depth != 5; ++depth) {
+            std::vector<size_t> seq(nrows / depth);
+            std::iota(seq.begin(), seq.end(), depth - 1);
+            const typename RTree<float>::Trainer trainer(depth);
+            trees.emplace_back(*trainer.fit(data, seq.begin(), seq.end(), 0));
+            expected.push_back(trees.back().predict(data.xs()));
+        }
+
+        ThreadPool pool(4);
+        for (auto pool_ptr : { static_cast<ThreadPool*>(nullptr), &pool }) {
+            for (size_t block_rows : { size_t(64), size_t(100), predict_block_rows }) {
+                BlockPredictor<float> predictor(pool_ptr, block_rows);
+
+                std::vector<float> actual(nrows);
+                predictor.predict(trees[2], data.xs(), actual.data());
+                CPPUNIT_ASSERT(expected[2] == actual);
+
+                std::vector<float> batch(trees.size() * nrows);
+                predictor.predict(trees, data.xs(), batch.data());
+                for (size_t t = 0; t != trees.size(); ++t) {
+                    CPPUNIT_ASSERT(std::equal(
+                        expected[t].begin(), expected[t].end(),
+                        batch.begin() + t * nrows));
+                }
+
+                std::vector<size_t> seen(nrows, 0);
+                std::mutex lock;
+                predictor.for_each_block(trees[0], data.xs(), [&](
+                        const size_t first,
+                        const size_t count,
+                        const float* yhats) {
+                    std::lock_guard<std::mutex> guard(lock);
+                    CPPUNIT_ASSERT(count <= block_rows);
+                    for (size_t k = 0; k != count; ++k) {
+                        CPPUNIT_ASSERT_EQUAL(expected[0][first + k], yhats[k]);
+                        ++seen[first + k];
+                    }
+                });
+                CPPUNIT_ASSERT(std::all_of(
+                    seen.begin(), seen.end(), [](size_t n) { return n == 1; }));
+            }
+        }
+
+        BlockPredictor<float> predictor;
+        std::vector<float> out(nrows);
+        CPPUNIT_ASSERT_THROW(
+            predictor.predict(FlatTree<float>(), data.xs(), out.data()),
+            std::logic_error);
+        CPPUNIT_ASSERT_THROW(BlockPredictor<float>(nullptr, 0), std::invalid_argument);
+    }
+
+    // weighting distinct rows by multiplicity should fit the same tree as
+    // repeating them
+    void RTreeTest::test_fit_weighted() {
+        std::mt19937 generator(test_seed);
+        const size_t nrows = 2000;
+        const size_t nfeatures = 3;
+
+        const auto xs = normal_features(generator, nrows, nfeatures);
+        const Dataset<float> data(
+            FloatMatrix<float>(nfeatures, xs), product_response(xs, nrows));
+
+        // a bootstrap sample and its multiplicities
+        std::uniform_int_distribution<size_t> row_dist(0, nrows - 1);
+        std::vector<size_t> sample(nrows);
+        std::vector<double> weights(nrows, 0);
+        std::vector<size_t> distinct;
+        for (auto & row : sample) {
+            row = row_dist(generator);
+            if (weights[row]++ == 0) {
+                distinct.push_back(row);
+            }
+        }
+
+        for (const auto method : { SplitMethod::exact, SplitMethod::histogram }) {
+            TreeParams params;
+            params.split_method = method;
+            const typename RTree<float>::Trainer trainer(params);
+
+            const auto expected = trainer.fit(
+                data, sample.begin(), sample.end(), 0)->predict(data.xs());
+            const auto actual = trainer.fit(
+                data, weights, distinct.begin(), distinct.end(), 0)->predict(
+                    data.xs());
+
+            for (size_t j = 0; j != nrows; ++j) {
+                CPPUNIT_ASSERT_DOUBLES_EQUAL(expected[j], actual[j], 1e-4);
+            }
+        }
+
+        CPPUNIT_ASSERT_THROW(
+            typename RTree<float>::Trainer(6).fit(
+                data, std::vector<double>(3, 1.0),
+                distinct.begin(), distinct.end(), 0),
+            std::invalid_argument);
+    }
+
+    // a view must train like the matrix it wraps without copying it
+    void RTreeTest::test_matrix_view() {
+        std::mt19937 generator(test_seed);
+        const size_t nrows = 1000;
+        const size_t nfeatures = 3;
+
+        const auto xs = normal_features(generator, nrows, nfeatures);
+        const auto ys = product_response(xs, nrows);
+
+        const Dataset<float> owned(FloatMatrix<float>(nfeatures, xs), ys);
+        const Dataset<float> viewed(
+            FloatMatrix<float>::view(nrows, nfeatures, xs.data()), ys);
+
+        CPPUNIT_ASSERT(owned.xs().owns_data());
+        CPPUNIT_ASSERT(!viewed.xs().owns_data());
+        CPPUNIT_ASSERT(viewed.xs().col_data(0) == xs.data());
+        CPPUNIT_ASSERT(viewed.xs().col_data(2) == xs.data() + 2 * nrows);
+        CPPUNIT_ASSERT_EQUAL(nrows, viewed.nrow());
+        CPPUNIT_ASSERT_EQUAL(nfeatures, viewed.ncol());
+
+        // copies of an owning matrix own their own values
+        const FloatMatrix<float> copy(owned.xs());
+        CPPUNIT_ASSERT(copy.owns_data());
+        CPPUNIT_ASSERT(copy.col_data(0) != owned.xs().col_data(0));
+        CPPUNIT_ASSERT_EQUAL(owned.xs()(7, 1), copy(7, 1));
+
+        std::vector<size_t> seq(nrows);
+        std::iota(seq.begin(), seq.end(), 0);
+        const typename RTree<float>::Trainer trainer(6);
+        const auto expected = trainer.fit(
+            owned, seq.begin(), seq.end(), 0)->predict(owned.xs());
+        std::iota(seq.begin(), seq.end(), 0);
+        const auto actual = trainer.fit(
+            viewed, seq.begin(), seq.end(), 0)->predict(viewed.xs());
+        for (size_t j = 0; j != nrows; ++j) {
+            CPPUNIT_ASSERT_EQUAL(expected[j], actual[j]);
+        }
+
+        CPPUNIT_ASSERT_THROW(
+            FloatMatrix<float>::view(nrows, nfeatures, nullptr),
+            std::invalid_argument);
+    }
+
+    // features with NaNs and with many distinct values, for binning
+    static Dataset<float> binning_data(const size_t nrows) {
+        std::mt19937 generator(test_seed);
+        const size_t nfeatures = 3;
+
+        auto xs = normal_features(generator, nrows, nfeatures);
+        const auto ys = product_response(xs, nrows);
+        for (size_t j = 0; j < nrows; j += 17) {
+            xs[j + nrows] = std::numeric_limits<float>::quiet_NaN();
+        }
+        return Dataset<float>(FloatMatrix<float>(nfeatures, xs), ys);
+    }
+
+    // codes must be one byte for up to 255 bins, two beyond, and must
+    // partition rows exactly as the raw values do
+    void RTreeTest::test_binned_codes() {
+        const size_t nrows = 3000;
+        const auto data = binning_data(nrows);
+
+        for (const size_t max_bins : { 32, 255, 1000 }) {
+            const BinnedMatrix<float> bins(data.xs(), max_bins);
+            CPPUNIT_ASSERT_EQUAL(
+                size_t(max_bins <= 255 ? 1 : 2), bins.code_bytes());
+
+            for (size_t col = 0; col != bins.ncol(); ++col) {
+                const auto nbins = bins.nbins(col);
+                CPPUNIT_ASSERT(nbins <= max_bins);
+                for (size_t row = 0; row != nrows; ++row) {
+                    const auto code = bins(row, col);
+                    const auto x = data.xs()(row, col);
+                    CPPUNIT_ASSERT_EQUAL(
+                        bins.code_bytes() == 1 ?
+                            size_t(bins.col_codes8(col)[row]) :
+                            size_t(bins.col_codes16(col)[row]),
+                        size_t(code));
+                    if (std::isnan(x)) {
+                        CPPUNIT_ASSERT_EQUAL(nbins, size_t(code));
+                    } else {
+                        CPPUNIT_ASSERT(x <= bins.edge(col, code));
+                    }
+                }
+
+                for (const size_t bin : { size_t(0), nbins / 2, nbins - 1 }) {
+                    CPPUNIT_ASSERT_EQUAL(
+                        bin, size_t(bins.bin_of(col, bins.edge(col, bin))));
+
+                    const SplitPoint<float> split(col, bins.edge(col, bin));
+                    std::vector<size_t> by_value(nrows);
+                    std::iota(by_value.begin(), by_value.end(), 0);
+                    std::vector<size_t> by_code(by_value);
+                    const auto value_pivot = split.partition_idx(
+                        data.xs(), by_value.begin(), by_value.end());
+                    const auto code_pivot = split.partition_idx(
+                        bins, by_code.begin(), by_code.end());
+
+                    CPPUNIT_ASSERT_EQUAL(
+                        std::distance(by_value.begin(), value_pivot),
+                        std::distance(by_code.begin(), code_pivot));
+                    std::sort(by_value.begin(), value_pivot);
+                    std::sort(by_code.begin(), code_pivot);
+                    CPPUNIT_ASSERT(std::equal(
+                        by_value.begin(), value_pivot, by_code.begin()));
+                }
+            }
+        }
+
+        // 65535 bins leave code 65535 for NaN; one more does not fit
+        const size_t widest = std::numeric_limits<uint16_t>::max();
+        std::vector<float> distinct(widest + 1);
+        std::iota(distinct.begin(), distinct.end(), 0.0f);
+        distinct.back() = std::numeric_limits<float>::quiet_NaN();
+        const FloatMatrix<float> wide(1, distinct);
+        const BinnedMatrix<float> widest_bins(wide, widest);
+        CPPUNIT_ASSERT_EQUAL(widest, widest_bins.nbins(0));
+        CPPUNIT_ASSERT_EQUAL(
+            size_t(widest - 1), size_t(widest_bins(widest - 1, 0)));
+        CPPUNIT_ASSERT_EQUAL(widest, size_t(widest_bins(widest, 0)));
+        CPPUNIT_ASSERT_THROW(
+            BinnedMatrix<float>(wide, widest + 1), std::invalid_argument);
+        CPPUNIT_ASSERT_THROW(
+            BinnedMatrix<float>(wide, 1), std::invalid_argument);
+    }
+
+    // fitting on bins alone must give the histogram tree of the Dataset
+    void RTreeTest::test_fit_binned() {
+        const size_t nrows = 3000;
+        const auto data = binning_data(nrows);
+
+        for (const size_t max_bins : { 64, 1000 }) {
+            TreeParams params;
+            params.split_method = SplitMethod::histogram;
+            params.max_bins = max_bins;
+            const typename RTree<float>::Trainer trainer(params);
+
+            std::vector<size_t> seq(nrows);
+            std::iota(seq.begin(), seq.end(), 0);
+            const auto expected = trainer.fit(
+                data, seq.begin(), seq.end(), 0)->predict(data.xs());
+
+            const BinnedMatrix<float> bins(data.xs(), max_bins);
+            std::iota(seq.begin(), seq.end(), 0);
+            const auto actual = trainer.fit(
+                bins, data.ys(), seq.begin(), seq.end(), 0)->predict(data.xs());
+
+            for (size_t j = 0; j != nrows; ++j) {
+                CPPUNIT_ASSERT_EQUAL(expected[j], actual[j]);
+            }
+        }
+    }
+
+    // trees fitted from recycled nodes and buffers must match fresh ones,
+    // with or without threads
+    void RTreeTest::test_workspace() {
+        const size_t nrows = 3000;
+        const auto data = binning_data(nrows);
+        std::vector<size_t> seq(nrows);
+
+        ThreadPool pool(4);
+        for (const auto method : { SplitMethod::exact, SplitMethod::histogram }) {
+            TreeParams params;
+            params.split_method = method;
+            params.min_parallel_rows = 100;
+            const typename RTree<float>::Trainer fresh(params);
+
+            typename RTree<float>::Workspace workspace;
+            const typename RTree<float>::Trainer reusing(
+                params, &pool, &workspace);
+
+            for (size_t round = 0; round != 3; ++round) {
+                // a different subset of rows each round
+                for (size_t j = 0; j != nrows; ++j) {
+                    seq[j] = (j * (round + 1) * 7) % nrows;
+                }
+                const FlatTree<float> expected(
+                    *fresh.fit(data, seq.begin(), seq.end(), 0));
+
+                auto tree = reusing.fit(data, seq.begin(), seq.end(), 0);
+                const FlatTree<float> actual(*tree);
+                CPPUNIT_ASSERT(
+                    expected.predict(data.xs()) == actual.predict(data.xs()));
+
+                const auto nfree = workspace.nfree();
+                workspace.recycle(std::move(tree));
+                CPPUNIT_ASSERT_EQUAL(nfree + actual.size(), workspace.nfree());
+            }
+        }
+    }
+
+    // column draws must depend only on the seed, searching a subset must
+    // match searching the same columns alone, and a tree must never split
+    // on a column it did not draw
+    void RTreeTest::test_column_sampling() {
+        std::vector<size_t> drawn;
+        sample_columns(40, 0.3, 7, 3, drawn);
+        CPPUNIT_ASSERT_EQUAL(size_t(12), drawn.size());
+        CPPUNIT_ASSERT(std::is_sorted(drawn.begin(), drawn.end()));
+        CPPUNIT_ASSERT(drawn.back() < 40);
+        std::vector<size_t> again;
+        sample_columns(40, 0.3, 7, 3, again);
+        CPPUNIT_ASSERT(drawn == again);
+        sample_columns(40, 0.01, 7, 3, again);
+        CPPUNIT_ASSERT_EQUAL(size_t(1), again.size());
+        CPPUNIT_ASSERT_THROW(
+            sample_columns(40, 0.0, 7, 3, again), std::invalid_argument);
+
+        std::mt19937 generator(test_seed);
+        const size_t nrows = 2000;
+        const size_t nfeatures = 12;
+        const auto xs = normal_features(generator, nrows, nfeatures);
+        std::vector<float> ys(nrows);
+        for (size_t j = 0; j != nrows; ++j) {
+            ys[j] = (
+                xs[j] * xs[j + nrows] + std::abs(xs[j + 5 * nrows]) +
+                xs[j + 9 * nrows]);
+        }
+        const Dataset<float> data(FloatMatrix<float>(nfeatures, xs), ys);
+
+        std::vector<size_t> seq(nrows);
+        std::iota(seq.begin(), seq.end(), 0);
+        const auto y_center = mean<float>(data.ys(), seq.begin(), seq.end());
+        const std::vector<size_t> subset = { 2, 5, 6 };
+        SplitScratch<float>* const no_scratch = nullptr;
+
+        SortedColumns all_cols, subset_cols;
+        all_cols.assign(data.column_index(), seq.begin(), seq.end());
+        subset_cols.assign(data.column_index(), seq.begin(), seq.end(), &subset);
+        CPPUNIT_ASSERT(subset_cols.columns() == subset);
+        const auto expected = best_split(data, subset_cols, 0, nrows, y_center);
+        const auto actual = best_split(
+            data, all_cols, 0, nrows, y_center, nullptr, UnitWeights(),
+            no_scratch, &subset);
+        CPPUNIT_ASSERT_EQUAL(size_t(5), expected.split_col());
+        CPPUNIT_ASSERT_EQUAL(expected.split_col(), actual.split_col());
+        CPPUNIT_ASSERT_EQUAL(expected.split_val(), actual.split_val());
+
+        const auto cached_bins = data.bins(64);
+        const auto& bins = *cached_bins;
+        Histogram all_hist(bins.total_slots());
+        all_hist.add(bins, data.ys(), y_center, seq.begin(), seq.end());
+        Histogram subset_hist(bins.total_slots());
+        subset_hist.add(
+            bins, data.ys(), y_center, seq.begin(), seq.end(), nullptr,
+            UnitWeights(), &subset);
+        const auto binned = best_split(
+            bins, all_hist, nullptr, no_scratch, &subset);
+        const auto subset_binned = best_split(
+            bins, subset_hist, nullptr, no_scratch, &subset);
+        CPPUNIT_ASSERT_EQUAL(size_t(5), binned.split_col());
+        CPPUNIT_ASSERT_EQUAL(binned.split_col(), subset_binned.split_col());
+        CPPUNIT_ASSERT_EQUAL(binned.split_val(), subset_binned.split_val());
+
+        ThreadPool pool(4);
+        const size_t seed = 12345;
+        std::vector<size_t> tree_cols;
+        sample_columns(nfeatures, 0.25, seed, 0, tree_cols);
+
+        // the columns the tree did not draw, replaced by a constant
+        std::vector<float> masked(xs);
+        for (size_t col = 0; col != nfeatures; ++col) {
+            if (!std::binary_search(tree_cols.begin(), tree_cols.end(), col)) {
+                std::fill_n(masked.begin() + col * nrows, nrows, 0.0f);
+            }
+        }
+        const FloatMatrix<float> masked_xs(nfeatures, masked);
+
+        for (const auto method : { SplitMethod::exact, SplitMethod::histogram }) {
+            TreeParams params;
+            params.split_method = method;
+            params.min_parallel_rows = 100;
+
+            // drawing every column ignores the seed
+            const typename RTree<float>::Trainer full(params);
+            CPPUNIT_ASSERT(
+                full.fit(data, seq.begin(), seq.end(), 0)->predict(data.xs()) ==
+                full.fit(data, seq.begin(), seq.end(), 0, seed)->predict(
+                    data.xs()));
+
+            params.tree_col_fraction = 0.25;
+            params.node_col_fraction = 0.5;
+            const typename RTree<float>::Trainer serial(params);
+            const auto tree = serial.fit(data, seq.begin(), seq.end(), 0, seed);
+            const auto yhats = tree->predict(data.xs());
+            CPPUNIT_ASSERT(yhats == tree->predict(masked_xs));
+
+            typename RTree<float>::Workspace workspace;
+            const typename RTree<float>::Trainer parallel(
+                params, &pool, &workspace);
+            CPPUNIT_ASSERT(
+                yhats ==
+                parallel.fit(data, seq.begin(), seq.end(), 0, seed)->predict(
+                    data.xs()));
+
+            params.node_col_fraction = 0.0;
+            const typename RTree<float>::Trainer invalid(params);
+            CPPUNIT_ASSERT_THROW(
+                invalid.fit(data, seq.begin(), seq.end(), 0, seed),
+                std::invalid_argument);
+        }
+    }
 }
@@ -27,6 +27,19 @@ namespace oddvibe {
         CPPUNIT_TEST(test_best_split_perfect);
         CPPUNIT_TEST(test_best_split_near_perfect);
         CPPUNIT_TEST(test_best_split_formula);
+        CPPUNIT_TEST(test_best_split_vs_rescan);
+        CPPUNIT_TEST(test_best_split_histogram);
+        CPPUNIT_TEST(test_best_split_presorted);
+        CPPUNIT_TEST(test_best_split_threads);
+        CPPUNIT_TEST(test_fit_threads);
+        CPPUNIT_TEST(test_flat_tree);
+        CPPUNIT_TEST(test_block_predictor);
+        CPPUNIT_TEST(test_fit_weighted);
+        CPPUNIT_TEST(test_matrix_view);
+        CPPUNIT_TEST(test_binned_codes);
+        CPPUNIT_TEST(test_fit_binned);
+        CPPUNIT_TEST(test_workspace);
+        CPPUNIT_TEST(test_column_sampling);
         CPPUNIT_TEST_SUITE_END();
 
         private:
@@ -39,6 +52,19 @@ namespace oddvibe {
             void test_best_split_perfect();
             void test_best_split_near_perfect();
             void test_best_split_formula();
+            void test_best_split_vs_rescan();
+            void test_best_split_histogram();
+            void test_best_split_presorted();
+            void test_best_split_threads();
+            void test_fit_threads();
+            void test_flat_tree();
+            void test_block_predictor();
+            void test_fit_weighted();
+            void test_matrix_view();
+            void test_binned_codes();
+            void test_fit_binned();
+            void test_workspace();
+            void test_column_sampling();
     };
 }
 #endif
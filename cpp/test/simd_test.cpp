@@ -0,0 +1,151 @@
+/*
+ * Copyright 2016-2017 Krysta M Bouzek
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <cmath>
+#include <random>
+#include <vector>
+#include <algorithm>
+#include "../../src/simd_kernels.h"
+#include "simd_test.h"
+
+#include <cppunit/extensions/HelperMacros.h>
+
+CPPUNIT_TEST_SUITE_REGISTRATION(oddvibe::SimdTest);
+
+namespace oddvibe {
+
+    void SimdTest::setUp() {
+    }
+
+    void SimdTest::tearDown() {
+    }
+
+    // sizes that exercise empty, partial and whole registers
+    static const std::vector<size_t> test_sizes = { 1, 3, 7, 8, 9, 16, 31, 1003 };
+
+    // every instruction set must give bit-identical results
+    void SimdTest::test_kernels_match_scalar() {
+        const SimdKernels& scalar = *simd_kernels(SimdLevel::scalar);
+        std::mt19937 generator(1480561820L);
+        std::normal_distribution<double> dist(0.0, 2.0);
+
+        for (const auto level : { SimdLevel::avx2, SimdLevel::avx512 }) {
+            const SimdKernels* kernels = simd_kernels(level);
+            if (kernels == nullptr) {
+                continue;
+            }
+            CPPUNIT_ASSERT(kernels->level == level);
+
+            for (const auto n : test_sizes) {
+                std::vector<float> ys_f(n), yhats_f(n), pmf(n);
+                std::vector<double> ys_d(n), yhats_d(n);
+                for (size_t k = 0; k != n; ++k) {
+                    ys_d[k] = dist(generator);
+                    yhats_d[k] = dist(generator);
+                    ys_f[k] = ys_d[k];
+                    yhats_f[k] = yhats_d[k];
+                    pmf[k] = std::abs(dist(generator)) / n;
+                }
+
+                std::vector<double> expected(n), actual(n);
+                scalar.squared_error_f32(ys_f.data(), yhats_f.data(), expected.data(), n);
+                kernels->squared_error_f32(ys_f.data(), yhats_f.data(), actual.data(), n);
+                CPPUNIT_ASSERT(expected == actual);
+
+                scalar.squared_error_f64(ys_d.data(), yhats_d.data(), expected.data(), n);
+                kernels->squared_error_f64(ys_d.data(), yhats_d.data(), actual.data(), n);
+                CPPUNIT_ASSERT(expected == actual);
+
+                const auto& loss = expected;
+                const double max_loss = scalar.max_value(loss.data(), n);
+                CPPUNIT_ASSERT_EQUAL(max_loss, kernels->max_value(loss.data(), n));
+                CPPUNIT_ASSERT_EQUAL(
+                    scalar.dot(pmf.data(), loss.data(), n),
+                    kernels->dot(pmf.data(), loss.data(), n));
+                CPPUNIT_ASSERT_EQUAL(
+                    scalar.sum(pmf.data(), n), kernels->sum(pmf.data(), n));
+
+                std::vector<float> pmf_expected(pmf), pmf_actual(pmf);
+                scalar.reweight(pmf_expected.data(), loss.data(), n, -1.7, max_loss);
+                kernels->reweight(pmf_actual.data(), loss.data(), n, -1.7, max_loss);
+                CPPUNIT_ASSERT(pmf_expected == pmf_actual);
+
+                // sums built up over blocks must match whole-vector sums
+                const size_t split = (n / 2) - (n / 2) % simd_lanes;
+                double lanes[simd_lanes] = { 0 };
+                kernels->dot_lanes(pmf.data(), loss.data(), split, lanes);
+                kernels->dot_lanes(
+                    pmf.data() + split, loss.data() + split, n - split, lanes);
+                CPPUNIT_ASSERT_EQUAL(
+                    scalar.dot(pmf.data(), loss.data(), n),
+                    simd_lane_total(lanes));
+
+                std::vector<float> pmf_fused(pmf);
+                std::fill(lanes, lanes + simd_lanes, 0.0);
+                kernels->reweight_sum_lanes(
+                    pmf_fused.data(), loss.data(), split, -1.7, max_loss, lanes);
+                kernels->reweight_sum_lanes(
+                    pmf_fused.data() + split, loss.data() + split, n - split,
+                    -1.7, max_loss, lanes);
+                CPPUNIT_ASSERT(pmf_expected == pmf_fused);
+                CPPUNIT_ASSERT_EQUAL(
+                    scalar.sum(pmf_expected.data(), n), simd_lane_total(lanes));
+
+                scalar.divide(pmf_expected.data(), n, 0.37);
+                kernels->divide(pmf_actual.data(), n, 0.37);
+                CPPUNIT_ASSERT(pmf_expected == pmf_actual);
+            }
+        }
+    }
+
+    void SimdTest::test_scalar_kernels() {
+        const SimdKernels& kernels = simd_kernels();
+        const std::vector<float> ys = { 1.0f, 2.0f, -3.0f };
+        const std::vector<float> yhats = { 1.5f, 0.0f, 1.0f };
+        std::vector<double> loss(3);
+        kernels.squared_error_f32(ys.data(), yhats.data(), loss.data(), 3);
+        CPPUNIT_ASSERT((loss == std::vector<double>{ 0.25, 4.0, 16.0 }));
+
+        CPPUNIT_ASSERT_EQUAL(16.0, kernels.max_value(loss.data(), 3));
+        const std::vector<float> weights = { 0.5f, 0.25f, 0.25f };
+        CPPUNIT_ASSERT_EQUAL(5.125, kernels.dot(weights.data(), loss.data(), 3));
+        CPPUNIT_ASSERT_EQUAL(1.0, kernels.sum(weights.data(), 3));
+        CPPUNIT_ASSERT_EQUAL(0.0, kernels.sum(weights.data(), 0));
+
+        std::vector<float> halves(weights);
+        kernels.divide(halves.data(), 3, 2.0);
+        CPPUNIT_ASSERT((halves == std::vector<float>{ 0.25f, 0.125f, 0.125f }));
+    }
+
+    // the shared exp approximation must be as good as pow for float weights
+    void SimdTest::test_reweight_accuracy() {
+        const size_t n = 1000;
+        std::vector<double> loss(n);
+        for (size_t k = 0; k != n; ++k) {
+            loss[k] = k / (n - 1.0);
+        }
+
+        for (const double beta : { 1e-300, 1e-9, 0.01, 0.3, 0.999 }) {
+            std::vector<float> pmf(n, 1.0f / n);
+            simd_kernels().reweight(pmf.data(), loss.data(), n, std::log(beta), 1.0);
+            for (size_t k = 0; k != n; ++k) {
+                const float expected = static_cast<float>(
+                    std::pow(beta, 1 - loss[k]) * (1.0f / n));
+                CPPUNIT_ASSERT_DOUBLES_EQUAL(
+                    expected, pmf[k], 1e-6 * expected + 1e-44);
+            }
+        }
+    }
+}
@@ -0,0 +1,211 @@
+/*
+ * Copyright 2016-2017 Krysta M Bouzek
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <cmath>
+#include <random>
+#include <vector>
+#include <limits>
+#include <numeric>
+#include <algorithm>
+#include "../../src/quantile_sketch.h"
+#include "../../src/binned_matrix.h"
+#include "../../src/dataset.h"
+#include "../../src/rtree.h"
+#include "../../src/thread_pool.h"
+#include "test_data.h"
+#include "sketch_test.h"
+
+#include <cppunit/extensions/HelperMacros.h>
+
+CPPUNIT_TEST_SUITE_REGISTRATION(oddvibe::SketchTest);
+
+namespace oddvibe {
+
+    void SketchTest::setUp() {
+    }
+
+    void SketchTest::tearDown() {
+    }
+
+    /**
+     * Largest distance between `q` and the true fraction of `sorted` at or
+     * below the sketch's estimate of quantile `q`, over a grid of `q`.
+     */
+    static double max_rank_error(
+            const QuantileSketch<float>& sketch,
+            const std::vector<float>& sorted) {
+        double worst = 0;
+        for (size_t step = 1; step != 100; ++step) {
+            const double q = step / 100.0;
+            const auto value = sketch.quantile(q);
+            const double rank = std::distance(
+                sorted.begin(),
+                std::upper_bound(sorted.begin(), sorted.end(), value));
+            worst = std::max(worst, std::abs(rank / sorted.size() - q));
+        }
+        return worst;
+    }
+
+    // a sketch that has kept every value must bin exactly as sorting does
+    void SketchTest::test_exact_bins() {
+        std::mt19937 generator(1480561820L);
+        std::normal_distribution<float> dist(0.0f, 1.0f);
+        const size_t nrows = 3000;
+        const size_t nfeatures = 2;
+
+        std::vector<float> xs(nrows * nfeatures);
+        std::generate(xs.begin(), xs.end(), [&]() { return dist(generator); });
+        for (size_t j = 0; j != nrows; ++j) {
+            // few distinct values, some missing
+            xs[j + nrows] = std::round(xs[j + nrows] * 4);
+            if (j % 17 == 0) {
+                xs[j + nrows] = std::numeric_limits<float>::quiet_NaN();
+            }
+        }
+        const FloatMatrix<float> mat(nfeatures, xs);
+        const auto sketches = sketch_columns(mat, 4096);
+        CPPUNIT_ASSERT_EQUAL(nrows, sketches[0].count());
+        CPPUNIT_ASSERT_EQUAL(nrows - (nrows + 16) / 17, sketches[1].count());
+
+        for (const size_t max_bins : { 32, 1000 }) {
+            const BinnedMatrix<float> expected(mat, max_bins);
+            const BinnedMatrix<float> actual(mat, max_bins, sketches);
+            CPPUNIT_ASSERT_EQUAL(expected.code_bytes(), actual.code_bytes());
+            for (size_t col = 0; col != nfeatures; ++col) {
+                CPPUNIT_ASSERT_EQUAL(expected.nbins(col), actual.nbins(col));
+                for (size_t bin = 0; bin != expected.nbins(col); ++bin) {
+                    CPPUNIT_ASSERT_EQUAL(
+                        expected.edge(col, bin), actual.edge(col, bin));
+                }
+                for (size_t row = 0; row != nrows; ++row) {
+                    CPPUNIT_ASSERT_EQUAL(expected(row, col), actual(row, col));
+                }
+            }
+        }
+    }
+
+    // a long stream must be summarized in little memory with a small
+    // rank error, and its cuts must cover every value
+    void SketchTest::test_rank_error() {
+        std::mt19937 generator(1480561820L);
+        std::lognormal_distribution<float> dist(0.0f, 1.0f);
+        const size_t nvalues = 200000;
+
+        std::vector<float> values(nvalues);
+        QuantileSketch<float> sketch(200);
+        for (auto& value : values) {
+            value = dist(generator);
+            sketch.add(value);
+        }
+        sketch.add(std::numeric_limits<float>::quiet_NaN());
+        std::sort(values.begin(), values.end());
+
+        CPPUNIT_ASSERT_EQUAL(nvalues, sketch.count());
+        CPPUNIT_ASSERT(sketch.size() < 1000);
+        CPPUNIT_ASSERT_EQUAL(values.front(), sketch.min());
+        CPPUNIT_ASSERT_EQUAL(values.back(), sketch.max());
+        CPPUNIT_ASSERT_EQUAL(values.front(), sketch.quantile(0));
+        CPPUNIT_ASSERT(max_rank_error(sketch, values) < 0.02);
+
+        const auto cuts = sketch.cuts(255);
+        CPPUNIT_ASSERT(cuts.size() > 200 && cuts.size() <= 255);
+        CPPUNIT_ASSERT(std::adjacent_find(
+            cuts.begin(), cuts.end(), std::greater_equal<float>()) == cuts.end());
+        CPPUNIT_ASSERT_EQUAL(values.back(), cuts.back());
+
+        CPPUNIT_ASSERT(std::isnan(QuantileSketch<float>().quantile(0.5)));
+        CPPUNIT_ASSERT(QuantileSketch<float>().cuts(10).empty());
+        CPPUNIT_ASSERT_THROW(QuantileSketch<float>(4), std::invalid_argument);
+    }
+
+    // sketches of the parts of a stream must merge into a sketch of the
+    // whole
+    void SketchTest::test_merge() {
+        std::mt19937 generator(1480561820L);
+        std::normal_distribution<float> dist(0.0f, 1.0f);
+        const size_t nparts = 5;
+        const size_t part_values = 40000;
+
+        std::vector<float> values;
+        QuantileSketch<float> merged(200, 1);
+        for (size_t part = 0; part != nparts; ++part) {
+            QuantileSketch<float> sketch(200, part + 2);
+            for (size_t k = 0; k != part_values; ++k) {
+                // each part from a different range
+                const float value = dist(generator) + part;
+                values.push_back(value);
+                sketch.add(value);
+            }
+            merged.merge(sketch);
+        }
+        std::sort(values.begin(), values.end());
+
+        CPPUNIT_ASSERT_EQUAL(values.size(), merged.count());
+        CPPUNIT_ASSERT(merged.size() < 1000);
+        CPPUNIT_ASSERT_EQUAL(values.front(), merged.min());
+        CPPUNIT_ASSERT_EQUAL(values.back(), merged.max());
+        CPPUNIT_ASSERT(max_rank_error(merged, values) < 0.02);
+
+        QuantileSketch<float> other(100);
+        CPPUNIT_ASSERT_THROW(merged.merge(other), std::invalid_argument);
+    }
+
+    // sketching in parallel parts must not depend on the thread count,
+    // and trees fitted on sketched bins must not either
+    void SketchTest::test_sketch_columns() {
+        const size_t nrows = 5 * sketch_part_rows + 123;
+        const size_t nfeatures = 3;
+        std::mt19937 generator(test_seed);
+        const auto xs = normal_features(generator, nrows, nfeatures);
+        const Dataset<float> data(
+            FloatMatrix<float>(nfeatures, xs), product_response(xs, nrows));
+
+        ThreadPool pool(4);
+        const auto expected = data.column_sketches(200);
+        const auto actual = data.column_sketches(200, &pool);
+        for (size_t col = 0; col != nfeatures; ++col) {
+            CPPUNIT_ASSERT_EQUAL(nrows, actual[col].count());
+            CPPUNIT_ASSERT(expected[col].cuts(64) == actual[col].cuts(64));
+
+            std::vector<float> sorted(
+                xs.begin() + col * nrows, xs.begin() + (col + 1) * nrows);
+            std::sort(sorted.begin(), sorted.end());
+            CPPUNIT_ASSERT(max_rank_error(actual[col], sorted) < 0.02);
+        }
+
+        std::vector<size_t> seq(nrows);
+        std::iota(seq.begin(), seq.end(), 0);
+        TreeParams params;
+        params.split_method = SplitMethod::histogram;
+        params.sketch_k = 200;
+        const typename RTree<float>::Trainer serial(params);
+        const typename RTree<float>::Trainer parallel(params, &pool);
+        const auto serial_yhats = serial.fit(
+            data, seq.begin(), seq.end(), 0)->predict(data.xs());
+        const auto parallel_yhats = parallel.fit(
+            data, seq.begin(), seq.end(), 0)->predict(data.xs());
+        CPPUNIT_ASSERT(serial_yhats == parallel_yhats);
+
+        // the trainers take their bins from the sketches
+        const BinnedMatrix<float> sketched(data.xs(), 255, expected);
+        const auto cached_bins = data.bins(255, 200);
+        const auto& cached = *cached_bins;
+        for (size_t col = 0; col != nfeatures; ++col) {
+            CPPUNIT_ASSERT_EQUAL(sketched.nbins(col), cached.nbins(col));
+            CPPUNIT_ASSERT_EQUAL(
+                sketched.edge(col, 100), cached.edge(col, 100));
+        }
+    }
+}
@@ -0,0 +1,39 @@
+/*
+ * Copyright 2016-2017 Krysta M Bouzek
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <cppunit/extensions/HelperMacros.h>
+
+#ifndef KMBNW_ODVB_SKETCH_TEST_H
+#define KMBNW_ODVB_SKETCH_TEST_H
+
+namespace oddvibe {
+    class SketchTest : public CppUnit::TestFixture {
+        CPPUNIT_TEST_SUITE(SketchTest);
+        CPPUNIT_TEST(test_exact_bins);
+        CPPUNIT_TEST(test_rank_error);
+        CPPUNIT_TEST(test_merge);
+        CPPUNIT_TEST(test_sketch_columns);
+        CPPUNIT_TEST_SUITE_END();
+
+        public:
+            void setUp();
+            void tearDown();
+            void test_exact_bins();
+            void test_rank_error();
+            void test_merge();
+            void test_sketch_columns();
+    };
+}
+#endif
@@ -0,0 +1,90 @@
+/*
+ * Copyright 2016-2017 Krysta M Bouzek
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef KMBNW_ODVB_TEST_DATA_H
+#define KMBNW_ODVB_TEST_DATA_H
+
+#include <cstddef>
+#include <cmath>
+#include <random>
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+#include "../../src/float_matrix.h"
+#include "../../src/dataset.h"
+
+namespace oddvibe {
+    /**
+     * Seed of the random test data.
+     */
+    constexpr size_t test_seed = 1480561820L;
+
+    /**
+     * Draw column-major features from N(0, 1).
+     *
+     * \param generator Random engine to draw from.
+     * \param nrows Number of rows.
+     * \param nfeatures Number of feature columns.
+     * \return `nrows * nfeatures` values, one column after another.
+     */
+    inline std::vector<float> normal_features(
+            std::mt19937& generator,
+            const size_t nrows,
+            const size_t nfeatures) {
+        std::normal_distribution<float> dist(0.0f, 1.0f);
+        std::vector<float> xs(nrows * nfeatures);
+        std::generate(xs.begin(), xs.end(), [&]() { return dist(generator); });
+        return xs;
+    }
+
+    /**
+     * The response `x0 x1 + |x2|` of each row, which no single split fits.
+     *
+     * \param xs Column-major features with at least 3 columns.
+     * \param nrows Number of rows.
+     * \return The response of each row.
+     */
+    inline std::vector<float> product_response(
+            const std::vector<float>& xs,
+            const size_t nrows) {
+        if (xs.size() < 3 * nrows) {
+            throw std::invalid_argument("Must have at least 3 columns");
+        }
+        std::vector<float> ys(nrows);
+        for (size_t j = 0; j != nrows; ++j) {
+            ys[j] = xs[j] * xs[j + nrows] + std::abs(xs[j + 2 * nrows]);
+        }
+        return ys;
+    }
+
+    /**
+     * normal_features() drawn with test_seed and their product_response().
+     *
+     * \param nrows Number of rows.
+     * \param nfeatures Number of feature columns, at least 3.
+     * \return A new Dataset.
+     */
+    inline Dataset<float> product_data(
+            const size_t nrows,
+            const size_t nfeatures = 3) {
+        std::mt19937 generator(test_seed);
+        auto xs = normal_features(generator, nrows, nfeatures);
+        auto ys = product_response(xs, nrows);
+        return Dataset<float>(
+            FloatMatrix<float>(nfeatures, std::move(xs)), std::move(ys));
+    }
+}
+#endif //KMBNW_ODVB_TEST_DATA_H
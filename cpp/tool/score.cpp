@@ -0,0 +1,161 @@
+/*
+ * Copyright 2017 Krysta M Bouzek
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <iostream>
+#include <string>
+#include <fstream>
+#include <vector>
+#include <cstdlib>
+#include <exception>
+#include <stdexcept>
+#include <unistd.h>
+#include "../../src/params.h"
+#include "../../src/dataset.h"
+#include "../../src/thread_pool.h"
+#include "../../src/data_loader.h"
+#include "../../src/columnar_file.h"
+#include "../../src/booster.h"
+#include "../../src/round_stats.h"
+
+namespace {
+    void usage(const char* prog) {
+        std::cerr << "Usage: " << prog << " [options] FILE\n"
+            << "Score every row of FILE for how likely it is to be an "
+            << "outlier and print one\nscore per line.  FILE is a .csv text "
+            << "file, a .odvb columnar file or, with -c,\na raw file of "
+            << "doubles; the response is the last column.\n\n"
+            << "  -n ROUNDS  boosting rounds (default 100)\n"
+            << "  -s SEED    random seed (default 1480561820)\n"
+            << "  -t THREADS threads for loading and fitting; 0 for one "
+            << "per core (default 1)\n"
+            << "  -H         the CSV file has a header line\n"
+            << "  -d CHAR    CSV field delimiter (default ,)\n"
+            << "  -b         use histogram split search\n"
+            << "  -k K       with -b, take bin edges from quantile sketches "
+            << "of accuracy K\n"
+            << "  -o         fit oblivious trees\n"
+            << "  -f FRAC    fraction of the columns each tree may split on "
+            << "(default 1)\n"
+            << "  -F FRAC    fraction of a tree's columns searched per node "
+            << "(default 1)\n"
+            << "  -c NCOLS   FILE is raw doubles with NCOLS features per "
+            << "record\n"
+            << "  -j JSON    write per-round timings and statistics to JSON\n";
+    }
+
+    bool ends_with(const std::string& str, const std::string& suffix) {
+        return str.size() >= suffix.size() && str.compare(
+            str.size() - suffix.size(), suffix.size(), suffix) == 0;
+    }
+
+    /**
+     * Boost on `data`, print one score per row and, unless `json_path` is
+     * empty, write the per-round statistics there.
+     */
+    template <typename FloatT>
+    void score(
+            const oddvibe::Dataset<FloatT>& data,
+            const size_t seed,
+            const oddvibe::TreeParams& params,
+            const size_t nrounds,
+            const std::string& json_path) {
+        oddvibe::Booster booster(seed, params);
+        oddvibe::RoundStatsCollector collector;
+        if (!json_path.empty()) {
+            booster.set_observer(&collector);
+        }
+        const auto counts = booster.fit_counts(data, nrounds);
+        for (const auto count : counts) {
+            std::cout << count << '\n';
+        }
+
+        if (!json_path.empty()) {
+            std::ofstream json(json_path);
+            collector.write_json(json);
+            if (!json) {
+                throw std::runtime_error("Cannot write " + json_path);
+            }
+        }
+    }
+}
+
+// Standalone outlier scoring: load a file, boost, print the counts.
+int main(int argc, char **argv) {
+    using namespace oddvibe;
+
+    size_t nrounds = 100;
+    size_t seed = 1480561820L;
+    size_t raw_cols = 0;
+    std::string json_path;
+    CsvOptions csv;
+    TreeParams params;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "n:s:t:Hd:bk:of:F:c:j:")) != -1) {
+        switch (opt) {
+            case 'n': nrounds = std::atol(optarg); break;
+            case 's': seed = std::atol(optarg); break;
+            case 't': params.nthreads = std::atol(optarg); break;
+            case 'H': csv.has_header = true; break;
+            case 'd': csv.delimiter = optarg[0]; break;
+            case 'b': params.split_method = SplitMethod::histogram; break;
+            case 'k': params.sketch_k = std::atol(optarg); break;
+            case 'o': params.tree_kind = TreeKind::oblivious; break;
+            case 'f': params.tree_col_fraction = std::atof(optarg); break;
+            case 'F': params.node_col_fraction = std::atof(optarg); break;
+            case 'c': raw_cols = std::atol(optarg); break;
+            case 'j': json_path = optarg; break;
+            default: usage(argv[0]); return 2;
+        }
+    }
+    if (optind + 1 != argc) {
+        usage(argv[0]);
+        return 2;
+    }
+    const std::string path = argv[optind];
+
+    try {
+        // columnar files are scored in the value type they were written in
+        if (raw_cols == 0 && ends_with(path, ".odvb")) {
+            if (read_columnar_header(path).dtype_size == sizeof(float)) {
+                score(
+                    load_columnar<float>(path), seed, params, nrounds,
+                    json_path);
+            } else {
+                score(
+                    load_columnar<double>(path), seed, params, nrounds,
+                    json_path);
+            }
+            return 0;
+        }
+
+        ThreadPool pool(params.nthreads);
+        LoadStats stats;
+        const auto data = (
+            raw_cols > 0 ? load_raw<double>(path, raw_cols, &pool, &stats) :
+            load_csv<double>(path, csv, &pool, &stats));
+        if (stats.bytes > 0) {
+            std::cerr << "loaded " << data.nrow() << " rows x "
+                << data.ncol() << " columns at " << stats.mb_per_sec()
+                << " MB/s" << std::endl;
+        }
+        score(data, seed, params, nrounds, json_path);
+    } catch (const std::exception& e) {
+        std::cerr << argv[0] << ": " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -1,4 +1,4 @@
-from oddvibe import PyBooster
+from oddvibe import PyBooster, PyDataset
 import numpy as np
 import random
 
@@ -34,5 +34,9 @@ if __name__ == '__main__':
     mat[:, 0] = mat[:, 0] + xnoise_one
     mat[:, 1] = mat[:, 1] + xnoise_two
 
+    # column-major float32/float64 arrays are used without copying, and a
+    # PyDataset can be scored repeatedly without converting it again
+    data = PyDataset(np.asfortranarray(mat), ys)
+
     booster = PyBooster(tmp_seed)
-    weights = booster.find_outlier_weights(mat, ys, 500)
\ No newline at end of file
+    weights = booster.fit_counts(data, 500)
\ No newline at end of file
@@ -18,43 +18,205 @@
 # http://www.birving.com/blog/2014/05/13/passing-numpy-arrays-between-python-and/
 # http://docs.cython.org/en/latest/src/userguide/wrapping_CPlusPlus.html
 
+from cython.operator cimport dereference as deref
+from libcpp cimport bool
 from libcpp.vector cimport vector
 
+import numpy as np
+
 cdef extern from "../src/float_matrix.h" namespace "oddvibe":
-    cdef cppclass FloatMatrix "oddvibe::FloatMatrix<float>":
-        FloatMatrix(size_t ncols, vector[float] xs) except +
+    cdef cppclass FloatMatrix[T]:
+        @staticmethod
+        FloatMatrix[T] view(size_t nrows, size_t ncols, const T* xs) except +
 
 cdef extern from "../src/dataset.h" namespace "oddvibe":
-    cdef cppclass Dataset "oddvibe::Dataset<float>":
-        Dataset(FloatMatrix mat, vector[float] ys) except +
+    cdef cppclass Dataset[T]:
+        Dataset(const FloatMatrix[T]& mat, const vector[T]& ys) except +
+        size_t nrow()
+        size_t ncol()
+
+cdef extern from "../src/params.h" namespace "oddvibe":
+    cdef enum SplitMethod "oddvibe::SplitMethod":
+        split_exact "oddvibe::SplitMethod::exact"
+        split_histogram "oddvibe::SplitMethod::histogram"
+
+    cdef enum TreeKind "oddvibe::TreeKind":
+        tree_rtree "oddvibe::TreeKind::rtree"
+        tree_oblivious "oddvibe::TreeKind::oblivious"
+
+    cdef cppclass TreeParams:
+        size_t max_depth
+        SplitMethod split_method
+        TreeKind tree_kind
+        size_t max_bins
+        size_t sketch_k
+        size_t nthreads
+        double tree_col_fraction
+        double node_col_fraction
+        bool weight_samples
 
 cdef extern from "../src/booster.h" namespace "oddvibe":
     cdef cppclass Booster:
-        Booster(size_t seed) except +
-        vector[float] fit_counts(Dataset data, size_t nrounds)
+        Booster(size_t seed, const TreeParams& params) except +
+        vector[float] fit_counts[T](
+            const Dataset[T]& data, size_t nrounds) except + nogil
+
+
+cdef class PyDataset:
+    """
+    Feature matrix and response vector kept in C++ between calls.
+
+    `xs` is an (nrows, nfeatures) float32 or float64 array and `ys` has one
+    value per row.  A column-major (Fortran order) `xs` is used in place
+    without copying and is kept alive by this object; any other layout or
+    dtype is converted to column-major float64 once, here.  `ys` is copied
+    as the same dtype as `xs`.
+
+    Build one PyDataset and pass it to PyBooster.fit_counts repeatedly to
+    avoid converting the same data on every call.
+    """
+    cdef Dataset[float]* data_f32
+    cdef Dataset[double]* data_f64
+    cdef object xs_ref
+
+    def __cinit__(self, xs, ys):
+        self.data_f32 = NULL
+        self.data_f64 = NULL
+
+        xs = np.asarray(xs)
+        if xs.ndim != 2:
+            raise ValueError("xs must be a 2-D array")
+        if xs.dtype != np.float32:
+            xs = xs.astype(np.float64, copy = False)
+        # no-op when xs is already column-major
+        xs = np.asfortranarray(xs)
+
+        ys = np.ascontiguousarray(ys, dtype = xs.dtype).ravel()
+        if ys.shape[0] != xs.shape[0]:
+            raise ValueError("xs and ys must have the same number of rows")
+
+        if xs.dtype == np.float32:
+            self.data_f32 = make_dataset_f32(xs, ys)
+        else:
+            self.data_f64 = make_dataset_f64(xs, ys)
+        self.xs_ref = xs
+
+    def __dealloc__(self):
+        if self.data_f32 != NULL:
+            del self.data_f32
+        if self.data_f64 != NULL:
+            del self.data_f64
+
+    @property
+    def nrow(self):
+        if self.data_f32 != NULL:
+            return self.data_f32.nrow()
+        return self.data_f64.nrow()
+
+    @property
+    def ncol(self):
+        if self.data_f32 != NULL:
+            return self.data_f32.ncol()
+        return self.data_f64.ncol()
+
+    @property
+    def dtype(self):
+        return self.xs_ref.dtype
+
+
+cdef Dataset[float]* make_dataset_f32(
+        const float[::1, :] xs, const float[::1] ys) except NULL:
+    cdef vector[float] ys_vec = vector[float](ys.shape[0])
+    cdef size_t k
+    for k in range(ys.shape[0]):
+        ys_vec[k] = ys[k]
+    cdef const float* xs_ptr = NULL
+    if xs.shape[0] > 0 and xs.shape[1] > 0:
+        xs_ptr = &xs[0, 0]
+    return new Dataset[float](
+        FloatMatrix[float].view(xs.shape[0], xs.shape[1], xs_ptr), ys_vec)
+
+
+cdef Dataset[double]* make_dataset_f64(
+        const double[::1, :] xs, const double[::1] ys) except NULL:
+    cdef vector[double] ys_vec = vector[double](ys.shape[0])
+    cdef size_t k
+    for k in range(ys.shape[0]):
+        ys_vec[k] = ys[k]
+    cdef const double* xs_ptr = NULL
+    if xs.shape[0] > 0 and xs.shape[1] > 0:
+        xs_ptr = &xs[0, 0]
+    return new Dataset[double](
+        FloatMatrix[double].view(xs.shape[0], xs.shape[1], xs_ptr), ys_vec)
+
 
 cdef class PyBooster:
-    cdef size_t seed
+    """
+    Find possible outliers using boosted regression trees.
+
+    `nthreads` threads (0 for one per core) search for splits while the GIL
+    is released.  `histogram` selects binned split search with at most
+    `max_bins` bins per feature, whose edges come from quantile sketches of
+    accuracy `sketch_k` instead of sorting when it is nonzero.
+    `weight_samples` fits each tree to the distinct sampled rows weighted by
+    multiplicity, and `oblivious` fits trees that split every node of a
+    level on the same feature and value.
+    `tree_col_fraction` and `node_col_fraction` are the fractions of the
+    features drawn at random for each tree and, of those, for each node.
+    """
+    cdef Booster* booster
+
+    def __cinit__(
+            self,
+            size_t seed,
+            size_t nthreads = 1,
+            size_t max_depth = 6,
+            bint histogram = False,
+            size_t max_bins = 255,
+            size_t sketch_k = 0,
+            bint weight_samples = False,
+            bint oblivious = False,
+            double tree_col_fraction = 1.0,
+            double node_col_fraction = 1.0):
+        cdef TreeParams params
+        params.nthreads = nthreads
+        params.max_depth = max_depth
+        params.split_method = split_histogram if histogram else split_exact
+        params.max_bins = max_bins
+        params.sketch_k = sketch_k
+        params.weight_samples = weight_samples
+        params.tree_kind = tree_oblivious if oblivious else tree_rtree
+        params.tree_col_fraction = tree_col_fraction
+        params.node_col_fraction = node_col_fraction
+        self.booster = new Booster(seed, params)
 
-    def __cinit__(self, size_t seed):
-        self.seed = seed
+    def __dealloc__(self):
+        if self.booster != NULL:
+            del self.booster
+
+    def fit_counts(self, PyDataset data not None, size_t nrounds):
+        """
+        Run `nrounds` rounds of boosting on `data` without holding the GIL.
+
+        Returns a float32 array of normalized counts, one for each row; the
+        largest values are the most likely outliers.
+        """
+        cdef vector[float] counts
+        if data.data_f32 != NULL:
+            with nogil:
+                counts = self.booster.fit_counts[float](
+                    deref(data.data_f32), nrounds)
+        else:
+            with nogil:
+                counts = self.booster.fit_counts[double](
+                    deref(data.data_f64), nrounds)
+        return np.asarray(<float[:counts.size()]> counts.data()).copy()
 
     def find_outlier_weights(self, xs, ys, size_t nrounds):
-        cdef Booster *booster = NULL
-        cdef Dataset *data = NULL
-        cdef FloatMatrix *mat = NULL
-
-        try:
-            booster = new Booster(self.seed)
-            mat = new FloatMatrix(xs.shape[1], xs.flatten(order = 'F'))
-
-            # recall that [0] is for dereferencing the pointer
-            data = new Dataset(mat[0], ys)
-            return booster.fit_counts(data[0], nrounds)
-        finally:
-            if booster != NULL:
-                del booster
-            if data != NULL:
-                del data
-            if mat != NULL:
-                del mat
+        """
+        Convert `xs` and `ys` to a PyDataset and call fit_counts once.
+
+        Returns a list of floats, one for each row, as it always has; use
+        fit_counts directly for a float32 array instead.
+        """
+        return self.fit_counts(PyDataset(xs, ys), nrounds).tolist()
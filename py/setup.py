@@ -12,7 +12,8 @@ extensions = [
             set(glob('*.pyx') + glob('../src/*.cpp')) -
             set(['../src/rcpp_oddvibe.cpp', '../src/RcppExports.cpp'])),
         language='c++',
-        extra_compile_args=['-std=c++11']
+        extra_compile_args=['-std=c++11', '-O2', '-pthread'],
+        extra_link_args=['-pthread']
     )
 ]
 
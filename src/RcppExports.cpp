@@ -6,8 +6,8 @@
 using namespace Rcpp;
 
 // FindOutlierWeights
-NumericVector FindOutlierWeights(const NumericMatrix& xs, const NumericVector& ys, const size_t nrounds, const size_t seed);
-RcppExport SEXP oddvibe_FindOutlierWeights(SEXP xsSEXP, SEXP ysSEXP, SEXP nroundsSEXP, SEXP seedSEXP) {
+NumericVector FindOutlierWeights(const NumericMatrix& xs, const NumericVector& ys, const size_t nrounds, const size_t seed, const size_t nthreads);
+RcppExport SEXP oddvibe_FindOutlierWeights(SEXP xsSEXP, SEXP ysSEXP, SEXP nroundsSEXP, SEXP seedSEXP, SEXP nthreadsSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
@@ -15,13 +15,14 @@ BEGIN_RCPP
     Rcpp::traits::input_parameter< const NumericVector& >::type ys(ysSEXP);
     Rcpp::traits::input_parameter< const size_t >::type nrounds(nroundsSEXP);
     Rcpp::traits::input_parameter< const size_t >::type seed(seedSEXP);
-    rcpp_result_gen = Rcpp::wrap(FindOutlierWeights(xs, ys, nrounds, seed));
+    Rcpp::traits::input_parameter< const size_t >::type nthreads(nthreadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(FindOutlierWeights(xs, ys, nrounds, seed, nthreads));
     return rcpp_result_gen;
 END_RCPP
 }
 
 static const R_CallMethodDef CallEntries[] = {
-    {"oddvibe_FindOutlierWeights", (DL_FUNC) &oddvibe_FindOutlierWeights, 4},
+    {"oddvibe_FindOutlierWeights", (DL_FUNC) &oddvibe_FindOutlierWeights, 5},
     {NULL, NULL, 0}
 };
 
@@ -0,0 +1,103 @@
+/*
+ * Copyright 2017 Krysta M Bouzek
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdexcept>
+#include "alias_sampler.h"
+
+namespace oddvibe {
+    AliasSampler::AliasSampler(const size_t seed) :
+       m_rand_engine(std::mt19937(seed)) {
+    }
+
+    std::vector<size_t>
+    AliasSampler::gen_samples(const size_t nrows, const SamplingDist& pmf) {
+        std::vector<size_t> samples;
+        gen_samples(nrows, pmf, samples);
+        return samples;
+    }
+
+    void AliasSampler::gen_samples(
+            const size_t nrows,
+            const SamplingDist& pmf,
+            std::vector<size_t>& samples) {
+        build(pmf.weights());
+
+        const auto n = m_prob.size();
+        std::uniform_int_distribution<size_t> col_dist(0, n - 1);
+        // 32 random bits is plenty to pick between a column and its alias
+        const double scale = 1.0 / 4294967296.0;
+
+        samples.resize(nrows);
+        for (auto& sample : samples) {
+            const size_t col = col_dist(m_rand_engine);
+            const double coin = m_rand_engine() * scale;
+            sample = (coin < m_prob[col] ? col : m_alias[col]);
+        }
+    }
+
+    void AliasSampler::build(const std::vector<float>& weights) {
+        const auto n = weights.size();
+        double total = 0.0;
+        for (const auto weight : weights) {
+            if (!(weight >= 0)) {
+                throw std::invalid_argument("Weights must be non-negative");
+            }
+            total += weight;
+        }
+        if (n == 0 || !(total > 0)) {
+            throw std::invalid_argument("Weights must have a positive sum");
+        }
+
+        m_prob.resize(n);
+        m_alias.resize(n);
+        m_small.clear();
+        m_large.clear();
+
+        // scale so the average column holds exactly 1
+        const double scale = n / total;
+        for (size_t k = 0; k != n; ++k) {
+            m_prob[k] = weights[k] * scale;
+            m_alias[k] = k;
+            if (m_prob[k] < 1.0) {
+                m_small.push_back(k);
+            } else {
+                m_large.push_back(k);
+            }
+        }
+
+        // top up each small column from a large one
+        while (!m_small.empty() && !m_large.empty()) {
+            const size_t small = m_small.back();
+            m_small.pop_back();
+            const size_t large = m_large.back();
+
+            m_alias[small] = large;
+            m_prob[large] -= 1.0 - m_prob[small];
+            if (m_prob[large] < 1.0) {
+                m_large.pop_back();
+                m_small.push_back(large);
+            }
+        }
+
+        // anything left over is 1 up to rounding error
+        for (const auto k : m_small) {
+            m_prob[k] = 1.0;
+        }
+        for (const auto k : m_large) {
+            m_prob[k] = 1.0;
+        }
+    }
+}
@@ -0,0 +1,99 @@
+/*
+ * Copyright 2017 Krysta M Bouzek
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef KMBNW_ODVB_ALIAS_SAMPLER_H
+#define KMBNW_ODVB_ALIAS_SAMPLER_H
+
+#include <vector>
+#include <random>
+#include "sampling_dist.h"
+
+/*! \file */
+
+namespace oddvibe {
+    /**
+     * Generate samples of row indexes from a given distribution using
+     * Walker's alias method, built with Vose's algorithm.
+     *
+     * Building the alias table takes linear time in the size of the
+     * distribution and each draw takes constant time, versus a binary
+     * search per draw for EmpiricalSampler.  The table and its scratch
+     * space are kept between calls, so repeated calls with the same
+     * distribution size do not allocate.  The same seed and distributions
+     * always give the same samples, but not the same samples as
+     * EmpiricalSampler.
+     * \sa EmpiricalSampler
+     */
+    class AliasSampler {
+        public:
+            /**
+             * Create a new instance with the specified random seed.
+             *
+             * \param seed Random seed to initialize with.
+             */
+            AliasSampler(const size_t seed);
+
+            AliasSampler(const AliasSampler& other) = delete;
+            AliasSampler& operator=(const AliasSampler& other) = delete;
+
+            /**
+             * Generate empirical samples with replacement from a given
+             * distribution.
+             *
+             * A sample is conceptually a row index into a feature matrix.
+             *
+             * \param nrows The number of samples to generate.
+             * \param pmf The empirical distribution to generate row indexes
+             * from.
+             * \return A vector of randomly sampled row indexes, each within the
+             * range of `[0, pmf.size())`.
+             */
+            std::vector<size_t>
+            gen_samples(const size_t nrows, const SamplingDist& pmf);
+
+            /**
+             * Generate empirical samples with replacement from a given
+             * distribution into an existing vector.
+             *
+             * \param nrows The number of samples to generate.
+             * \param pmf The empirical distribution to generate row indexes
+             * from.
+             * \param samples[out] Resized to `nrows` and overwritten with
+             * the sampled row indexes.
+             */
+            void gen_samples(
+                    const size_t nrows,
+                    const SamplingDist& pmf,
+                    std::vector<size_t>& samples);
+
+        private:
+            std::mt19937 m_rand_engine;
+
+            // probability of keeping column k rather than its alias
+            std::vector<double> m_prob;
+            std::vector<size_t> m_alias;
+
+            // scratch worklists for building the table
+            std::vector<size_t> m_small;
+            std::vector<size_t> m_large;
+
+            /**
+             * Rebuild the alias table from a distribution.
+             */
+            void build(const std::vector<float>& weights);
+    };
+}
+#endif //KMBNW_ODVB_ALIAS_SAMPLER_H
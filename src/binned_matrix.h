@@ -0,0 +1,327 @@
+/*
+ * Copyright 2017 Krysta M Bouzek
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef KMBNW_ODVB_BINNED_MATRIX_H
+#define KMBNW_ODVB_BINNED_MATRIX_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <cmath>
+#include <limits>
+#include <iterator>
+#include <algorithm>
+#include <stdexcept>
+#include "float_matrix.h"
+#include "quantile_sketch.h"
+
+/*! \file */
+
+namespace oddvibe {
+    /**
+     * Feature matrix quantized into per-column bins.
+     *
+     * Each column is cut into at most `max_bins` bins of roughly equal row
+     * count, found either by sorting the column or, for columns too long to
+     * sort, from a QuantileSketch of it.  A bin is identified by its upper edge, which is the largest
+     * feature value that falls into it, so `x <= edge(col, b)` holds exactly
+     * for the values whose bin code is `<= b`.  NaN feature values get the
+     * code `nbins(col)`, one past the last real bin.
+     *
+     * Codes are stored column-major in one byte each when every column has
+     * at most 255 bins (so that the NaN code also fits) and in two bytes
+     * otherwise; see code_bytes().  Loops over many rows should fetch the
+     * codes of a column once with col_codes8() or col_codes16() rather than
+     * calling operator() for every row.
+     */
+    template <typename FloatT>
+    class BinnedMatrix {
+        public:
+            /**
+             * The type used to store a single bin code when codes take two
+             * bytes; wide enough to hold any code.
+             */
+            typedef uint16_t code_type;
+
+            BinnedMatrix() = default;
+
+            /**
+             * Quantize a feature matrix.
+             *
+             * \param xs The feature matrix to quantize.
+             * \param max_bins The max number of (non-NaN) bins per column;
+             * must be in `[2, 65535]`.
+             */
+            BinnedMatrix(const FloatMatrix<FloatT>& xs, const size_t max_bins) :
+                    m_nrows(xs.nrow()),
+                    m_ncols(xs.ncol()),
+                    m_max_bins(max_bins),
+                    m_offsets(xs.ncol() + 1, 0) {
+                check_max_bins();
+
+                std::vector<FloatT> values;
+                values.reserve(m_nrows);
+
+                size_t max_code = 0;
+                for (size_t col = 0; col != m_ncols; ++col) {
+                    values.clear();
+                    for (size_t row = 0; row != m_nrows; ++row) {
+                        const auto x = xs(row, col);
+                        if (!std::isnan(x)) {
+                            values.push_back(x);
+                        }
+                    }
+                    std::sort(values.begin(), values.end());
+                    append_edges(col, values);
+                    m_offsets[col + 1] = m_edges.size();
+                    max_code = std::max(max_code, nbins(col));
+                }
+                encode(xs, max_code);
+            }
+
+            /**
+             * Quantize a feature matrix with bin edges taken from sketches
+             * of its columns, without sorting them.
+             *
+             * The edges are QuantileSketch::cuts(), so a column gets one
+             * bin per distinct value only if its sketch kept every one, and
+             * otherwise bins of about equal count within the sketch's rank
+             * error.  The largest value of each column is always an edge.
+             *
+             * \param xs The feature matrix to quantize.
+             * \param max_bins The max number of (non-NaN) bins per column;
+             * must be in `[2, 65535]`.
+             * \param sketches One sketch of each column of `xs`, e.g. from
+             * sketch_columns().
+             */
+            BinnedMatrix(
+                    const FloatMatrix<FloatT>& xs,
+                    const size_t max_bins,
+                    const std::vector<QuantileSketch<FloatT>>& sketches) :
+                    m_nrows(xs.nrow()),
+                    m_ncols(xs.ncol()),
+                    m_max_bins(max_bins),
+                    m_offsets(xs.ncol() + 1, 0) {
+                check_max_bins();
+                if (sketches.size() != m_ncols) {
+                    throw std::invalid_argument("Must have one sketch per column");
+                }
+
+                size_t max_code = 0;
+                for (size_t col = 0; col != m_ncols; ++col) {
+                    const auto cuts = sketches[col].cuts(max_bins);
+                    m_edges.insert(m_edges.end(), cuts.begin(), cuts.end());
+                    m_offsets[col + 1] = m_edges.size();
+                    max_code = std::max(max_code, nbins(col));
+                }
+                encode(xs, max_code);
+            }
+
+            BinnedMatrix(BinnedMatrix&& other) = default;
+            BinnedMatrix& operator=(BinnedMatrix&& other) = default;
+
+            BinnedMatrix(const BinnedMatrix& other) = default;
+            BinnedMatrix& operator=(const BinnedMatrix& other) = default;
+
+            ~BinnedMatrix() = default;
+
+            /**
+             * \return The bin code of a single feature value.
+             */
+            code_type operator() (const size_t row, const size_t col) const {
+                const auto idx = code_index(row, col);
+                return (m_code_bytes == 1 ? m_codes8[idx] : m_codes16[idx]);
+            }
+
+            /**
+             * \return Number of bytes used to store each bin code, 1 or 2.
+             */
+            size_t code_bytes() const {
+                return m_code_bytes;
+            }
+
+            /**
+             * \return The nrow() codes of a column when code_bytes() is 1.
+             */
+            const uint8_t* col_codes8(const size_t col) const {
+                return m_codes8.data() + code_index(0, col);
+            }
+
+            /**
+             * \return The nrow() codes of a column when code_bytes() is 2.
+             */
+            const uint16_t* col_codes16(const size_t col) const {
+                return m_codes16.data() + code_index(0, col);
+            }
+
+            /**
+             * \return Number of non-NaN bins in the given column.
+             */
+            size_t nbins(const size_t col) const {
+                return m_offsets[col + 1] - m_offsets[col];
+            }
+
+            /**
+             * \return Total number of histogram slots over all columns,
+             * including one NaN slot per column.
+             */
+            size_t total_slots() const {
+                return m_edges.size() + m_ncols;
+            }
+
+            /**
+             * \return Offset of the first histogram slot of a column within
+             * a histogram of total_slots() entries.
+             */
+            size_t slot_offset(const size_t col) const {
+                return m_offsets[col] + col;
+            }
+
+            /**
+             * Map a bin code back to a feature value.
+             *
+             * \return The largest feature value in bin `bin` of column `col`.
+             * A split on this value partitions raw feature values exactly as
+             * a split on codes `<= bin` partitions the binned rows.
+             */
+            FloatT edge(const size_t col, const size_t bin) const {
+                return m_edges[m_offsets[col] + bin];
+            }
+
+            /**
+             * Map a feature value to the code of the bin it would fall in.
+             *
+             * \return The first bin of `col` whose edge is not less than
+             * `value`; `nbins(col)` for NaN or for a value above every edge.
+             * The inverse of edge() for bin edges.
+             */
+            code_type bin_of(const size_t col, const FloatT value) const {
+                if (std::isnan(value)) {
+                    return nbins(col);
+                }
+                const auto edge_first = std::next(m_edges.begin(), m_offsets[col]);
+                const auto edge_last = std::next(
+                    m_edges.begin(), m_offsets[col + 1]);
+                return std::distance(
+                    edge_first, std::lower_bound(edge_first, edge_last, value));
+            }
+
+            /**
+             * \return The max number of bins per column requested when this
+             * instance was built.
+             */
+            size_t max_bins() const {
+                return m_max_bins;
+            }
+
+            size_t nrow() const {
+                return m_nrows;
+            }
+
+            size_t ncol() const {
+                return m_ncols;
+            }
+
+        private:
+            size_t m_nrows = 0;
+            size_t m_ncols = 0;
+            size_t m_max_bins = 0;
+            size_t m_code_bytes = 1;
+            std::vector<size_t> m_offsets;
+            std::vector<FloatT> m_edges;
+            // only the one matching m_code_bytes is filled
+            std::vector<uint8_t> m_codes8;
+            std::vector<uint16_t> m_codes16;
+
+            size_t code_index(const size_t row, const size_t col) const {
+                return (col * m_nrows) + row;
+            }
+
+            void check_max_bins() const {
+                // NaN takes the code after the last bin, at most max_bins
+                if (m_max_bins < 2 ||
+                        m_max_bins > std::numeric_limits<code_type>::max()) {
+                    throw std::invalid_argument("max_bins must be in [2, 65535]");
+                }
+            }
+
+            /**
+             * Store the codes in as few bytes as the largest code allows.
+             */
+            void encode(const FloatMatrix<FloatT>& xs, const size_t max_code) {
+                if (max_code <= std::numeric_limits<uint8_t>::max()) {
+                    m_code_bytes = 1;
+                    fill_codes(xs, m_codes8);
+                } else {
+                    m_code_bytes = 2;
+                    fill_codes(xs, m_codes16);
+                }
+            }
+
+            /**
+             * Store the bin code of every feature value once all edges are
+             * known.
+             */
+            template <typename CodeT>
+            void fill_codes(
+                    const FloatMatrix<FloatT>& xs,
+                    std::vector<CodeT>& codes) {
+                codes.resize(m_nrows * m_ncols);
+                for (size_t col = 0; col != m_ncols; ++col) {
+                    CodeT* const col_codes = codes.data() + code_index(0, col);
+                    for (size_t row = 0; row != m_nrows; ++row) {
+                        col_codes[row] = bin_of(col, xs(row, col));
+                    }
+                }
+            }
+
+            /**
+             * Append the bin edges for one column of sorted, non-NaN values.
+             *
+             * Columns with no more than max_bins() distinct values get one
+             * bin per value; other columns are cut into equal-count slices.
+             */
+            void append_edges(const size_t col, const std::vector<FloatT>& sorted) {
+                const auto first_edge = m_offsets[col];
+                const auto sz = sorted.size();
+
+                const auto add_edge = [this, first_edge](const FloatT value) {
+                    if (m_edges.size() == first_edge || m_edges.back() < value) {
+                        m_edges.push_back(value);
+                    }
+                };
+
+                size_t nuniq = (sz > 0 ? 1 : 0);
+                for (size_t k = 1; k < sz; ++k) {
+                    nuniq += (sorted[k - 1] < sorted[k] ? 1 : 0);
+                }
+
+                if (nuniq <= m_max_bins) {
+                    std::for_each(sorted.begin(), sorted.end(), add_edge);
+                    return;
+                }
+
+                for (size_t bin = 1; bin <= m_max_bins; ++bin) {
+                    // last value of the bin-th equal-count slice
+                    const auto pos = (bin * sz) / m_max_bins;
+                    if (pos > 0) {
+                        add_edge(sorted[pos - 1]);
+                    }
+                }
+            }
+    };
+}
+#endif //KMBNW_ODVB_BINNED_MATRIX_H
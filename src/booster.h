@@ -14,9 +14,23 @@
  * limitations under the License.
  */
 #include <vector>
+#include <memory>
+#include <random>
+#include <chrono>
+#include <algorithm>
+#include <functional>
+#include <stdexcept>
 #include "ecdf_sampler.h"
+#include "alias_sampler.h"
+#include "params.h"
 #include "rtree.h"
+#include "flat_tree.h"
+#include "oblivious_tree.h"
+#include "round_update.h"
+#include "convergence.h"
 #include "sampling_dist.h"
+#include "thread_pool.h"
+#include "round_stats.h"
 
 #ifndef KMBNW_ODVB_BOOSTER_H
 #define KMBNW_ODVB_BOOSTER_H
@@ -25,8 +39,33 @@
 
 namespace oddvibe {
     /**
-     * Provides boosting capabilities to RTree models.
-     * \sa RTree
+     * Outcome of a boosting run that may stop early.
+     */
+    struct BoostResult {
+        /**
+         * Normalized counts, one for each row of the input data.
+         * \sa Booster::fit_counts
+         */
+        std::vector<float> counts;
+
+        /**
+         * Number of rounds of boosting that were run.
+         */
+        size_t nrounds = 0;
+
+        /**
+         * True if boosting stopped before the max number of rounds because
+         * the counts had stabilized.
+         */
+        bool converged = false;
+    };
+
+    /**
+     * Provides boosting capabilities to RTree models, or to ObliviousTree
+     * models when TreeParams::tree_kind is TreeKind::oblivious.  The columns
+     * each tree and node may split on are drawn from the seed as well (see
+     * TreeParams::tree_col_fraction), so a seed always gives the same counts.
+     * \sa RTree, ObliviousTree
      */
     class Booster {
         public:
@@ -37,12 +76,59 @@ namespace oddvibe {
              */
             Booster(const size_t &seed) : m_seed(seed) {}
 
+            /**
+             * Create a new instance with the specified random seed and
+             * tree settings.
+             *
+             * \param seed Random seed to initialize with.
+             * \param params Settings for the RTree fitted in each round.
+             */
+            Booster(const size_t &seed, const TreeParams& params) :
+                m_seed(seed),
+                m_params(params) {}
+
             Booster(const Booster &other) = delete;
             Booster &operator=(const Booster &other) = delete;
 
+            /**
+             * Set a function to call after each round of fit_counts().
+             *
+             * The function is called on the thread that called fit_counts(),
+             * with the number of rounds run so far, while no other boosting
+             * work is running; fit_chains() does not call it.  It may throw
+             * to abandon the fit, e.g. when the user interrupts a long run,
+             * and the exception propagates out of fit_counts().
+             *
+             * \param on_round Function to call, or an empty function to call
+             * nothing.
+             */
+            void set_round_callback(std::function<void(size_t)> on_round) {
+                m_on_round = std::move(on_round);
+            }
+
+            /**
+             * Set an observer to receive measurements of each round of
+             * fit_counts(): the time of each phase, the size of the tree,
+             * the split candidates scanned and the change to the sampling
+             * distribution.  See RoundStats.
+             *
+             * The observer is called just before the round callback, in
+             * the same way; fit_chains() does not call it.  Without an
+             * observer nothing is measured.
+             *
+             * \param observer Observer to call, or null to measure
+             * nothing.  It is not owned and must outlive any fit that uses
+             * it.
+             */
+            void set_observer(RoundObserver* observer) {
+                m_observer = observer;
+            }
+
             /**
              * Find possible outliers using boosted RTrees
              *
+             * \tparam SamplerT Draws each round's rows from the sampling
+             * distribution; EmpiricalSampler or AliasSampler.
              * \param data Dataset of feature matrix and response vector to fit.
              * \param nrounds Number of rounds of boosting (often called
              * number of trees).
@@ -50,40 +136,267 @@ namespace oddvibe {
              * input data.  Each element represents the number of times that
              * row of data was chosen during boosting, normalized by `nrounds`.
              */
-            template <typename FloatT>
+            template <typename FloatT, typename SamplerT = EmpiricalSampler>
             std::vector<float> fit_counts(
                     const Dataset<FloatT>& data,
                     const size_t nrounds) const {
-                const FloatMatrix<FloatT>& xs = data.xs();
-                const std::vector<FloatT>& ys = data.ys();
+                ThreadPool pool(m_params.nthreads);
+                return boost<FloatT, SamplerT>(
+                    data, nrounds, nullptr, m_seed, pool, &m_on_round,
+                    m_observer).counts;
+            }
+
+            /**
+             * Find possible outliers using boosted RTrees, stopping once
+             * the normalized counts have stabilized.
+             *
+             * \tparam SamplerT Draws each round's rows from the sampling
+             * distribution; EmpiricalSampler or AliasSampler.
+             * \param data Dataset of feature matrix and response vector to fit.
+             * \param max_rounds Most rounds of boosting to run.
+             * \param stop When the counts count as stable; see
+             * ConvergenceCheck.
+             * \return The normalized counts, as for the other overload but
+             * normalized by the number of rounds actually run, and that
+             * number of rounds.
+             */
+            template <typename FloatT, typename SamplerT = EmpiricalSampler>
+            BoostResult fit_counts(
+                    const Dataset<FloatT>& data,
+                    const size_t max_rounds,
+                    const StopParams& stop) const {
+                ConvergenceCheck check(stop, data.nrow());
+                ThreadPool pool(m_params.nthreads);
+                return boost<FloatT, SamplerT>(
+                    data, max_rounds, &check, m_seed, pool, &m_on_round,
+                    m_observer);
+            }
+
+            /**
+             * Find possible outliers using several independent chains of
+             * boosted RTrees.
+             *
+             * Chain `k` is seeded with `seed + k`, so the first chain is the
+             * same as fit_counts() with the same number of rounds.  Chains
+             * run in parallel on TreeParams::nthreads threads, which also
+             * search for splits within each chain.  The result does not
+             * depend on the number of threads.
+             *
+             * \tparam SamplerT Draws each round's rows from the sampling
+             * distribution; EmpiricalSampler or AliasSampler.
+             * \param data Dataset of feature matrix and response vector to fit.
+             * \param nchains Number of independent chains to run.
+             * \param nrounds Number of rounds of boosting in each chain.
+             * \return The mean of the normalized counts of every chain, one
+             * for each row of the input data.
+             */
+            template <typename FloatT, typename SamplerT = EmpiricalSampler>
+            std::vector<float> fit_chains(
+                    const Dataset<FloatT>& data,
+                    const size_t nchains,
+                    const size_t nrounds) const {
+                if (nchains < 1) {
+                    throw std::invalid_argument("nchains must be >= 1");
+                }
+
+                ThreadPool pool(m_params.nthreads);
+                std::vector<std::vector<float>> chain_counts(nchains);
+                parallel_for(
+                    &pool,
+                    nchains,
+                    [&](const size_t chain) {
+                        chain_counts[chain] = boost<FloatT, SamplerT>(
+                            data, nrounds, nullptr, m_seed + chain, pool,
+                            nullptr, nullptr).counts;
+                    });
+
+                // merge in chain order so the sums do not depend on timing
+                std::vector<float> merged(data.nrow(), 0);
+                for (const auto& counts : chain_counts) {
+                    std::transform(
+                        merged.begin(),
+                        merged.end(),
+                        counts.begin(),
+                        merged.begin(),
+                        std::plus<float>());
+                }
+                std::transform(
+                    merged.begin(),
+                    merged.end(),
+                    merged.begin(),
+                    [nchains](const float total) { return total / nchains; });
+                return merged;
+            }
+
+      private:
+            size_t m_seed;
+            TreeParams m_params;
+            std::function<void(size_t)> m_on_round;
+            RoundObserver* m_observer = nullptr;
+
+            /**
+             * Run up to `nrounds` rounds of boosting, stopping early if
+             * `check` is not null and reports convergence.
+             *
+             * \param seed Random seed for sampling rows.
+             * \param pool Threads to search for splits and predict with.
+             * \param on_round Called after each round if not null and not
+             * empty.
+             * \param observer Measures each round if not null.
+             */
+            template <typename FloatT, typename SamplerT>
+            BoostResult boost(
+                    const Dataset<FloatT>& data,
+                    const size_t nrounds,
+                    ConvergenceCheck* check,
+                    const size_t seed,
+                    ThreadPool& pool,
+                    const std::function<void(size_t)>* on_round,
+                    RoundObserver* observer) const {
+                typedef std::chrono::steady_clock clock;
                 const auto nrows = data.nrow();
 
                 // set up initial uniform distribution over all instances
                 SamplingDist pmf(nrows);
                 std::vector<size_t> counts(nrows, 0);
-                EmpiricalSampler sampler(m_seed);
+                SamplerT sampler(seed);
+                std::vector<size_t> active;
+                // seeds each tree's column draws; separate from the row
+                // sampler so that drawing columns leaves the rows alone
+                std::mt19937_64 col_engine(seed);
+
+                // every round reuses the previous round's nodes and buffers,
+                // so rounds after the first few do not allocate
+                typename RTree<FloatT>::Workspace workspace;
+                SplitSearchStats split_stats;
+                const typename RTree<FloatT>::Trainer trainer(
+                    m_params, &pool, &workspace,
+                    observer != nullptr ? &split_stats : nullptr);
+                FlatTree<FloatT> flat_tree;
+                typename ObliviousTree<FloatT>::Workspace oblivious_workspace;
+                const typename ObliviousTree<FloatT>::Trainer oblivious_trainer(
+                    m_params, &pool, &oblivious_workspace,
+                    observer != nullptr ? &split_stats : nullptr);
+                ObliviousTree<FloatT> oblivious_tree;
+                const bool oblivious = (
+                    m_params.tree_kind == TreeKind::oblivious);
+                RoundUpdate<FloatT> update(nrows, &pool);
+
+                // per-round multiplicities for TreeParams::weight_samples
+                std::vector<double> weights;
+                std::vector<size_t> distinct;
+                if (m_params.weight_samples) {
+                    weights.resize(nrows);
+                    distinct.reserve(nrows);
+                }
 
-                const typename RTree<FloatT>::Trainer trainer(6);
+                size_t nrun = 0;
+                bool converged = false;
+                RoundStats stats;
+                RoundStats* const round_stats = (
+                    observer != nullptr ? &stats : nullptr);
+                // only read when measuring
+                clock::time_point start, sampled, fitted, flattened;
 
-                for (size_t k = 0; k != nrounds; ++k) {
-                    auto active = sampler.gen_samples(nrows, pmf);
+                while (nrun != nrounds) {
+                    if (round_stats != nullptr) {
+                        start = clock::now();
+                    }
+                    sampler.gen_samples(nrows, pmf, active);
 
                     for (const auto & idx : active) {
                         ++counts[idx];
                     }
+                    ++nrun;
+
+                    // this round's tree only affects later rounds' samples
+                    if (check != nullptr && check->converged(counts, nrun)) {
+                        converged = true;
+                        break;
+                    }
+                    if (round_stats != nullptr) {
+                        sampled = clock::now();
+                        split_stats.clear();
+                    }
 
-                    const auto tree = trainer.fit(
-                        data, active.begin(), active.end(), 0);
-                    const auto loss = loss_seq(ys, tree->predict(xs));
+                    if (m_params.weight_samples) {
+                        std::fill(weights.begin(), weights.end(), 0.0);
+                        distinct.clear();
+                        for (const auto & idx : active) {
+                            if (weights[idx]++ == 0) {
+                                distinct.push_back(idx);
+                            }
+                        }
+                    }
+
+                    const size_t tree_seed = col_engine();
+                    LossUpdate change;
+                    if (oblivious) {
+                        // oblivious trees are flat already; the last one's
+                        // storage is reused for this one
+                        oblivious_workspace.recycle(std::move(oblivious_tree));
+                        if (m_params.weight_samples) {
+                            oblivious_tree = oblivious_trainer.fit(
+                                data, weights, distinct.begin(), distinct.end(),
+                                tree_seed);
+                        } else {
+                            oblivious_tree = oblivious_trainer.fit(
+                                data, active.begin(), active.end(), tree_seed);
+                        }
+                        if (round_stats != nullptr) {
+                            fitted = clock::now();
+                            flattened = fitted;
+                        }
+                        change = update.apply(
+                            oblivious_tree, data, pmf, round_stats);
+                    } else {
+                        std::unique_ptr<RTree<FloatT>> tree;
+                        if (m_params.weight_samples) {
+                            tree = trainer.fit(
+                                data, weights, distinct.begin(), distinct.end(), 0,
+                                tree_seed);
+                        } else {
+                            tree = trainer.fit(
+                                data, active.begin(), active.end(), 0, tree_seed);
+                        }
+                        if (round_stats != nullptr) {
+                            fitted = clock::now();
+                        }
+                        flat_tree.assign(*tree);
+                        workspace.recycle(std::move(tree));
+                        if (round_stats != nullptr) {
+                            flattened = clock::now();
+                        }
+                        change = update.apply(flat_tree, data, pmf, round_stats);
+                    }
 
-                    pmf.adjust_for_loss(loss);
+                    if (round_stats != nullptr) {
+                        typedef std::chrono::duration<double> seconds;
+                        stats.round = nrun;
+                        stats.sample_seconds = seconds(sampled - start).count();
+                        stats.fit_seconds = seconds(fitted - sampled).count();
+                        stats.split_seconds = split_stats.seconds();
+                        stats.flatten_seconds = seconds(
+                            flattened - fitted).count();
+                        stats.nnodes = (
+                            oblivious ? oblivious_tree.size() : flat_tree.size());
+                        stats.depth = (
+                            oblivious ? oblivious_tree.depth() : flat_tree.depth());
+                        stats.split_candidates = split_stats.candidates();
+                        stats.update = change;
+                        observer->on_round(stats);
+                    }
+                    if (on_round != nullptr && *on_round) {
+                        (*on_round)(nrun);
+                    }
                 }
 
-                return divide_vector(counts, nrounds);
+                BoostResult result;
+                result.counts = divide_vector(counts, nrun);
+                result.nrounds = nrun;
+                result.converged = converged;
+                return result;
             }
-
-      private:
-            size_t m_seed;
     };
 }
 #endif //KMBNW_ODVB_BOOSTER_H
@@ -0,0 +1,301 @@
+/*
+ * Copyright 2017 Krysta M Bouzek
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef KMBNW_ODVB_COLUMN_INDEX_H
+#define KMBNW_ODVB_COLUMN_INDEX_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <iterator>
+#include <algorithm>
+#include <stdexcept>
+#include "float_matrix.h"
+
+/*! \file */
+
+namespace oddvibe {
+    /**
+     * Per-column sort order of a feature matrix.
+     *
+     * The feature matrix never changes between boosting rounds, so this is
+     * built once (see Dataset::column_index()) and every tree then derives
+     * the sorted rows it needs from it in linear time.
+     */
+    template <typename FloatT>
+    class ColumnIndex {
+        public:
+            /**
+             * The type used to store row indexes.
+             */
+            typedef uint32_t index_type;
+
+            ColumnIndex() = default;
+
+            /**
+             * Sort every column of a feature matrix.
+             *
+             * \param xs The feature matrix to index.  It must have fewer than
+             * 2^32 rows.
+             */
+            explicit ColumnIndex(const FloatMatrix<FloatT>& xs) :
+                    m_nrows(xs.nrow()),
+                    m_ncols(xs.ncol()),
+                    m_order(xs.nrow() * xs.ncol()) {
+                if (m_nrows >= std::numeric_limits<index_type>::max()) {
+                    throw std::length_error("Too many rows to index");
+                }
+
+                for (size_t col = 0; col != m_ncols; ++col) {
+                    const auto first = std::next(m_order.begin(), col * m_nrows);
+                    const auto last = std::next(first, m_nrows);
+                    std::iota(first, last, 0);
+
+                    // NaN values sort last
+                    const auto nan_begin = std::stable_partition(
+                        first,
+                        last,
+                        [&xs, col](const index_type row) {
+                            return !std::isnan(xs(row, col));
+                        });
+                    std::stable_sort(
+                        first,
+                        nan_begin,
+                        [&xs, col](const index_type lhs, const index_type rhs) {
+                            return xs(lhs, col) < xs(rhs, col);
+                        });
+                }
+            }
+
+            ColumnIndex(ColumnIndex&& other) = default;
+            ColumnIndex& operator=(ColumnIndex&& other) = default;
+
+            ColumnIndex(const ColumnIndex& other) = default;
+            ColumnIndex& operator=(const ColumnIndex& other) = default;
+
+            ~ColumnIndex() = default;
+
+            /**
+             * \return Pointer to the nrow() row indexes of a column, in
+             * ascending order of feature value with NaN values last.
+             */
+            const index_type* order(const size_t col) const {
+                return &m_order[col * m_nrows];
+            }
+
+            size_t nrow() const {
+                return m_nrows;
+            }
+
+            size_t ncol() const {
+                return m_ncols;
+            }
+
+        private:
+            size_t m_nrows = 0;
+            size_t m_ncols = 0;
+            std::vector<index_type> m_order;
+    };
+
+    /**
+     * The rows of a tree node, kept sorted separately for every column.
+     *
+     * A node is a contiguous segment `[offset, offset + count)` that is the
+     * same for every column.  Splitting a node stably partitions each of its
+     * column segments so that both children stay sorted, without comparing
+     * any feature values.  Only the columns a tree may split on need be
+     * kept.  Storage is kept between calls to assign(), so an instance
+     * reused for many trees stops allocating once it has seen the largest
+     * one.
+     */
+    class SortedColumns {
+        public:
+            /**
+             * The type used to store row indexes, as in ColumnIndex.
+             */
+            typedef uint32_t index_type;
+
+            SortedColumns() = default;
+
+            SortedColumns(SortedColumns&& other) = default;
+            SortedColumns& operator=(SortedColumns&& other) = default;
+
+            SortedColumns(const SortedColumns& other) = delete;
+            SortedColumns& operator=(const SortedColumns& other) = delete;
+
+            ~SortedColumns() = default;
+
+            /**
+             * Filter the sort order of a ColumnIndex down to a set of rows.
+             *
+             * The elements from the range `[first, last]` are row indexes;
+             * repeated indexes are kept as many times as they appear.  This
+             * takes `O(ncol * (nrow + count))` time and does not compare any
+             * feature values.
+             *
+             * \param index Sort order of the full feature matrix.
+             * \param first InputIterator to the initial position of
+             * the row indexes.
+             * \param last InputIterator to the final position of
+             * the row indexes.
+             * \param columns The columns of `index` to keep, in ascending
+             * order, or null to keep every column.
+             */
+            template <typename FloatT, typename InputIterator>
+            void assign(
+                    const ColumnIndex<FloatT>& index,
+                    const InputIterator first,
+                    const InputIterator last,
+                    const std::vector<size_t>* columns = nullptr) {
+                const auto nrows = index.nrow();
+                if (columns != nullptr) {
+                    m_columns.assign(columns->begin(), columns->end());
+                } else {
+                    m_columns.resize(index.ncol());
+                    std::iota(m_columns.begin(), m_columns.end(), 0);
+                }
+                m_slots.assign(index.ncol(), std::numeric_limits<size_t>::max());
+                for (size_t slot = 0; slot != m_columns.size(); ++slot) {
+                    if (m_columns[slot] >= index.ncol()) {
+                        throw std::out_of_range("Column not in range");
+                    }
+                    if (slot > 0 && m_columns[slot] <= m_columns[slot - 1]) {
+                        throw std::invalid_argument("Columns must be ascending");
+                    }
+                    m_slots[m_columns[slot]] = slot;
+                }
+                m_ncols = m_columns.size();
+                m_count = 0;
+
+                m_multiplicity.assign(nrows, 0);
+                for (auto row = first; row != last; row = std::next(row)) {
+                    if (static_cast<size_t>(*row) >= nrows) {
+                        throw std::out_of_range("Row not in range");
+                    }
+                    ++m_multiplicity[*row];
+                    ++m_count;
+                }
+
+                // room for a node of every row, so that later calls with
+                // up to nrows rows reuse the same storage
+                m_rows.reserve(m_ncols * std::max(m_count, nrows));
+                m_rows.resize(m_ncols * m_count);
+                for (size_t slot = 0; slot != m_ncols; ++slot) {
+                    const auto order = index.order(m_columns[slot]);
+                    auto out = m_rows.begin() + slot * m_count;
+                    for (size_t k = 0; k != nrows; ++k) {
+                        const auto row = order[k];
+                        out = std::fill_n(out, m_multiplicity[row], row);
+                    }
+                }
+                m_goes_left.assign(nrows, 0);
+                m_right.reserve(nrows);
+                m_right.resize(m_count);
+            }
+
+            /**
+             * \return Iterator to the first row of a node in a column; the
+             * column must be one of columns().
+             */
+            std::vector<index_type>::const_iterator
+            begin(const size_t col, const size_t offset) const {
+                return m_rows.begin() + (m_slots[col] * m_count + offset);
+            }
+
+            /**
+             * Stably partition every column segment of a node.
+             *
+             * \param offset The start of the node's segment.
+             * \param count The number of rows in the node.
+             * \param is_left Predicate deciding whether a row goes to the
+             * left child.  It is evaluated once per row of the node.
+             * \return The number of rows that went to the left child; the
+             * left child is `[offset, offset + result)` and the right child
+             * is the rest of the segment.
+             */
+            template <typename UnaryPredicate>
+            size_t partition(
+                    const size_t offset,
+                    const size_t count,
+                    UnaryPredicate is_left) {
+                if (count == 0) {
+                    return 0;
+                }
+
+                auto first = m_rows.begin() + offset;
+                for (auto row = first; row != first + count; ++row) {
+                    m_goes_left[*row] = is_left(*row) ? 1 : 0;
+                }
+
+                // nodes being split at the same time have disjoint segments,
+                // so each can use the same segment of the scratch space
+                const auto right = m_right.begin() + offset;
+                size_t nleft = 0;
+
+                for (size_t slot = 0; slot != m_ncols; ++slot) {
+                    first = m_rows.begin() + (slot * m_count + offset);
+                    auto out = first;
+                    auto right_out = right;
+                    for (auto row = first; row != first + count; ++row) {
+                        if (m_goes_left[*row]) {
+                            *out++ = *row;
+                        } else {
+                            *right_out++ = *row;
+                        }
+                    }
+                    std::copy(right, right_out, out);
+                    nleft = std::distance(first, out);
+                }
+                return nleft;
+            }
+
+            /**
+             * \return Number of rows (including repeats) in the root node.
+             */
+            size_t count() const {
+                return m_count;
+            }
+
+            /**
+             * \return Number of columns kept.
+             */
+            size_t ncol() const {
+                return m_ncols;
+            }
+
+            /**
+             * \return The columns kept, in ascending order.
+             */
+            const std::vector<size_t>& columns() const {
+                return m_columns;
+            }
+
+        private:
+            size_t m_ncols = 0;
+            size_t m_count = 0;
+            // the column kept in each slot, and the slot of each column
+            std::vector<size_t> m_columns;
+            std::vector<size_t> m_slots;
+            std::vector<index_type> m_rows;
+            std::vector<uint32_t> m_multiplicity;
+            std::vector<char> m_goes_left;
+            std::vector<index_type> m_right;
+    };
+}
+#endif //KMBNW_ODVB_COLUMN_INDEX_H
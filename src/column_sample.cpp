@@ -0,0 +1,75 @@
+/*
+ * Copyright 2017 Krysta M Bouzek
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <numeric>
+#include <algorithm>
+#include <stdexcept>
+#include "column_sample.h"
+
+namespace oddvibe {
+    // SplitMix64 finalizer, so that nearby seeds and streams give
+    // unrelated engine states
+    static uint64_t mix_seed(const uint64_t seed, const uint64_t stream) {
+        uint64_t z = seed + 0x9E3779B97F4A7C15ULL * (stream + 1);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        return z ^ (z >> 31);
+    }
+
+    void check_col_fractions(const TreeParams& params) {
+        const auto tree_fraction = params.tree_col_fraction;
+        const auto node_fraction = params.node_col_fraction;
+        if (!(tree_fraction > 0 && tree_fraction <= 1)) {
+            throw std::invalid_argument("tree_col_fraction must be in (0, 1]");
+        }
+        if (!(node_fraction > 0 && node_fraction <= 1)) {
+            throw std::invalid_argument("node_col_fraction must be in (0, 1]");
+        }
+    }
+
+    size_t sampled_count(const size_t ncols, const double fraction) {
+        if (!(fraction > 0 && fraction <= 1)) {
+            throw std::invalid_argument("Column fraction must be in (0, 1]");
+        }
+        const auto count = static_cast<size_t>(std::lround(fraction * ncols));
+        return std::min(ncols, std::max<size_t>(1, count));
+    }
+
+    void sample_columns(
+            const size_t ncols,
+            const double fraction,
+            const size_t seed,
+            const size_t stream,
+            std::vector<size_t>& out) {
+        const auto count = sampled_count(ncols, fraction);
+        out.resize(ncols);
+        std::iota(out.begin(), out.end(), 0);
+        if (count == ncols) {
+            return;
+        }
+
+        // the first `count` steps of a Fisher-Yates shuffle
+        std::mt19937_64 rand_engine(mix_seed(seed, stream));
+        for (size_t k = 0; k != count; ++k) {
+            std::uniform_int_distribution<size_t> dist(k, ncols - 1);
+            std::swap(out[k], out[dist(rand_engine)]);
+        }
+        out.resize(count);
+        std::sort(out.begin(), out.end());
+    }
+}
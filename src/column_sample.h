@@ -0,0 +1,60 @@
+/*
+ * Copyright 2017 Krysta M Bouzek
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef KMBNW_ODVB_COLUMN_SAMPLE_H
+#define KMBNW_ODVB_COLUMN_SAMPLE_H
+
+#include <cstddef>
+#include <vector>
+#include "params.h"
+
+/*! \file */
+
+namespace oddvibe {
+    /**
+     * Check TreeParams::tree_col_fraction and TreeParams::node_col_fraction.
+     * \throw std::invalid_argument if either is not in `(0, 1]`.
+     */
+    void check_col_fractions(const TreeParams& params);
+
+    /**
+     * \return The number of columns sample_columns() keeps out of `ncols`:
+     * `fraction * ncols` rounded to the nearest integer, but at least one.
+     * \throw std::invalid_argument if `fraction` is not in `(0, 1]`.
+     */
+    size_t sampled_count(const size_t ncols, const double fraction);
+
+    /**
+     * Choose a random subset of `ncols` feature columns.
+     *
+     * The subset depends only on the arguments, so subtrees fitted on
+     * different threads draw the same columns whatever the timing.
+     *
+     * \param ncols Number of columns to choose from.
+     * \param fraction Fraction of the columns to keep; see sampled_count().
+     * \param seed Random seed of the tree being fitted.
+     * \param stream Tells apart the subsets drawn with one seed, e.g. a
+     * node number.
+     * \param out Output for the chosen positions in `[0, ncols)`, in
+     * ascending order.  Its storage is reused.
+     */
+    void sample_columns(
+        const size_t ncols,
+        const double fraction,
+        const size_t seed,
+        const size_t stream,
+        std::vector<size_t>& out);
+}
+#endif //KMBNW_ODVB_COLUMN_SAMPLE_H
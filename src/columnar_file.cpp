@@ -0,0 +1,88 @@
+/*
+ * Copyright 2017 Krysta M Bouzek
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <limits>
+#include "columnar_file.h"
+
+namespace oddvibe {
+    static const char columnar_magic[8] = {
+        'O', 'D', 'V', 'B', 'C', 'O', 'L', '\0'
+    };
+
+    ColumnarHeader columnar_header(
+            const size_t nrow,
+            const size_t ncol,
+            const size_t dtype_size) {
+        if (dtype_size != 4 && dtype_size != 8) {
+            throw std::invalid_argument("Value size must be 4 or 8 bytes");
+        }
+        ColumnarHeader header;
+        std::memset(&header, 0, sizeof(header));
+        std::memcpy(header.magic, columnar_magic, sizeof(columnar_magic));
+        header.version = 1;
+        header.dtype_size = dtype_size;
+        header.nrow = nrow;
+        header.ncol = ncol;
+
+        // round each column up to a whole number of aligned blocks
+        const size_t per_block = columnar_alignment / dtype_size;
+        header.stride = (nrow + per_block - 1) / per_block * per_block;
+        header.data_offset = sizeof(ColumnarHeader);
+        return header;
+    }
+
+    void check_columnar_header(
+            const ColumnarHeader& header,
+            const size_t file_size) {
+        if (std::memcmp(header.magic, columnar_magic, sizeof(columnar_magic))) {
+            throw std::invalid_argument("Not a columnar file");
+        }
+        if (header.version != 1) {
+            throw std::invalid_argument("Unsupported columnar file version");
+        }
+        if (header.dtype_size != 4 && header.dtype_size != 8) {
+            throw std::invalid_argument("Unsupported columnar value size");
+        }
+        if (header.stride < header.nrow ||
+                header.data_offset < sizeof(ColumnarHeader) ||
+                header.data_offset % columnar_alignment != 0) {
+            throw std::invalid_argument("Invalid columnar file layout");
+        }
+
+        // feature columns plus the response, checked for overflow
+        const uint64_t max_size = std::numeric_limits<uint64_t>::max();
+        const uint64_t ncols = header.ncol + 1;
+        const uint64_t col_bytes = header.stride * header.dtype_size;
+        if (header.stride > max_size / header.dtype_size ||
+                ncols == 0 ||
+                col_bytes > max_size / ncols ||
+                header.data_offset > max_size - ncols * col_bytes ||
+                header.data_offset + ncols * col_bytes > file_size) {
+            throw std::invalid_argument("Columnar file is truncated");
+        }
+    }
+
+    ColumnarHeader read_columnar_header(const std::string& path) {
+        const MappedFile file(path);
+        ColumnarHeader header;
+        if (file.size() < sizeof(header)) {
+            throw std::invalid_argument("Not a columnar file: " + path);
+        }
+        std::memcpy(&header, file.data(), sizeof(header));
+        check_columnar_header(header, file.size());
+        return header;
+    }
+}
@@ -0,0 +1,210 @@
+/*
+ * Copyright 2017 Krysta M Bouzek
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef KMBNW_ODVB_COLUMNAR_FILE_H
+#define KMBNW_ODVB_COLUMNAR_FILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <memory>
+#include <fstream>
+#include <stdexcept>
+#include "float_matrix.h"
+#include "dataset.h"
+#include "mapped_file.h"
+
+/*! \file */
+
+namespace oddvibe {
+    /**
+     * Byte alignment of every column in a columnar file.
+     */
+    constexpr size_t columnar_alignment = 64;
+
+    /**
+     * Fixed-size header at the start of a columnar file.
+     *
+     * A columnar file holds a feature matrix and its response vector as
+     * little-endian values of a single floating point type.  The header is
+     * followed, at `data_offset` bytes from the start of the file, by the
+     * `ncol` feature columns and then the response column.  Each column
+     * holds `nrow` values and starts `stride` values after the previous
+     * one; the gap is zero padding that keeps every column aligned to
+     * columnar_alignment bytes.
+     * \sa write_columnar
+     * \sa load_columnar
+     */
+    struct ColumnarHeader {
+        /**
+         * "ODVBCOL" followed by a zero byte.
+         */
+        char magic[8];
+
+        /**
+         * Format version; currently 1.
+         */
+        uint32_t version;
+
+        /**
+         * Size in bytes of each value: 4 for float, 8 for double.
+         */
+        uint32_t dtype_size;
+
+        uint64_t nrow;
+
+        /**
+         * Number of feature columns, not counting the response.
+         */
+        uint64_t ncol;
+
+        /**
+         * Number of values from the start of one column to the next.
+         */
+        uint64_t stride;
+
+        /**
+         * Bytes from the start of the file to the first feature column.
+         */
+        uint64_t data_offset;
+
+        uint64_t reserved[2];
+    };
+
+    static_assert(sizeof(ColumnarHeader) == 64, "Header must be 64 bytes");
+
+    /**
+     * Create the header for a new columnar file.
+     *
+     * \param nrow Number of rows.
+     * \param ncol Number of feature columns.
+     * \param dtype_size Size in bytes of each value; 4 or 8.
+     * \return A header with a padded stride and the default data offset.
+     */
+    ColumnarHeader columnar_header(
+        const size_t nrow,
+        const size_t ncol,
+        const size_t dtype_size);
+
+    /**
+     * Check that a header is one this version can read and that it fits
+     * in a file of a given size.  Throws std::invalid_argument if not.
+     *
+     * \param header The header to check.
+     * \param file_size Size of the whole file in bytes.
+     */
+    void check_columnar_header(
+        const ColumnarHeader& header,
+        const size_t file_size);
+
+    /**
+     * Read and check the header of a columnar file without loading it, for
+     * example to find its value type before calling load_columnar().
+     *
+     * \param path Path of a file written by write_columnar().
+     * \return The header.  Throws std::invalid_argument if the file is not
+     * a valid columnar file.
+     */
+    ColumnarHeader read_columnar_header(const std::string& path);
+
+    /**
+     * Write a feature matrix and response vector as a columnar file.
+     *
+     * \param path Path of the file to create or overwrite.
+     * \param xs Feature matrix.
+     * \param ys Response vector; one value per row of `xs`.
+     */
+    template <typename FloatT>
+    void write_columnar(
+            const std::string& path,
+            const FloatMatrix<FloatT>& xs,
+            const std::vector<FloatT>& ys) {
+        if (xs.nrow() != ys.size()) {
+            throw std::invalid_argument("X and Y row counts do not match");
+        }
+        const auto nrow = xs.nrow();
+        const auto ncol = xs.ncol();
+        const auto header = columnar_header(nrow, ncol, sizeof(FloatT));
+
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        if (!out) {
+            throw std::runtime_error("Cannot create " + path);
+        }
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+        const std::vector<FloatT> padding(header.stride - nrow, 0);
+        const auto write_column = [&](const FloatT* values) {
+            out.write(
+                reinterpret_cast<const char*>(values), nrow * sizeof(FloatT));
+            out.write(
+                reinterpret_cast<const char*>(padding.data()),
+                padding.size() * sizeof(FloatT));
+        };
+        for (size_t col = 0; col != ncol; ++col) {
+            write_column(xs.col_data(col));
+        }
+        write_column(ys.data());
+
+        out.flush();
+        if (!out) {
+            throw std::runtime_error("Cannot write " + path);
+        }
+    }
+
+    /**
+     * Map a columnar file and use it as a Dataset.
+     *
+     * The feature matrix of the result is a view of the mapped file (see
+     * FloatMatrix::view()), so loading does not read the features and
+     * processes that load the same file share one copy of it in the page
+     * cache.  The mapping lasts as long as any copy of the feature matrix.
+     * The response is copied into memory.
+     *
+     * \param path Path of a file written by write_columnar().  Its values
+     * must be of type `FloatT`; this throws std::invalid_argument if they
+     * are not or if the file is not a valid columnar file.
+     * \return A Dataset backed by the mapped file.
+     */
+    template <typename FloatT>
+    Dataset<FloatT> load_columnar(const std::string& path) {
+        const auto file = std::make_shared<MappedFile>(path);
+
+        ColumnarHeader header;
+        if (file->size() < sizeof(header)) {
+            throw std::invalid_argument("Not a columnar file: " + path);
+        }
+        std::memcpy(&header, file->data(), sizeof(header));
+        check_columnar_header(header, file->size());
+        if (header.dtype_size != sizeof(FloatT)) {
+            throw std::invalid_argument(
+                "Columnar file value type does not match: " + path);
+        }
+
+        const auto first = reinterpret_cast<const FloatT*>(
+            file->data() + header.data_offset);
+        const size_t nrow = header.nrow;
+        const size_t ncol = header.ncol;
+        const size_t stride = header.stride;
+
+        const FloatT* const ys = first + ncol * stride;
+        return Dataset<FloatT>(
+            FloatMatrix<FloatT>::view(nrow, ncol, first, stride, file),
+            std::vector<FloatT>(ys, ys + nrow));
+    }
+}
+#endif //KMBNW_ODVB_COLUMNAR_FILE_H
@@ -0,0 +1,89 @@
+/*
+ * Copyright 2017 Krysta M Bouzek
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <numeric>
+#include <cmath>
+#include <stdexcept>
+#include "convergence.h"
+
+namespace oddvibe {
+    ConvergenceCheck::ConvergenceCheck(
+            const StopParams& params,
+            const size_t nrows) :
+        m_params(params),
+        m_prev(nrows, 0),
+        m_order(nrows) {
+        if (params.check_every < 1) {
+            throw std::invalid_argument("check_every must be >= 1");
+        }
+        if (params.patience < 1) {
+            throw std::invalid_argument("patience must be >= 1");
+        }
+        m_params.top_k = std::min(params.top_k, nrows);
+    }
+
+    bool ConvergenceCheck::converged(
+            const std::vector<size_t>& counts,
+            const size_t nrounds) {
+        if (counts.size() != m_prev.size()) {
+            throw std::invalid_argument(
+                "Counts vector must be same size as rows checked");
+        }
+        if (nrounds % m_params.check_every != 0) {
+            return false;
+        }
+
+        // rank rows by count, ties by row, then compare as a set
+        const auto top_k = m_params.top_k;
+        std::iota(m_order.begin(), m_order.end(), 0);
+        std::partial_sort(
+            m_order.begin(),
+            m_order.begin() + top_k,
+            m_order.end(),
+            [&counts](const size_t lhs, const size_t rhs) {
+                return (counts[lhs] > counts[rhs] ||
+                    (counts[lhs] == counts[rhs] && lhs < rhs));
+            });
+        m_top.assign(m_order.begin(), m_order.begin() + top_k);
+        std::sort(m_top.begin(), m_top.end());
+
+        double delta = 0;
+        const auto sz = counts.size();
+        for (size_t k = 0; k != sz; ++k) {
+            const double norm_count = (1.0 * counts[k]) / nrounds;
+            delta += std::abs(norm_count - m_prev[k]);
+            m_prev[k] = norm_count;
+        }
+        delta /= sz;
+
+        const bool stable = (
+            m_has_prev &&
+            m_top == m_prev_top &&
+            delta <= m_params.tolerance);
+        m_nstable = (stable ? m_nstable + 1 : 0);
+        m_has_prev = true;
+        std::swap(m_top, m_prev_top);
+
+        return (
+            nrounds >= m_params.min_rounds &&
+            m_nstable >= m_params.patience);
+    }
+
+    size_t ConvergenceCheck::nstable() const {
+        return m_nstable;
+    }
+}
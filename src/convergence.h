@@ -0,0 +1,78 @@
+/*
+ * Copyright 2017 Krysta M Bouzek
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef KMBNW_ODVB_CONVERGENCE_H
+#define KMBNW_ODVB_CONVERGENCE_H
+
+#include <cstddef>
+#include <vector>
+#include "params.h"
+
+/*! \file */
+
+namespace oddvibe {
+    /**
+     * Decide when the per-row selection counts of a boosting run have
+     * stabilized.
+     *
+     * Every StopParams::check_every rounds the counts, normalized by the
+     * number of rounds so far, are compared with those of the previous
+     * check.  A check is stable when the StopParams::top_k most-chosen rows
+     * are the same set of rows as before and the mean absolute change is at
+     * most StopParams::tolerance.
+     * \sa Booster::fit_counts
+     */
+    class ConvergenceCheck {
+        public:
+            /**
+             * Create a new instance.
+             *
+             * \param params When to stop.  `check_every` and `patience`
+             * must be at least one.
+             * \param nrows Number of rows being counted.
+             */
+            ConvergenceCheck(const StopParams& params, const size_t nrows);
+
+            ConvergenceCheck(const ConvergenceCheck& other) = delete;
+            ConvergenceCheck& operator=(const ConvergenceCheck& other) = delete;
+
+            /**
+             * Record the counts after a round of boosting.
+             *
+             * \param counts Number of times each row has been chosen so far.
+             * \param nrounds Number of rounds run so far, starting at one.
+             * \return True if boosting can stop after this round.
+             */
+            bool converged(
+                const std::vector<size_t>& counts,
+                const size_t nrounds);
+
+            /**
+             * \return Number of consecutive stable checks so far.
+             */
+            size_t nstable() const;
+
+        private:
+            StopParams m_params;
+            size_t m_nstable = 0;
+            bool m_has_prev = false;
+            std::vector<double> m_prev;
+            std::vector<size_t> m_top;
+            std::vector<size_t> m_prev_top;
+            std::vector<size_t> m_order;
+    };
+}
+#endif //KMBNW_ODVB_CONVERGENCE_H
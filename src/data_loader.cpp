@@ -0,0 +1,131 @@
+/*
+ * Copyright 2017 Krysta M Bouzek
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cmath>
+#include <cstdlib>
+#include <limits>
+#include <stdexcept>
+#include <locale.h>
+#ifdef __APPLE__
+#include <xlocale.h>
+#endif
+#include "data_loader.h"
+
+namespace oddvibe {
+    // strtod in the "C" locale, so that '.' is the decimal point whatever
+    // the locale of the process; R sessions, for one, often use a comma
+#ifdef _WIN32
+    static double c_strtod(const char* str, char** end) {
+        static const _locale_t c_locale = _create_locale(LC_NUMERIC, "C");
+        if (c_locale == nullptr) {
+            throw std::runtime_error("Cannot create the C locale");
+        }
+        return _strtod_l(str, end, c_locale);
+    }
+#else
+    static double c_strtod(const char* str, char** end) {
+        static const locale_t c_locale = newlocale(
+            LC_NUMERIC_MASK, "C", static_cast<locale_t>(0));
+        if (c_locale == static_cast<locale_t>(0)) {
+            throw std::runtime_error("Cannot create the C locale");
+        }
+        return strtod_l(str, end, c_locale);
+    }
+#endif
+
+    std::vector<size_t> split_lines(
+            const char* data,
+            const size_t size,
+            const size_t chunk_bytes) {
+        std::vector<size_t> bounds { 0 };
+        size_t pos = 0;
+        while (size - pos > chunk_bytes) {
+            const char* eol = static_cast<const char*>(std::memchr(
+                data + pos + chunk_bytes, '\n', size - pos - chunk_bytes));
+            if (eol == nullptr) {
+                break;
+            }
+            pos = eol + 1 - data;
+            if (pos != size) {
+                bounds.push_back(pos);
+            }
+        }
+        bounds.push_back(size);
+        return bounds;
+    }
+
+    size_t count_records(const char* first, const char* last) {
+        size_t count = 0;
+        while (first != last) {
+            const char* eol = static_cast<const char*>(
+                std::memchr(first, '\n', last - first));
+            const char* line_end = (eol == nullptr ? last : eol);
+            if (line_end != first && !(
+                    line_end - first == 1 && *first == '\r')) {
+                ++count;
+            }
+            first = (eol == nullptr ? last : eol + 1);
+        }
+        return count;
+    }
+
+    size_t count_fields(const char* first, const char* last, const char delim) {
+        // skip leading blank lines so that they match count_records
+        while (first != last && (*first == '\n' || *first == '\r')) {
+            ++first;
+        }
+        if (first == last) {
+            return 0;
+        }
+        size_t count = 1;
+        for (; first != last && *first != '\n' && *first != '\r'; ++first) {
+            if (*first == delim) {
+                ++count;
+            }
+        }
+        return count;
+    }
+
+    double parse_field(const char* first, const char* last) {
+        while (first != last && (*first == ' ' || *first == '\t')) {
+            ++first;
+        }
+        while (last != first && (last[-1] == ' ' || last[-1] == '\t')) {
+            --last;
+        }
+        const size_t len = last - first;
+        if (len == 0 || (len == 2 && first[0] == 'N' && first[1] == 'A')) {
+            return std::numeric_limits<double>::quiet_NaN();
+        }
+
+        // strtod_l needs a terminated string and the mapping has none
+        char buf[64];
+        if (len >= sizeof(buf)) {
+            throw std::invalid_argument(
+                "Field is too long to be a number: " +
+                std::string(first, 32) + "...");
+        }
+        std::memcpy(buf, first, len);
+        buf[len] = '\0';
+
+        char* end = nullptr;
+        const double value = c_strtod(buf, &end);
+        if (end != buf + len) {
+            throw std::invalid_argument("Not a number: " + std::string(buf));
+        }
+        return value;
+    }
+}
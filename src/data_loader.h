@@ -0,0 +1,309 @@
+/*
+ * Copyright 2017 Krysta M Bouzek
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef KMBNW_ODVB_DATA_LOADER_H
+#define KMBNW_ODVB_DATA_LOADER_H
+
+#include <cstddef>
+#include <cstring>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <stdexcept>
+#include "float_matrix.h"
+#include "dataset.h"
+#include "mapped_file.h"
+#include "thread_pool.h"
+
+/*! \file */
+
+namespace oddvibe {
+    /**
+     * Size of the pieces that a file is split into for parallel parsing.
+     */
+    constexpr size_t load_chunk_bytes = 1 << 20;
+
+    /**
+     * How to read a delimited text file.
+     */
+    struct CsvOptions {
+        /**
+         * Character between fields.
+         */
+        char delimiter = ',';
+
+        /**
+         * True if the first line holds column names and should be skipped.
+         */
+        bool has_header = false;
+    };
+
+    /**
+     * How much data a load read and how long it took.
+     */
+    struct LoadStats {
+        size_t bytes = 0;
+        double seconds = 0;
+
+        /**
+         * \return Throughput in megabytes (10^6 bytes) per second.
+         */
+        double mb_per_sec() const {
+            return (seconds > 0 ? bytes / seconds / 1e6 : 0);
+        }
+    };
+
+    /**
+     * Split a buffer of text lines into pieces that start at line starts.
+     *
+     * \param data The text.
+     * \param size Number of bytes of text.
+     * \param chunk_bytes Approximate size of each piece.
+     * \return Byte offsets of the start of every piece, followed by `size`.
+     */
+    std::vector<size_t> split_lines(
+        const char* data,
+        const size_t size,
+        const size_t chunk_bytes);
+
+    /**
+     * \return Number of lines in `[first, last)` that hold any text other
+     * than a carriage return; blank lines are not records.
+     */
+    size_t count_records(const char* first, const char* last);
+
+    /**
+     * \return Number of delimited fields in the first record of
+     * `[first, last)`.
+     */
+    size_t count_fields(const char* first, const char* last, const char delim);
+
+    /**
+     * Parse a single numeric field.
+     *
+     * The decimal point is always '.', whatever the locale of the process.
+     *
+     * \param first Pointer to the first character of the field.
+     * \param last Pointer past the last character of the field.
+     * \return The value; NaN for an empty field or `NA`.  Throws
+     * std::invalid_argument if the field is not a number.
+     */
+    double parse_field(const char* first, const char* last);
+
+    /**
+     * Call `fn()` and, if `stats` is not null, record `bytes` and how long
+     * the call took in it.
+     */
+    template <typename Function>
+    void timed_load(
+            const size_t bytes,
+            LoadStats* stats,
+            Function fn) {
+        const auto start = std::chrono::steady_clock::now();
+        fn();
+        if (stats != nullptr) {
+            const std::chrono::duration<double> elapsed =
+                std::chrono::steady_clock::now() - start;
+            stats->bytes = bytes;
+            stats->seconds = elapsed.count();
+        }
+    }
+
+    /**
+     * Load a delimited text file of numbers into a Dataset.
+     *
+     * Every record holds the feature values followed by the response.  The
+     * file is mapped and split into chunks of about load_chunk_bytes that
+     * are parsed in parallel: one pass counts the records of each chunk and
+     * a second pass writes each value straight into its place in the
+     * column-major feature matrix, so no row-major copy is ever made.
+     *
+     * \param path Path of the file to read.
+     * \param options Delimiter and header settings.
+     * \param pool Threads to parse chunks with, or null to parse them on the
+     * calling thread.  The result does not depend on the thread count.
+     * \param stats If not null, filled in with the size of the file and the
+     * time taken.
+     * \return The loaded Dataset.  Throws std::invalid_argument if a record
+     * has the wrong number of fields or a field is not a number.
+     */
+    template <typename FloatT>
+    Dataset<FloatT> load_csv(
+            const std::string& path,
+            const CsvOptions& options = CsvOptions(),
+            ThreadPool* pool = nullptr,
+            LoadStats* stats = nullptr) {
+        const MappedFile file(path);
+        std::vector<FloatT> xs, ys;
+        size_t ncols = 0;
+
+        timed_load(file.size(), stats, [&]() {
+            const char* data = file.data();
+            const char* const end = data + file.size();
+            if (options.has_header && data != end) {
+                const char* eol = static_cast<const char*>(
+                    std::memchr(data, '\n', end - data));
+                data = (eol == nullptr ? end : eol + 1);
+            }
+            const size_t size = end - data;
+
+            const size_t nfields = count_fields(data, end, options.delimiter);
+            if (nfields < 2) {
+                throw std::invalid_argument(
+                    "Records need features and a response: " + path);
+            }
+            ncols = nfields - 1;
+
+            const auto bounds = split_lines(data, size, load_chunk_bytes);
+            const auto nchunks = bounds.size() - 1;
+
+            // rows before each chunk
+            std::vector<size_t> first_rows(nchunks + 1, 0);
+            parallel_for(pool, nchunks, [&](const size_t chunk) {
+                first_rows[chunk + 1] = count_records(
+                    data + bounds[chunk], data + bounds[chunk + 1]);
+            });
+            for (size_t chunk = 0; chunk != nchunks; ++chunk) {
+                first_rows[chunk + 1] += first_rows[chunk];
+            }
+
+            const size_t nrows = first_rows[nchunks];
+            xs.resize(nrows * ncols);
+            ys.resize(nrows);
+
+            parallel_for(pool, nchunks, [&](const size_t chunk) {
+                const char* pos = data + bounds[chunk];
+                const char* const chunk_end = data + bounds[chunk + 1];
+                size_t row = first_rows[chunk];
+
+                while (pos != chunk_end) {
+                    const char* eol = static_cast<const char*>(
+                        std::memchr(pos, '\n', chunk_end - pos));
+                    const char* line_end = (eol == nullptr ? chunk_end : eol);
+                    const char* next = (eol == nullptr ? chunk_end : eol + 1);
+                    if (line_end != pos && line_end[-1] == '\r') {
+                        --line_end;
+                    }
+                    if (line_end == pos) {
+                        pos = next;
+                        continue;
+                    }
+
+                    size_t col = 0;
+                    const char* field = pos;
+                    while (true) {
+                        const char* delim = static_cast<const char*>(
+                            std::memchr(
+                                field, options.delimiter, line_end - field));
+                        const char* field_end = (
+                            delim == nullptr ? line_end : delim);
+                        if (col == nfields) {
+                            // one field too many is enough to reject it
+                            ++col;
+                            break;
+                        }
+                        const FloatT value = parse_field(field, field_end);
+                        if (col < ncols) {
+                            xs[col * nrows + row] = value;
+                        } else {
+                            ys[row] = value;
+                        }
+                        ++col;
+                        if (delim == nullptr) {
+                            break;
+                        }
+                        field = delim + 1;
+                    }
+                    if (col != nfields) {
+                        throw std::invalid_argument(
+                            "Record " + std::to_string(row + 1) +
+                            " does not have " + std::to_string(nfields) +
+                            " fields");
+                    }
+                    ++row;
+                    pos = next;
+                }
+            });
+        });
+
+        return Dataset<FloatT>(
+            FloatMatrix<FloatT>(ncols, std::move(xs)), std::move(ys));
+    }
+
+    /**
+     * Load a headerless binary file of values into a Dataset.
+     *
+     * The file holds one record after another, each made of `ncols`
+     * feature values followed by the response, as `FloatT` values in the
+     * byte order of this machine (little-endian on x86 and ARM).  Blocks
+     * of records are transposed in parallel straight into the column-major
+     * feature matrix.
+     *
+     * \param path Path of the file to read.
+     * \param ncols Number of feature columns in each record.
+     * \param pool Threads to transpose records with, or null to use the
+     * calling thread.
+     * \param stats If not null, filled in with the size of the file and the
+     * time taken.
+     * \return The loaded Dataset.  Throws std::invalid_argument if the file
+     * size is not a whole number of records.
+     */
+    template <typename FloatT>
+    Dataset<FloatT> load_raw(
+            const std::string& path,
+            const size_t ncols,
+            ThreadPool* pool = nullptr,
+            LoadStats* stats = nullptr) {
+        const MappedFile file(path);
+        const size_t record_bytes = (ncols + 1) * sizeof(FloatT);
+        if (ncols < 1 || file.size() % record_bytes != 0) {
+            throw std::invalid_argument(
+                "File is not a whole number of records: " + path);
+        }
+        const size_t nrows = file.size() / record_bytes;
+        std::vector<FloatT> xs(nrows * ncols), ys(nrows);
+
+        timed_load(file.size(), stats, [&]() {
+            const size_t block_rows = std::max<size_t>(
+                1, load_chunk_bytes / record_bytes);
+            const size_t nblocks = (nrows + block_rows - 1) / block_rows;
+
+            parallel_for(pool, nblocks, [&](const size_t block) {
+                const size_t first = block * block_rows;
+                const size_t last = std::min(nrows, first + block_rows);
+                const char* record = file.data() + first * record_bytes;
+                FloatT value;
+                for (size_t row = first; row != last; ++row) {
+                    for (size_t col = 0; col != ncols; ++col) {
+                        // the mapping need not be aligned for FloatT
+                        std::memcpy(
+                            &value, record + col * sizeof(FloatT), sizeof(value));
+                        xs[col * nrows + row] = value;
+                    }
+                    std::memcpy(
+                        &value, record + ncols * sizeof(FloatT), sizeof(value));
+                    ys[row] = value;
+                    record += record_bytes;
+                }
+            });
+        });
+
+        return Dataset<FloatT>(
+            FloatMatrix<FloatT>(ncols, std::move(xs)), std::move(ys));
+    }
+}
+#endif //KMBNW_ODVB_DATA_LOADER_H
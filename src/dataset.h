@@ -19,7 +19,13 @@
 #include <unordered_set>
 #include <limits>
 #include <algorithm>
+#include <memory>
+#include <mutex>
 #include "float_matrix.h"
+#include "binned_matrix.h"
+#include "quantile_sketch.h"
+#include "thread_pool.h"
+#include "column_index.h"
 #include "math_x.h"
 
 /*! \file */
@@ -37,7 +43,9 @@ namespace oddvibe {
             /**
              * Construct a new Dataset.
              *
-             * Enforces the precondition that `xs.nrow() == ys.size()`.
+             * Enforces the precondition that `xs.nrow() == ys.size()`.  If
+             * `xs` is a FloatMatrix::view() only the view is copied, so the
+             * caller's buffer must outlive this instance.
              *
              * \param xs Feature matrix
              * \param ys Response vector.
@@ -151,12 +159,12 @@ namespace oddvibe {
                 }
 
                 const auto acc_err = [&is_left, yhat_l, yhat_r, this](
-                        const FloatT init, const size_t row) {
+                        const double init, const size_t row) {
                     const FloatT yhat = is_left(row) ? yhat_l : yhat_r;
                     return init + mse_err(m_ys[row], yhat);
                 };
 
-                const double err = std::accumulate(first, last, 0, acc_err);
+                const double err = std::accumulate(first, last, 0.0, acc_err);
 
                 return (std::isnan(err) ? doubleMax : err);
             }
@@ -189,9 +197,107 @@ namespace oddvibe {
                 return m_ys;
             }
 
+            /**
+             * Quantized copy of the feature matrix.
+             *
+             * This is built on first use and cached, so that every tree
+             * fitted to this Dataset shares the same bins.  Asking for a
+             * different number of bins or a different sketch replaces the
+             * cached copy.
+             *
+             * \param max_bins The max number of bins per feature column.
+             * \param sketch_k Zero to find bin edges by sorting each column,
+             * or the accuracy parameter of the column_sketches() to take
+             * them from.
+             * \param pool Threads to sketch the columns with, or null to
+             * sketch on the calling thread.  The bins do not depend on it.
+             * Concurrent first calls may each sketch the columns, but only
+             * one builds the bins.
+             * \return Feature matrix quantized into at most `max_bins` bins
+             * per column.  It stays valid for as long as the pointer is
+             * kept, even if a later call replaces the cached copy.
+             * \sa BinnedMatrix, TreeParams::sketch_k
+             */
+            std::shared_ptr<const BinnedMatrix<FloatT>> bins(
+                    const size_t max_bins,
+                    const size_t sketch_k = 0,
+                    ThreadPool* pool = nullptr) const {
+                const auto is_cached = [this, max_bins, sketch_k]() {
+                    return (
+                        m_bins && m_bins->max_bins() == max_bins &&
+                        m_bins_sketch_k == sketch_k);
+                };
+
+                std::vector<QuantileSketch<FloatT>> sketches;
+                if (sketch_k != 0) {
+                    {
+                        std::lock_guard<std::mutex> lock(*m_cache_lock);
+                        if (is_cached()) {
+                            return m_bins;
+                        }
+                    }
+                    // not under the lock: while it waits for the pool this
+                    // thread may run another task that asks for the bins
+                    sketches = column_sketches(sketch_k, pool);
+                }
+
+                std::lock_guard<std::mutex> lock(*m_cache_lock);
+                if (!is_cached()) {
+                    if (sketch_k == 0) {
+                        m_bins = std::make_shared<const BinnedMatrix<FloatT>>(
+                            m_xs, max_bins);
+                    } else {
+                        m_bins = std::make_shared<const BinnedMatrix<FloatT>>(
+                            m_xs, max_bins, sketches);
+                    }
+                    m_bins_sketch_k = sketch_k;
+                }
+                return m_bins;
+            }
+
+            /**
+             * Sketch the distribution of every feature column in one pass
+             * over the data, in parallel parts of each column that are
+             * then merged.  Nothing is cached.
+             *
+             * \param k Accuracy parameter of the sketches.
+             * \param pool Threads to sketch with, or null to sketch on the
+             * calling thread.  The sketches do not depend on it.
+             * \return One QuantileSketch per column.
+             * \sa sketch_columns()
+             */
+            std::vector<QuantileSketch<FloatT>> column_sketches(
+                    const size_t k,
+                    ThreadPool* pool = nullptr) const {
+                return sketch_columns(m_xs, k, pool);
+            }
+
+            /**
+             * Per-column sort order of the feature matrix.
+             *
+             * This is built on first use and cached, so the sorting cost is
+             * paid once no matter how many trees are fitted to this Dataset.
+             *
+             * \return The cached ColumnIndex of xs().
+             */
+            const ColumnIndex<FloatT>& column_index() const {
+                std::lock_guard<std::mutex> lock(*m_cache_lock);
+                if (!m_index) {
+                    m_index = std::make_shared<const ColumnIndex<FloatT>>(m_xs);
+                }
+                return *m_index;
+            }
+
         private:
             FloatMatrix<FloatT> m_xs;
             std::vector<FloatT> m_ys;
+
+            // caches derived from m_xs; copies of a Dataset share them
+            mutable std::shared_ptr<std::mutex> m_cache_lock =
+                std::make_shared<std::mutex>();
+            mutable std::shared_ptr<const BinnedMatrix<FloatT>> m_bins;
+            mutable size_t m_bins_sketch_k = 0;
+            mutable std::shared_ptr<const ColumnIndex<FloatT>> m_index;
     };
 }
 #endif //KMBNW_ODVB_DATASET_H
@@ -14,10 +14,11 @@
  * limitations under the License.
  */
 
-#include <iostream>
 #include <vector>
 #include <random>
-#include <ctime>
+#include <limits>
+#include <numeric>
+#include <iterator>
 #include <algorithm>
 #include "ecdf_sampler.h"
 
@@ -28,12 +29,41 @@ namespace oddvibe {
 
     std::vector<size_t>
     EmpiricalSampler::gen_samples(const size_t nrows, const SamplingDist& pmf) {
-        std::discrete_distribution<size_t> dist(pmf.empirical_dist());
-        std::vector<size_t> seq(nrows, 0);
-        std::generate(
-            seq.begin(),
-            seq.end(),
-            [&] { return dist(m_rand_engine); });
+        std::vector<size_t> seq;
+        gen_samples(nrows, pmf, seq);
         return seq;
     }
+
+    void EmpiricalSampler::gen_samples(
+            const size_t nrows,
+            const SamplingDist& pmf,
+            std::vector<size_t>& samples) {
+        samples.assign(nrows, 0);
+
+        // fewer than two weights always give the first row and draw nothing
+        const auto& weights = pmf.weights();
+        if (weights.size() < 2) {
+            return;
+        }
+
+        // normalize and accumulate; the last entry is pinned to one so
+        // that rounding can never leave a draw past the end
+        const double total = std::accumulate(
+            weights.begin(), weights.end(), 0.0);
+        m_cdf.resize(weights.size());
+        double running = 0;
+        for (size_t k = 0; k != weights.size(); ++k) {
+            running += weights[k] / total;
+            m_cdf[k] = running;
+        }
+        m_cdf.back() = 1.0;
+
+        for (auto& sample : samples) {
+            const double draw = std::generate_canonical<
+                double, std::numeric_limits<double>::digits>(m_rand_engine);
+            sample = std::distance(
+                m_cdf.begin(),
+                std::lower_bound(m_cdf.begin(), m_cdf.end(), draw));
+        }
+    }
 }
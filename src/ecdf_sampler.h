@@ -25,6 +25,15 @@
 namespace oddvibe {
     /**
      * Generate samples of row indexes from a given distribution.
+     *
+     * Each draw is the first row whose normalized cumulative weight is at
+     * least a canonical double drawn from the engine, found by binary
+     * search; the cumulative weight of the last row is set to exactly one.
+     * With fewer than two rows every sample is row zero and nothing is
+     * drawn.  This is the sampler's own algorithm and is not tied to any
+     * standard library distribution.  The cumulative distribution is kept
+     * between calls so that repeated calls with the same distribution size
+     * do not allocate.
      */
     class EmpiricalSampler {
         public:
@@ -50,8 +59,26 @@ namespace oddvibe {
             std::vector<size_t>
             gen_samples(const size_t nrows, const SamplingDist& pmf);
 
+            /**
+             * Generate empirical samples with replacement from a given
+             * distribution into an existing vector.
+             *
+             * \param nrows The number of samples to generate.
+             * \param pmf The empirical distribution to generate row indexes
+             * from.
+             * \param samples[out] Resized to `nrows` and overwritten with
+             * the sampled row indexes.
+             */
+            void gen_samples(
+                    const size_t nrows,
+                    const SamplingDist& pmf,
+                    std::vector<size_t>& samples);
+
         private:
             std::mt19937 m_rand_engine;
+
+            // cumulative distribution of the last pmf sampled from
+            std::vector<double> m_cdf;
     };
 }
 #endif //KMBNW_ODVB_ECDF_SAMPLER_H
@@ -0,0 +1,278 @@
+/*
+ * Copyright 2017 Krysta M Bouzek
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef KMBNW_ODVB_FLAT_TREE_H
+#define KMBNW_ODVB_FLAT_TREE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <limits>
+#include <algorithm>
+#include <stdexcept>
+#include "float_matrix.h"
+#include "rtree.h"
+
+/*! \file */
+
+namespace oddvibe {
+    /**
+     * Read-only regression tree stored in flat arrays.
+     *
+     * Nodes are numbered in breadth-first order and the two children of an
+     * interior node are stored next to each other, so a node needs only its
+     * split column, its split value (or prediction, for a leaf) and the
+     * distance to its left child, which is zero for a leaf.  Prediction
+     * walks these arrays instead of chasing pointers and never reorders row
+     * indexes.
+     * \sa RTree
+     */
+    template <typename FloatT>
+    class FlatTree {
+        public:
+            /**
+             * A node with its split column resolved for one feature matrix;
+             * filled in by bind().
+             */
+            struct BoundNode {
+                const FloatT* col;
+                FloatT val;
+                uint32_t step;
+            };
+
+            FlatTree() = default;
+
+            /**
+             * Freeze a fitted RTree.
+             *
+             * \param tree The tree to copy.
+             */
+            explicit FlatTree(const RTree<FloatT>& tree) {
+                assign(tree);
+            }
+
+            FlatTree(FlatTree&& other) = default;
+            FlatTree& operator=(FlatTree&& other) = default;
+
+            FlatTree(const FlatTree& other) = default;
+            FlatTree& operator=(const FlatTree& other) = default;
+
+            ~FlatTree() = default;
+
+            /**
+             * Replace the contents of this instance with a fitted RTree.
+             * Existing storage is reused, so assigning trees no larger than
+             * any assigned before does not allocate.
+             *
+             * \param tree The tree to copy.
+             */
+            void assign(const RTree<FloatT>& tree) {
+                m_cols.clear();
+                m_vals.clear();
+                m_steps.clear();
+                m_depth = 0;
+
+                // breadth-first so that siblings are adjacent
+                std::vector<const RTree<FloatT>*>& queue = m_queue;
+                queue.assign(1, &tree);
+                size_t level_end = 1;
+                for (size_t node = 0; node != queue.size(); ++node) {
+                    if (node == level_end) {
+                        ++m_depth;
+                        level_end = queue.size();
+                    }
+                    const RTree<FloatT>& current = *queue[node];
+                    if (current.m_is_leaf) {
+                        m_cols.push_back(0);
+                        m_vals.push_back(current.m_yhat);
+                        m_steps.push_back(0);
+                    } else {
+                        m_cols.push_back(current.m_split.split_col());
+                        m_vals.push_back(current.m_split.split_val());
+                        m_steps.push_back(queue.size() - node);
+                        queue.push_back(current.m_left.get());
+                        queue.push_back(current.m_right.get());
+                    }
+                }
+                const auto nnodes = queue.size();
+                queue.clear();
+                if (nnodes >= std::numeric_limits<uint32_t>::max()) {
+                    throw std::length_error("Too many tree nodes");
+                }
+            }
+
+            /**
+             * Predict for a single row of a feature matrix.
+             *
+             * \param xs The feature matrix to generate a prediction for.
+             * \param row The zero-based row to predict.
+             * \return The prediction of the leaf that the row falls into.
+             */
+            FloatT predict(const FloatMatrix<FloatT>& xs, const size_t row) const {
+                uint32_t node = 0;
+                while (m_steps[node] != 0) {
+                    // NaN compares false and so goes right, as in SplitPoint
+                    const bool is_right = !(xs(row, m_cols[node]) <= m_vals[node]);
+                    node += m_steps[node] + is_right;
+                }
+                return m_vals[node];
+            }
+
+            /**
+             * Predict for a contiguous block of rows of a feature matrix.
+             *
+             * Rows are advanced one tree level at a time in small groups
+             * without branching on the data, so the comparisons for
+             * different rows are independent of each other and can overlap.
+             *
+             * \param xs The feature matrix to generate predictions for.
+             * \param first_row The first row to predict.
+             * \param last_row One past the last row to predict.
+             * \param out Output for `last_row - first_row` predictions; the
+             * prediction for `first_row` is written to `out[0]`.
+             */
+            void predict(
+                    const FloatMatrix<FloatT>& xs,
+                    const size_t first_row,
+                    const size_t last_row,
+                    FloatT* out) const {
+                std::vector<BoundNode> bound;
+                predict(xs, first_row, last_row, out, bound);
+            }
+
+            /**
+             * Predict for a contiguous block of rows, reusing `bound` as
+             * scratch space so that repeated calls need not allocate.
+             */
+            void predict(
+                    const FloatMatrix<FloatT>& xs,
+                    const size_t first_row,
+                    const size_t last_row,
+                    FloatT* out,
+                    std::vector<BoundNode>& bound) const {
+                bind(xs, bound);
+                predict_bound(bound, first_row, last_row, out);
+            }
+
+            /**
+             * Resolve the split column of every node for one feature
+             * matrix, so that a step down the tree is one node load and one
+             * feature load.
+             *
+             * \param xs The feature matrix to be predicted.
+             * \param bound Output for one BoundNode per node of the tree.
+             */
+            void bind(
+                    const FloatMatrix<FloatT>& xs,
+                    std::vector<BoundNode>& bound) const {
+                if (m_vals.empty()) {
+                    throw std::logic_error("Cannot predict with an empty tree");
+                }
+
+                const auto nnodes = size();
+                bound.resize(nnodes);
+                for (size_t node = 0; node != nnodes; ++node) {
+                    bound[node].col = xs.col_data(m_cols[node]);
+                    bound[node].val = m_vals[node];
+                    bound[node].step = m_steps[node];
+                }
+            }
+
+            /**
+             * Predict for a contiguous block of rows of the matrix that
+             * `bound` was bound to by bind().
+             *
+             * Rows are advanced one tree level at a time in small groups
+             * without branching on the data.  `bound` is only read, so
+             * threads may share it to predict different blocks at once.
+             *
+             * \param bound The nodes of this tree as filled in by bind().
+             * \param first_row The first row to predict.
+             * \param last_row One past the last row to predict.
+             * \param out Output for `last_row - first_row` predictions.
+             */
+            void predict_bound(
+                    const std::vector<BoundNode>& bound,
+                    const size_t first_row,
+                    const size_t last_row,
+                    FloatT* out) const {
+                if (bound.size() != size() || bound.empty()) {
+                    throw std::invalid_argument(
+                        "Bound nodes do not match the tree");
+                }
+
+                uint32_t nodes[group_rows];
+                for (size_t start = first_row; start < last_row; start += group_rows) {
+                    const auto sz = std::min(group_rows, last_row - start);
+                    std::fill(nodes, nodes + sz, 0);
+                    for (size_t level = 0; level != m_depth; ++level) {
+                        for (size_t k = 0; k != sz; ++k) {
+                            // leaves compare against column 0 and stay put
+                            const BoundNode& node = bound[nodes[k]];
+                            const bool is_right = !(node.col[start + k] <= node.val);
+                            nodes[k] += node.step + (is_right & (node.step != 0));
+                        }
+                    }
+                    for (size_t k = 0; k != sz; ++k) {
+                        out[start - first_row + k] = m_vals[nodes[k]];
+                    }
+                }
+            }
+
+            /**
+             * Predict for an input feature matrix.
+             *
+             * \param xs The feature matrix to generate predictions for.
+             * \return A vector of predictions, one for each row of the input
+             * matrix.
+             */
+            std::vector<FloatT> predict(const FloatMatrix<FloatT>& xs) const {
+                std::vector<FloatT> yhats(xs.nrow());
+                predict(xs, 0, xs.nrow(), yhats.data());
+                return yhats;
+            }
+
+            /**
+             * \return Number of nodes (interior and leaf) in the tree.
+             */
+            size_t size() const {
+                return m_cols.size();
+            }
+
+            /**
+             * \return Number of levels below the root.
+             */
+            size_t depth() const {
+                return m_depth;
+            }
+
+        private:
+            // rows advanced together by the block predict()
+            static constexpr size_t group_rows = 64;
+
+            std::vector<uint32_t> m_cols;
+            std::vector<FloatT> m_vals;
+            std::vector<uint32_t> m_steps;
+            size_t m_depth = 0;
+
+            // scratch space for assign(); not part of the tree
+            std::vector<const RTree<FloatT>*> m_queue;
+    };
+
+    template <typename FloatT>
+    constexpr size_t FlatTree<FloatT>::group_rows;
+}
+#endif //KMBNW_ODVB_FLAT_TREE_H
@@ -18,10 +18,23 @@
 #ifndef KMBNW_ODVB_FLOAT_MATRIX_H
 #define KMBNW_ODVB_FLOAT_MATRIX_H
 
+#include <cstddef>
+#include <vector>
+#include <memory>
+#include <stdexcept>
+
 /*! \file */
 
 namespace oddvibe {
     // follow R's NumericVector API where necessary to facilitate easier use
+    /**
+     * Column-major feature matrix.
+     *
+     * A matrix either owns its values or is a view of a column-major buffer
+     * owned by the caller (see view()), such as an R matrix or a numpy
+     * array.  Copying a view copies only the pointer.  The columns of a view
+     * may be padded, e.g. for alignment.
+     */
     template <typename FloatT>
     class FloatMatrix {
         public:
@@ -46,7 +59,9 @@ namespace oddvibe {
                     }
                     m_ncols = ncols;
                     m_nrows = xs.size() / ncols;
+                    m_stride = m_nrows;
                     m_xs = std::move(xs);
+                    m_data = m_xs.data();
                 }
             }
 
@@ -69,20 +84,110 @@ namespace oddvibe {
                     }
                     m_ncols = ncols;
                     m_nrows = xs.size() / ncols;
+                    m_stride = m_nrows;
                     m_xs = xs;
+                    m_data = m_xs.data();
                 }
             }
 
-            FloatMatrix(FloatMatrix&& other) = default;
-            FloatMatrix& operator=(FloatMatrix&& other) = default;
+            /**
+             * Create a view of a column-major buffer without copying it.
+             *
+             * \param nrows Number of rows.
+             * \param ncols Number of columns/features.
+             * \param xs Pointer to `nrows * ncols` values: column 0 followed
+             * by column 1, etc.  The buffer must not change and must outlive
+             * the view and every copy of it, including the copy held by a
+             * Dataset.
+             * \return A matrix that does not own its values.
+             */
+            static FloatMatrix view(
+                    const size_t nrows,
+                    const size_t ncols,
+                    const FloatT* xs) {
+                return view(nrows, ncols, xs, nrows, nullptr);
+            }
 
-            FloatMatrix(const FloatMatrix& other) = default;
-            FloatMatrix& operator=(const FloatMatrix& other) = default;
+            /**
+             * Create a view of a column-major buffer with padded columns.
+             *
+             * \param nrows Number of rows.
+             * \param ncols Number of columns/features.
+             * \param xs Pointer to the first value of column 0.
+             * \param stride Number of values from the start of one column to
+             * the start of the next; at least `nrows`.
+             * \param owner Kept alive by the view and all of its copies, e.g.
+             * a memory mapping that holds the buffer; may be null, in which
+             * case the buffer must outlive them as for the other overload.
+             * \return A matrix that does not own its values.
+             */
+            static FloatMatrix view(
+                    const size_t nrows,
+                    const size_t ncols,
+                    const FloatT* xs,
+                    const size_t stride,
+                    std::shared_ptr<const void> owner) {
+                if (xs == nullptr && nrows * ncols > 0) {
+                    throw std::invalid_argument("Cannot view a null buffer");
+                }
+                if (stride < nrows) {
+                    throw std::invalid_argument("Stride must be >= nrows");
+                }
+                FloatMatrix mat;
+                if (nrows * ncols > 0) {
+                    mat.m_nrows = nrows;
+                    mat.m_ncols = ncols;
+                    mat.m_stride = stride;
+                    mat.m_data = xs;
+                    mat.m_owner = std::move(owner);
+                }
+                return mat;
+            }
+
+            FloatMatrix(FloatMatrix&& other) {
+                take(other, std::move(other.m_xs));
+                other.clear();
+            }
+
+            FloatMatrix& operator=(FloatMatrix&& other) {
+                if (this != &other) {
+                    take(other, std::move(other.m_xs));
+                    other.clear();
+                }
+                return *this;
+            }
+
+            FloatMatrix(const FloatMatrix& other) {
+                take(other, std::vector<FloatT>(other.m_xs));
+            }
+
+            FloatMatrix& operator=(const FloatMatrix& other) {
+                if (this != &other) {
+                    take(other, std::vector<FloatT>(other.m_xs));
+                }
+                return *this;
+            }
 
             ~FloatMatrix() = default;
 
             FloatT operator() (const size_t row, const size_t col) const {
-                return m_xs[x_index(row, col)];
+                return m_data[x_index(row, col)];
+            }
+
+            /**
+             * \return Pointer to the first value of a column; the `nrow()`
+             * values of a column are contiguous.
+             */
+            const FloatT* col_data(const size_t col) const {
+                return m_data + x_index(0, col);
+            }
+
+            /**
+             * \return False if this instance is a view of a buffer owned by
+             * someone else.
+             */
+            bool owns_data() const {
+                return m_data == m_xs.data();
             }
 
             /**
@@ -102,11 +207,41 @@ namespace oddvibe {
             private:
                 size_t m_nrows = 0;
                 size_t m_ncols = 0;
+                size_t m_stride = 0;
                 std::vector<FloatT> m_xs;
+                // m_xs.data() unless this is a view
+                const FloatT* m_data = nullptr;
+                std::shared_ptr<const void> m_owner;
 
                 size_t x_index(const size_t row, const size_t col) const {
                     //        return (row * m_ncols) + col;
-                    return (col * m_nrows) + row;
+                    return (col * m_stride) + row;
+                }
+
+                /**
+                 * Copy or move the shape and ownership of another instance,
+                 * given its already copied or moved values.
+                 */
+                void take(const FloatMatrix& other, std::vector<FloatT>&& xs) {
+                    const bool owned = other.owns_data();
+                    m_nrows = other.m_nrows;
+                    m_ncols = other.m_ncols;
+                    m_stride = other.m_stride;
+                    m_owner = other.m_owner;
+                    m_xs = std::move(xs);
+                    m_data = (owned ? m_xs.data() : other.m_data);
+                }
+
+                /**
+                 * Leave this instance empty.
+                 */
+                void clear() {
+                    m_nrows = 0;
+                    m_ncols = 0;
+                    m_stride = 0;
+                    m_xs.clear();
+                    m_data = nullptr;
+                    m_owner.reset();
                 }
     };
 }
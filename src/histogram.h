@@ -0,0 +1,287 @@
+/*
+ * Copyright 2017 Krysta M Bouzek
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef KMBNW_ODVB_HISTOGRAM_H
+#define KMBNW_ODVB_HISTOGRAM_H
+
+#include <cstddef>
+#include <vector>
+#include <limits>
+#include <iterator>
+#include <stdexcept>
+#include "math_x.h"
+#include "binned_matrix.h"
+#include "split_point.h"
+#include "thread_pool.h"
+
+/*! \file */
+
+namespace oddvibe {
+    /**
+     * Running weighted sums of the response for the rows that fall into one
+     * bin; `count` is the total weight of the rows.
+     */
+    struct BinStats {
+        double sum = 0;
+        double sum_sq = 0;
+        double count = 0;
+    };
+
+    /**
+     * Per-bin response sums for the rows of a single tree node.
+     *
+     * There is one slot per bin of every column of a BinnedMatrix (see
+     * BinnedMatrix::slot_offset()).  Because the rows of the two children of
+     * a node partition the rows of the node, the histogram of one child is
+     * the histogram of the parent minus the histogram of its sibling.
+     */
+    class Histogram {
+        public:
+            Histogram() = default;
+
+            /**
+             * Create an empty histogram.
+             *
+             * \param nslots Number of slots; see BinnedMatrix::total_slots().
+             */
+            explicit Histogram(const size_t nslots) : m_slots(nslots) { }
+
+            Histogram(Histogram&& other) = default;
+            Histogram& operator=(Histogram&& other) = default;
+
+            Histogram(const Histogram& other) = default;
+            Histogram& operator=(const Histogram& other) = default;
+
+            ~Histogram() = default;
+
+            /**
+             * Accumulate the response for a set of rows into this instance.
+             *
+             * The elements from the range `[first, last]` are row indexes
+             * into `bins` and `ys`; repeated indexes are counted every time
+             * they appear.
+             *
+             * \param bins Quantized feature matrix.
+             * \param ys Response vector.
+             * \param y_center Value subtracted from each response before
+             * summing.  It must be the same for every histogram that will be
+             * combined with this one.
+             * \param first InputIterator to the initial position of
+             * the row indexes.
+             * \param last InputIterator to the final position of
+             * the row indexes.
+             * \param pool Threads to sum columns with, or null to sum them
+             * on the calling thread.
+             * \param weights Weight of each row of `ys`; by default every
+             * row counts once per time it appears.
+             * \param columns The columns to sum, or null to sum every
+             * column; the slots of other columns are left as they are.
+             */
+            template <
+                typename FloatT,
+                typename InputIterator,
+                typename WeightsT = UnitWeights>
+            void add(
+                    const BinnedMatrix<FloatT>& bins,
+                    const std::vector<FloatT>& ys,
+                    const double y_center,
+                    const InputIterator first,
+                    const InputIterator last,
+                    ThreadPool* pool = nullptr,
+                    const WeightsT& weights = WeightsT(),
+                    const std::vector<size_t>* columns = nullptr) {
+                if (m_slots.size() != bins.total_slots()) {
+                    throw std::invalid_argument(
+                        "Histogram size does not match binned matrix");
+                }
+                // every column has its own slots, so columns are independent
+                parallel_for(
+                    pool,
+                    columns != nullptr ? columns->size() : bins.ncol(),
+                    [&](const size_t k) {
+                        const auto col = (columns != nullptr ? (*columns)[k] : k);
+                        BinStats* const slots = &m_slots[bins.slot_offset(col)];
+                        if (bins.code_bytes() == 1) {
+                            add_column(
+                                bins.col_codes8(col), slots, ys, y_center,
+                                first, last, weights);
+                        } else {
+                            add_column(
+                                bins.col_codes16(col), slots, ys, y_center,
+                                first, last, weights);
+                        }
+                    });
+            }
+
+            /**
+             * Empty this instance and resize it, reusing its storage.
+             *
+             * \param nslots Number of slots; see BinnedMatrix::total_slots().
+             */
+            void reset(const size_t nslots) {
+                m_slots.assign(nslots, BinStats());
+            }
+
+            /**
+             * Subtract another histogram from this one, slot by slot.
+             *
+             * \param other Histogram of a subset of the rows of this one.
+             */
+            void subtract(const Histogram& other) {
+                if (m_slots.size() != other.m_slots.size()) {
+                    throw std::invalid_argument("Histogram sizes do not match");
+                }
+                const auto sz = m_slots.size();
+                for (size_t k = 0; k != sz; ++k) {
+                    m_slots[k].sum -= other.m_slots[k].sum;
+                    m_slots[k].sum_sq -= other.m_slots[k].sum_sq;
+                    m_slots[k].count -= other.m_slots[k].count;
+                }
+            }
+
+            const BinStats& operator[] (const size_t slot) const {
+                return m_slots[slot];
+            }
+
+            size_t size() const {
+                return m_slots.size();
+            }
+
+        private:
+            std::vector<BinStats> m_slots;
+
+            /**
+             * Accumulate the rows of one column, given its codes.
+             */
+            template <
+                typename CodeT,
+                typename FloatT,
+                typename InputIterator,
+                typename WeightsT>
+            static void add_column(
+                    const CodeT* codes,
+                    BinStats* slots,
+                    const std::vector<FloatT>& ys,
+                    const double y_center,
+                    const InputIterator first,
+                    const InputIterator last,
+                    const WeightsT& weights) {
+                for (auto row = first; row != last; row = std::next(row)) {
+                    const double w = weights[*row];
+                    const double y = ys[*row] - y_center;
+                    BinStats& stats = slots[codes[*row]];
+                    stats.sum += w * y;
+                    stats.sum_sq += w * y * y;
+                    stats.count += w;
+                }
+            }
+    };
+
+    /**
+     * Create a new "best" SplitPoint from a node histogram.
+     *
+     * This is the binned counterpart of best_split(): only the upper edges of
+     * the bins are considered as split values, so the result is exact when
+     * every column has no more distinct values than bins and approximate
+     * otherwise.  Ties resolve to the lowest column, then the lowest value.
+     *
+     * \param bins Quantized feature matrix the histogram was built from.
+     * \param hist Histogram of the rows of the node to split.
+     * \param pool Threads to scan columns with, or null to scan them on
+     * the calling thread.  The result does not depend on the thread count.
+     * \param scratch Scratch space to reuse, or null to allocate it for
+     * this call.
+     * \param columns The columns to consider, in ascending order, or null
+     * to consider every column.  Only these columns of `hist` need have
+     * been summed.
+     * \return A new SplitPoint instance that contains the best-split selection.
+     * If no such split could be found then the value of is_valid() from the
+     * returned SplitPoint will be false.
+     */
+    template <typename FloatT>
+    SplitPoint<FloatT>
+    best_split(
+            const BinnedMatrix<FloatT>& bins,
+            const Histogram& hist,
+            ThreadPool* pool = nullptr,
+            SplitScratch<FloatT>* scratch = nullptr,
+            const std::vector<size_t>* columns = nullptr) {
+        const auto ncols = (columns != nullptr ? columns->size() : bins.ncol());
+        SplitScratch<FloatT> own_scratch;
+        std::vector<SplitCandidate<FloatT>>& found = (
+            scratch != nullptr ? scratch->found : own_scratch.found);
+        found.assign(ncols, SplitCandidate<FloatT>());
+
+        parallel_for(
+            pool,
+            ncols,
+            [&](const size_t k) {
+                const auto col = (columns != nullptr ? (*columns)[k] : k);
+                const auto offset = bins.slot_offset(col);
+                const auto nbins = bins.nbins(col);
+                SplitCandidate<FloatT>& best = found[k];
+                best.col = col;
+
+                // the NaN slot at nbins is always on the right
+                BinStats total;
+                for (size_t bin = 0; bin <= nbins; ++bin) {
+                    const auto& stats = hist[offset + bin];
+                    total.sum += stats.sum;
+                    total.sum_sq += stats.sum_sq;
+                    total.count += stats.count;
+                }
+
+                // weights left over from subtracting sibling histograms
+                // are rounding error, not rows
+                const double min_count = 1e-9 * total.count;
+
+                BinStats left;
+                for (size_t bin = 0; bin != nbins; ++bin) {
+                    const auto& stats = hist[offset + bin];
+                    if (stats.count <= min_count) {
+                        continue;
+                    }
+                    left.sum += stats.sum;
+                    left.sum_sq += stats.sum_sq;
+                    left.count += stats.count;
+
+                    const double right_count = total.count - left.count;
+                    if (right_count <= min_count) {
+                        break;
+                    }
+
+                    const double err = (
+                        sum_sq_err(left.sum, left.sum_sq, left.count) +
+                        sum_sq_err(
+                            total.sum - left.sum,
+                            total.sum_sq - left.sum_sq,
+                            right_count));
+
+                    if (err < best.err) {
+                        best.val = bins.edge(col, bin);
+                        best.err = err;
+                    }
+                }
+            });
+
+        SplitCandidate<FloatT> best;
+        for (const auto& candidate : found) {
+            best.keep_better(candidate);
+        }
+        return SplitPoint<FloatT>(best.col, best.val);
+    }
+}
+#endif //KMBNW_ODVB_HISTOGRAM_H
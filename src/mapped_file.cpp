@@ -0,0 +1,85 @@
+/*
+ * Copyright 2017 Krysta M Bouzek
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cerrno>
+#include <system_error>
+#include "mapped_file.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+namespace oddvibe {
+#ifdef _WIN32
+    MappedFile::MappedFile(const std::string& path) {
+        throw std::system_error(
+            std::make_error_code(std::errc::function_not_supported),
+            "Cannot map " + path);
+    }
+
+    MappedFile::~MappedFile() {
+    }
+#else
+    MappedFile::MappedFile(const std::string& path) {
+        const int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            throw std::system_error(
+                errno, std::generic_category(), "Cannot open " + path);
+        }
+
+        struct stat info;
+        if (::fstat(fd, &info) != 0) {
+            const int err = errno;
+            ::close(fd);
+            throw std::system_error(
+                err, std::generic_category(), "Cannot stat " + path);
+        }
+        m_size = info.st_size;
+
+        // mmap rejects empty mappings; an empty file has nothing to read
+        if (m_size > 0) {
+            void* addr = ::mmap(
+                nullptr, m_size, PROT_READ, MAP_SHARED, fd, 0);
+            if (addr == MAP_FAILED) {
+                const int err = errno;
+                ::close(fd);
+                throw std::system_error(
+                    err, std::generic_category(), "Cannot map " + path);
+            }
+            m_data = static_cast<const char*>(addr);
+        }
+        // the mapping stays valid after the descriptor is closed
+        ::close(fd);
+    }
+
+    MappedFile::~MappedFile() {
+        if (m_data != nullptr) {
+            ::munmap(const_cast<char*>(m_data), m_size);
+        }
+    }
+#endif
+
+    const char* MappedFile::data() const {
+        return m_data;
+    }
+
+    size_t MappedFile::size() const {
+        return m_size;
+    }
+}
@@ -0,0 +1,68 @@
+/*
+ * Copyright 2017 Krysta M Bouzek
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef KMBNW_ODVB_MAPPED_FILE_H
+#define KMBNW_ODVB_MAPPED_FILE_H
+
+#include <cstddef>
+#include <string>
+
+/*! \file */
+
+namespace oddvibe {
+    /**
+     * A whole file mapped read-only into memory.
+     *
+     * The mapping is shared, so processes that map the same file read the
+     * same pages of the page cache rather than each holding a copy.
+     */
+    class MappedFile {
+        public:
+            /**
+             * Map a file.
+             *
+             * \param path Path of the file to map.  This throws
+             * std::system_error if the file cannot be opened or mapped.
+             */
+            explicit MappedFile(const std::string& path);
+
+            MappedFile(MappedFile&& other) = delete;
+            MappedFile& operator=(MappedFile&& other) = delete;
+
+            MappedFile(const MappedFile& other) = delete;
+            MappedFile& operator=(const MappedFile& other) = delete;
+
+            /**
+             * Unmap the file.
+             */
+            ~MappedFile();
+
+            /**
+             * \return Pointer to the first byte of the file; page aligned.
+             */
+            const char* data() const;
+
+            /**
+             * \return Size of the file in bytes.
+             */
+            size_t size() const;
+
+        private:
+            const char* m_data = nullptr;
+            size_t m_size = 0;
+    };
+}
+#endif //KMBNW_ODVB_MAPPED_FILE_H
@@ -19,12 +19,9 @@
 
 namespace oddvibe {
     void normalize(std::vector<float>& pmf) {
-        const auto norm = std::accumulate(std::begin(pmf), std::end(pmf), 0.0);
-        std::transform(
-            std::begin(pmf),
-            std::end(pmf),
-            std::begin(pmf),
-            [norm](float f) { return f / norm; });
+        const auto& kernels = simd_kernels();
+        const double norm = kernels.sum(pmf.data(), pmf.size());
+        kernels.divide(pmf.data(), pmf.size(), norm);
     }
 
     std::vector<float>
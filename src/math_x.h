@@ -15,6 +15,12 @@
  */
 #include <algorithm>
 #include <stdexcept>
+#include <vector>
+#include <limits>
+#include <numeric>
+#include <iterator>
+#include <cmath>
+#include "simd_kernels.h"
 
 #ifndef KMBNW_ODVB_MATHX_H
 #define KMBNW_ODVB_MATHX_H
@@ -28,6 +34,8 @@ namespace oddvibe {
     /**
      * Normalize a vector to sum to 1 (e.g. proper probability mass function).
      *
+     * The sum is accumulated in double with SimdKernels::sum.
+     *
      * \param pmf[inout] The vector to normalize; overwritten in-place.
      */
     void normalize(std::vector<float>& pmf);
@@ -89,6 +97,65 @@ namespace oddvibe {
         return total;
     }
 
+    /**
+     * Row weights that are all one.
+     *
+     * This stands in for a vector of per-row weights (indexed by row, like
+     * `std::vector<double>`) wherever rows are unweighted; the weighted code
+     * paths then compile down to the unweighted ones.
+     */
+    struct UnitWeights {
+        double operator[](const size_t) const {
+            return 1.0;
+        }
+    };
+
+    /**
+     * Calculate the filtered, weighted mean of a vector of values.
+     *
+     * \param seq The vector to calculate the filtered mean for.
+     * \param weights Non-negative weight of each row of `seq`.
+     * \param first InputIterator to the initial position of
+     * the row indexes.
+     * \param last InputIterator to the final position of
+     * the row indexes.
+     * \return The weighted mean of the values in the `seq` vector; NaN if the
+     * weights of the rows sum to zero.
+     * \sa mean()
+     */
+    template <typename FloatT, typename WeightsT, typename InputIterator>
+    FloatT mean(
+            const std::vector<FloatT>& seq,
+            const WeightsT& weights,
+            const InputIterator first,
+            const InputIterator last) {
+        double total = 0;
+        double total_weight = 0;
+        const auto sz = seq.size();
+
+        for (auto row = first; row != last; row = std::next(row)) {
+            const auto idx = *row;
+            if (idx >= sz) {
+                throw std::out_of_range("Row not in range");
+            }
+            total += weights[idx] * seq[idx];
+            total_weight += weights[idx];
+        }
+        return (FloatT) (total / total_weight);
+    }
+
+    /**
+     * Unweighted rows use the rolling mean of mean().
+     */
+    template <typename FloatT, typename InputIterator>
+    FloatT mean(
+            const std::vector<FloatT>& seq,
+            const UnitWeights&,
+            const InputIterator first,
+            const InputIterator last) {
+        return mean<FloatT>(seq, first, last);
+    }
+
     /**
      * Mean-squared error.
      */
@@ -137,6 +204,168 @@ namespace oddvibe {
         return (count < 1 ? nan_val : total / count);
     }
 
+    /**
+     * Calculate the filtered, weighted variance of a vector of values.
+     *
+     * \param seq The vector to calculate the filtered variance for.
+     * \param weights Non-negative weight of each row of `seq`.
+     * \param first InputIterator to the initial position of
+     * the row indexes.
+     * \param last InputIterator to the final position of
+     * the row indexes.
+     * \return The weighted variance of the values in the `seq` vector; NaN if
+     * the weights of the rows sum to zero.
+     * \sa variance()
+     */
+    template <typename FloatT, typename WeightsT, typename IteratorT>
+    FloatT variance(
+            const std::vector<FloatT>& seq,
+            const WeightsT& weights,
+            const IteratorT first,
+            const IteratorT last) {
+        const auto avg_x = mean<FloatT>(seq, weights, first, last);
+
+        double total = 0;
+        double total_weight = 0;
+        for (auto row = first; row != last; row = std::next(row)) {
+            total += weights[*row] * mse_err(seq[*row], avg_x);
+            total_weight += weights[*row];
+        }
+        return (FloatT) (total / total_weight);
+    }
+
+    /**
+     * Unweighted rows use variance().
+     */
+    template <typename FloatT, typename IteratorT>
+    FloatT variance(
+            const std::vector<FloatT>& seq,
+            const UnitWeights&,
+            const IteratorT first,
+            const IteratorT last) {
+        return variance<FloatT>(seq, first, last);
+    }
+
+    /**
+     * Sum of squared errors around the mean, computed from running sums.
+     *
+     * \param total Sum of the values.
+     * \param total_sq Sum of the squared values.
+     * \param count Number of values summed.
+     * \return The sum of squared deviations from the mean; zero if there
+     * are no values.  Small negative results caused by rounding are clamped
+     * to zero.
+     */
+    inline double sum_sq_err(
+            const double total,
+            const double total_sq,
+            const double count) {
+        if (count <= 0) {
+            return 0;
+        }
+        const double err = total_sq - (total * total) / count;
+        return (err < 0 ? 0 : err);
+    }
+
+    /**
+     * Rank each element of a vector.
+     *
+     * \param seq The values to rank.
+     * \return A vector of one-based ranks, one for each element of `seq`.
+     * Tied values all get the average of the ranks they span.
+     */
+    template <typename FloatT>
+    std::vector<double> ranks(const std::vector<FloatT>& seq) {
+        const auto sz = seq.size();
+        std::vector<size_t> order(sz);
+        std::iota(order.begin(), order.end(), 0);
+        std::sort(
+            order.begin(),
+            order.end(),
+            [&seq](const size_t lhs, const size_t rhs) {
+                return seq[lhs] < seq[rhs];
+            });
+
+        std::vector<double> result(sz, 0);
+        size_t start = 0;
+        while (start != sz) {
+            auto stop = start + 1;
+            while (stop != sz && !(seq[order[start]] < seq[order[stop]])) {
+                ++stop;
+            }
+            // ranks start..stop-1 (zero-based) are tied
+            const double avg_rank = 0.5 * (start + stop - 1) + 1;
+            for (auto k = start; k != stop; ++k) {
+                result[order[k]] = avg_rank;
+            }
+            start = stop;
+        }
+        return result;
+    }
+
+    /**
+     * Spearman rank correlation between two vectors.
+     *
+     * \param lhs The first vector of values.
+     * \param rhs The second vector of values; must be the same size as `lhs`,
+     * or this will throw an exception.
+     * \return The Pearson correlation of the ranks of `lhs` and `rhs`, in
+     * `[-1, 1]`.  If either vector has no variation this will return an
+     * appropriate NaN value that can be checked with `std::isnan`.
+     */
+    template <typename FloatT>
+    double rank_correlation(
+            const std::vector<FloatT>& lhs,
+            const std::vector<FloatT>& rhs) {
+        if (lhs.size() != rhs.size()) {
+            throw std::invalid_argument("Vectors must be same size");
+        }
+        const auto rank_l = ranks(lhs);
+        const auto rank_r = ranks(rhs);
+        const auto sz = rank_l.size();
+
+        // both rank vectors have the same mean
+        const double avg = 0.5 * (sz + 1);
+        double cov = 0, var_l = 0, var_r = 0;
+        for (size_t k = 0; k != sz; ++k) {
+            const double dl = rank_l[k] - avg;
+            const double dr = rank_r[k] - avg;
+            cov += dl * dr;
+            var_l += dl * dl;
+            var_r += dr * dr;
+        }
+        if (var_l <= 0 || var_r <= 0) {
+            return std::numeric_limits<double>::quiet_NaN();
+        }
+        return cov / std::sqrt(var_l * var_r);
+    }
+
+    /**
+     * Store the mse_err() of `n` predictions in `loss`.
+     */
+    inline void squared_errors(
+            const float* ys,
+            const float* yhats,
+            double* loss,
+            const size_t n) {
+        simd_kernels().squared_error_f32(ys, yhats, loss, n);
+    }
+
+    inline void squared_errors(
+            const double* ys,
+            const double* yhats,
+            double* loss,
+            const size_t n) {
+        simd_kernels().squared_error_f64(ys, yhats, loss, n);
+    }
+
+    /**
+     * Calculate the mse_err() of every prediction.
+     *
+     * \param ys Observed values.
+     * \param yhats Predicted values; must be the same size as `ys`.
+     * \return The loss for each row.
+     */
     template <typename FloatT>
     std::vector<double>
     loss_seq(const std::vector<FloatT>& ys, const std::vector<FloatT>& yhats) {
@@ -144,12 +373,7 @@ namespace oddvibe {
             throw std::logic_error("Observed and predicted must be same size");
         }
         std::vector<double> loss(yhats.size(), 0);
-        std::transform(
-            yhats.begin(),
-            yhats.end(),
-            ys.begin(),
-            loss.begin(),
-            mse_err<FloatT>);
+        squared_errors(ys.data(), yhats.data(), loss.data(), ys.size());
         return loss;
     }
 }
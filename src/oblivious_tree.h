@@ -0,0 +1,918 @@
+/*
+ * Copyright 2017 Krysta M Bouzek
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef KMBNW_ODVB_OBLIVIOUS_TREE_H
+#define KMBNW_ODVB_OBLIVIOUS_TREE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cmath>
+#include <vector>
+#include <memory>
+#include <limits>
+#include <iterator>
+#include <chrono>
+#include <algorithm>
+#include <stdexcept>
+#include "params.h"
+#include "column_sample.h"
+#include "math_x.h"
+#include "dataset.h"
+#include "column_index.h"
+#include "flat_tree.h"
+#include "thread_pool.h"
+#include "round_stats.h"
+
+/*! \file */
+
+namespace oddvibe {
+    /**
+     * Regression tree in which every node at a given depth splits on the
+     * same (feature, value) pair.
+     *
+     * A tree of depth `d` is `d` splits and `2^d` leaves.  The leaf of a row
+     * is its `d` comparisons packed into an index, root first in the most
+     * significant bit and 1 for "goes right", so prediction has no
+     * data-dependent branches and vectorizes across rows.  As in
+     * SplitPoint, a row goes left when its feature value is `<=` the split
+     * value and NaN values go right.
+     * \sa RTree, FlatTree
+     */
+    template <typename FloatT>
+    class ObliviousTree {
+        public:
+            class Trainer;
+            class Workspace;
+
+            /**
+             * A level's split with its column resolved for one feature
+             * matrix; filled in by bind().  `step` is not used.
+             */
+            typedef typename FlatTree<FloatT>::BoundNode BoundNode;
+
+            ObliviousTree() = default;
+
+            /**
+             * Create a tree from its splits and leaves.
+             *
+             * \param cols The split column of each level, root first.
+             * \param vals The split value of each level.
+             * \param leaves The prediction of each leaf, indexed by packed
+             * comparisons; must have `2^cols.size()` elements.
+             */
+            ObliviousTree(
+                    std::vector<uint32_t> cols,
+                    std::vector<FloatT> vals,
+                    std::vector<FloatT> leaves) :
+                    m_cols(std::move(cols)),
+                    m_vals(std::move(vals)),
+                    m_leaves(std::move(leaves)) {
+                if (m_cols.size() != m_vals.size()) {
+                    throw std::invalid_argument(
+                        "Must have one split value per split column");
+                }
+                if (m_cols.size() > max_depth) {
+                    throw std::length_error("Oblivious tree is too deep");
+                }
+                if (m_leaves.size() != (size_t(1) << m_cols.size())) {
+                    throw std::invalid_argument(
+                        "Must have 2^depth leaves");
+                }
+            }
+
+            ObliviousTree(ObliviousTree&& other) = default;
+            ObliviousTree& operator=(ObliviousTree&& other) = default;
+
+            ObliviousTree(const ObliviousTree& other) = default;
+            ObliviousTree& operator=(const ObliviousTree& other) = default;
+
+            ~ObliviousTree() = default;
+
+            /**
+             * Predict for a single row of a feature matrix.
+             *
+             * \param xs The feature matrix to generate a prediction for.
+             * \param row The zero-based row to predict.
+             * \return The prediction of the leaf that the row falls into.
+             */
+            FloatT predict(const FloatMatrix<FloatT>& xs, const size_t row) const {
+                if (m_leaves.empty()) {
+                    throw std::logic_error("Cannot predict with an empty tree");
+                }
+                uint32_t leaf = 0;
+                for (size_t level = 0; level != m_cols.size(); ++level) {
+                    const bool is_right = !(xs(row, m_cols[level]) <= m_vals[level]);
+                    leaf = (leaf << 1) | is_right;
+                }
+                return m_leaves[leaf];
+            }
+
+            /**
+             * Predict for a contiguous block of rows of a feature matrix.
+             *
+             * \param xs The feature matrix to generate predictions for.
+             * \param first_row The first row to predict.
+             * \param last_row One past the last row to predict.
+             * \param out Output for `last_row - first_row` predictions; the
+             * prediction for `first_row` is written to `out[0]`.
+             */
+            void predict(
+                    const FloatMatrix<FloatT>& xs,
+                    const size_t first_row,
+                    const size_t last_row,
+                    FloatT* out) const {
+                std::vector<BoundNode> bound;
+                bind(xs, bound);
+                predict_bound(bound, first_row, last_row, out);
+            }
+
+            /**
+             * Resolve the split column of every level for one feature
+             * matrix.
+             *
+             * \param xs The feature matrix to be predicted.
+             * \param bound Output for one BoundNode per level of the tree.
+             */
+            void bind(
+                    const FloatMatrix<FloatT>& xs,
+                    std::vector<BoundNode>& bound) const {
+                if (m_leaves.empty()) {
+                    throw std::logic_error("Cannot predict with an empty tree");
+                }
+
+                const auto nlevels = depth();
+                bound.resize(nlevels);
+                for (size_t level = 0; level != nlevels; ++level) {
+                    bound[level].col = xs.col_data(m_cols[level]);
+                    bound[level].val = m_vals[level];
+                    bound[level].step = 0;
+                }
+            }
+
+            /**
+             * Predict for a contiguous block of rows of the matrix that
+             * `bound` was bound to by bind().
+             *
+             * Each level compares one feature column against one value for
+             * a whole group of rows, so the loop over rows vectorizes.
+             * `bound` is only read, so threads may share it.
+             *
+             * \param bound The levels of this tree as filled in by bind().
+             * \param first_row The first row to predict.
+             * \param last_row One past the last row to predict.
+             * \param out Output for `last_row - first_row` predictions.
+             */
+            void predict_bound(
+                    const std::vector<BoundNode>& bound,
+                    const size_t first_row,
+                    const size_t last_row,
+                    FloatT* out) const {
+                if (bound.size() != depth() || m_leaves.empty()) {
+                    throw std::invalid_argument(
+                        "Bound levels do not match the tree");
+                }
+
+                uint32_t leaves[group_rows];
+                for (size_t start = first_row; start < last_row; start += group_rows) {
+                    const auto sz = std::min(group_rows, last_row - start);
+                    std::fill(leaves, leaves + sz, 0);
+                    for (const auto& split : bound) {
+                        const FloatT* col = split.col + start;
+                        const FloatT val = split.val;
+                        for (size_t k = 0; k != sz; ++k) {
+                            leaves[k] = (
+                                (leaves[k] << 1) |
+                                static_cast<uint32_t>(!(col[k] <= val)));
+                        }
+                    }
+                    for (size_t k = 0; k != sz; ++k) {
+                        out[start - first_row + k] = m_leaves[leaves[k]];
+                    }
+                }
+            }
+
+            /**
+             * Predict for an input feature matrix.
+             *
+             * \param xs The feature matrix to generate predictions for.
+             * \return A vector of predictions, one for each row of the input
+             * matrix.
+             */
+            std::vector<FloatT> predict(const FloatMatrix<FloatT>& xs) const {
+                std::vector<FloatT> yhats(xs.nrow());
+                predict(xs, 0, xs.nrow(), yhats.data());
+                return yhats;
+            }
+
+            /**
+             * \return Number of nodes (interior and leaf) of the equivalent
+             * complete binary tree, or zero for an empty tree.
+             */
+            size_t size() const {
+                return (m_leaves.empty() ? 0 : 2 * m_leaves.size() - 1);
+            }
+
+            /**
+             * \return Number of levels below the root, which is the number
+             * of splits.
+             */
+            size_t depth() const {
+                return m_cols.size();
+            }
+
+            /**
+             * \return The split column of a level, root first.
+             */
+            size_t split_col(const size_t level) const {
+                return m_cols[level];
+            }
+
+            /**
+             * \return The split value of a level, root first.
+             */
+            FloatT split_val(const size_t level) const {
+                return m_vals[level];
+            }
+
+            /**
+             * \return The prediction of each leaf, indexed by packed
+             * comparisons.
+             */
+            const std::vector<FloatT>& leaves() const {
+                return m_leaves;
+            }
+
+            /**
+             * The deepest tree that can be stored; leaf indexes are 32 bits.
+             */
+            static constexpr size_t max_depth = 31;
+
+        private:
+            // rows advanced together by predict_bound()
+            static constexpr size_t group_rows = 64;
+
+            std::vector<uint32_t> m_cols;
+            std::vector<FloatT> m_vals;
+            std::vector<FloatT> m_leaves;
+    };
+
+    template <typename FloatT>
+    constexpr size_t ObliviousTree<FloatT>::max_depth;
+
+    template <typename FloatT>
+    constexpr size_t ObliviousTree<FloatT>::group_rows;
+
+    /**
+     * Reusable storage for fitting one ObliviousTree after another.
+     *
+     * A Trainer given a Workspace keeps the fitted rows, their sort order
+     * within each column, the drawn columns and the split search buffers
+     * of every column here, and recycle() takes a finished tree's splits
+     * and leaves back, so once the workspace has grown to the largest tree
+     * it sees, fitting allocates nothing.
+     * \sa Trainer, RTree::Workspace
+     */
+    template <typename FloatT>
+    class ObliviousTree<FloatT>::Workspace {
+        public:
+            Workspace() = default;
+
+            Workspace(Workspace&& other) = delete;
+            Workspace& operator=(Workspace&& other) = delete;
+
+            Workspace(const Workspace& other) = delete;
+            Workspace& operator=(const Workspace& other) = delete;
+
+            ~Workspace() = default;
+
+            /**
+             * Take back the storage of a tree that is no longer needed for
+             * the next fit.
+             *
+             * \param tree The tree to recycle; it is left empty.
+             */
+            void recycle(ObliviousTree<FloatT>&& tree) {
+                m_split_cols.swap(tree.m_cols);
+                m_split_vals.swap(tree.m_vals);
+                m_means.swap(tree.m_leaves);
+                tree.m_cols.clear();
+                tree.m_vals.clear();
+                tree.m_leaves.clear();
+            }
+
+        private:
+            friend class ObliviousTree<FloatT>::Trainer;
+
+            /**
+             * The rows being fitted and the nodes of the current level.
+             */
+            struct FitRows {
+                // each distinct row once, ascending
+                std::vector<uint32_t> rows;
+                // total weight of each row of the data; zero if not fitted
+                std::vector<double> weights;
+                // node of each fitted row within the current level
+                std::vector<uint32_t> nodes;
+                // per node of the level: weighted sum of centered responses
+                // and total weight
+                std::vector<double> sums;
+                std::vector<double> totals;
+                double center = 0;
+                // node weights at or below this count as empty
+                double min_weight = 0;
+            };
+
+            /**
+             * The best split of one column for a level.
+             */
+            struct ColumnSplit {
+                double gain = 0;
+                FloatT val = 0;
+                bool found = false;
+            };
+
+            /**
+             * Buffers for scoring the candidates of one column.
+             */
+            struct ColumnScratch {
+                // per node: weighted sum and total weight of the rows left
+                // of the candidate
+                std::vector<double> left_sums;
+                std::vector<double> left_totals;
+                // node scores and their pairwise sums; see level_score()
+                std::vector<double> terms;
+                // per (node, bin) sums, and rows per bin, on bin codes
+                std::vector<double> slot_sums;
+                std::vector<double> slot_totals;
+                std::vector<size_t> slot_rows;
+            };
+
+            FitRows m_fit_rows;
+            // the fitted rows of the tree's columns, for SplitMethod::exact
+            SortedColumns m_cols;
+            std::vector<size_t> m_tree_cols;
+            std::vector<size_t> m_level_cols;
+            std::vector<ColumnSplit> m_col_splits;
+            // one per column searched at a time
+            std::vector<ColumnScratch> m_scratch;
+            // the fitted tree, and the predictions of the previous level
+            std::vector<uint32_t> m_split_cols;
+            std::vector<FloatT> m_split_vals;
+            std::vector<FloatT> m_means;
+            std::vector<FloatT> m_parent_means;
+    };
+
+    /**
+     * Fits an ObliviousTree one level at a time.
+     *
+     * Every level is one scan per column that scores each candidate value
+     * for all nodes of the level at once.  With SplitMethod::exact the
+     * fitted rows are put in order once per tree for each of the tree's
+     * columns (see SortedColumns), so a level costs one pass over the
+     * fitted rows whatever the number of nodes; with SplitMethod::histogram
+     * it sums the rows into per-node bins and scans the bin edges.  A
+     * candidate's score is the drop in weighted squared error summed over
+     * every node of the level.  Growth stops at TreeParams::max_depth, or
+     * earlier once no split lowers the error.
+     */
+    template <typename FloatT>
+    class ObliviousTree<FloatT>::Trainer {
+        public:
+            /**
+             * Create a new Trainer.
+             *
+             * \param params Tree depth and split search settings.  Only
+             * `max_depth`, `split_method`, `max_bins`, `sketch_k` and the
+             * column fractions are used; TreeParams::node_col_fraction
+             * applies to each level.
+             * \param pool Threads to scan columns with, or null to scan them
+             * on the calling thread.  The fitted tree does not depend on the
+             * number of threads.
+             * \param workspace Buffers to fit with, or null to allocate them
+             * for every tree.  It must outlive the Trainer and be used by
+             * only one fit at a time.
+             * \param stats If not null, the split search of every level is
+             * timed and tallied here.  It must outlive the Trainer.
+             */
+            explicit Trainer(
+                    const TreeParams& params,
+                    ThreadPool* pool = nullptr,
+                    Workspace* workspace = nullptr,
+                    SplitSearchStats* stats = nullptr) :
+                    m_params(params),
+                    m_pool(pool),
+                    m_workspace(workspace),
+                    m_stats(stats) {}
+
+            Trainer(Trainer&& other) = delete;
+            Trainer& operator=(Trainer&& other) = delete;
+
+            Trainer(const Trainer& other) = delete;
+            Trainer& operator=(const Trainer& other) = delete;
+
+            ~Trainer() = default;
+
+            /**
+             * Fit an ObliviousTree to filtered data.
+             *
+             * \param data Feature matrix and response vector to fit.
+             * \param first InputIterator to the initial position of the row
+             * indexes; repeated indexes are counted every time they appear.
+             * \param last InputIterator to the final position of the row
+             * indexes.
+             * \param seed Random seed for drawing the columns of the tree
+             * and of each level when TreeParams::tree_col_fraction or
+             * TreeParams::node_col_fraction is below one.
+             * \return The fitted tree.
+             */
+            template <typename InputIterator>
+            ObliviousTree<FloatT> fit(
+                    const Dataset<FloatT>& data,
+                    const InputIterator first,
+                    const InputIterator last,
+                    const size_t seed = 0) const {
+                return fit_weighted(data, UnitWeights(), first, last, seed);
+            }
+
+            /**
+             * Fit an ObliviousTree to weighted rows, as RTree::Trainer does.
+             *
+             * \param data Feature matrix and response vector to fit.
+             * \param weights Weight of each row of `data`, indexed by row;
+             * must have `data.nrow()` elements.  The weights of the rows to
+             * fit must be positive.
+             * \param first InputIterator to the initial position of the row
+             * indexes.
+             * \param last InputIterator to the final position of the row
+             * indexes.
+             * \param seed Random seed for drawing columns.
+             * \return The fitted tree.
+             */
+            template <typename InputIterator>
+            ObliviousTree<FloatT> fit(
+                    const Dataset<FloatT>& data,
+                    const std::vector<double>& weights,
+                    const InputIterator first,
+                    const InputIterator last,
+                    const size_t seed = 0) const {
+                if (weights.size() != data.nrow()) {
+                    throw std::invalid_argument(
+                        "Must have one weight per row of data");
+                }
+                return fit_weighted(data, weights, first, last, seed);
+            }
+
+        private:
+            typedef typename Workspace::FitRows FitRows;
+            typedef typename Workspace::ColumnSplit ColumnSplit;
+            typedef typename Workspace::ColumnScratch ColumnScratch;
+
+            TreeParams m_params;
+            ThreadPool* m_pool = nullptr;
+            Workspace* m_workspace = nullptr;
+            SplitSearchStats* m_stats = nullptr;
+
+            /**
+             * Weighted squared error removed from a node by predicting its
+             * mean, up to a constant: `sum^2 / weight`.
+             */
+            static double node_score(
+                    const double sum,
+                    const double weight,
+                    const double min_weight) {
+                return (weight > min_weight ? sum * sum / weight : 0);
+            }
+
+            /**
+             * \return The summed score of the two halves of a node when
+             * `left_sums[node]` and `left_totals[node]` went left.
+             */
+            static double halves_score(
+                    const FitRows& fit_rows,
+                    const std::vector<double>& left_sums,
+                    const std::vector<double>& left_totals,
+                    const size_t node) {
+                return (
+                    node_score(
+                        left_sums[node], left_totals[node],
+                        fit_rows.min_weight) +
+                    node_score(
+                        fit_rows.sums[node] - left_sums[node],
+                        fit_rows.totals[node] - left_totals[node],
+                        fit_rows.min_weight));
+            }
+
+            /**
+             * Score every node of the level when `left_sums` and
+             * `left_totals` went left, and sum the scores.
+             *
+             * `terms` is filled as a complete binary tree over the nodes
+             * (a level always has a power of two of them): node `k`'s
+             * score is at `nnodes + k` and every other entry `i` is the sum
+             * of entries `2i` and `2i + 1`.  The total at entry 1 thus
+             * depends only on the current sums, and update_term() changes
+             * one node's score in `log2(nnodes)` additions.
+             *
+             * \return The summed score of the level.
+             */
+            static double level_score(
+                    const FitRows& fit_rows,
+                    const std::vector<double>& left_sums,
+                    const std::vector<double>& left_totals,
+                    std::vector<double>& terms) {
+                const auto nnodes = fit_rows.sums.size();
+                terms.resize(2 * nnodes);
+                for (size_t node = 0; node != nnodes; ++node) {
+                    terms[nnodes + node] = halves_score(
+                        fit_rows, left_sums, left_totals, node);
+                }
+                for (size_t k = nnodes - 1; k > 0; --k) {
+                    terms[k] = terms[2 * k] + terms[2 * k + 1];
+                }
+                return terms[1];
+            }
+
+            /**
+             * Recompute one node's score in `terms` from its sums, and the
+             * sums above it, after rows of the node moved left.
+             *
+             * \return The summed score of the level.
+             */
+            static double update_term(
+                    const FitRows& fit_rows,
+                    const std::vector<double>& left_sums,
+                    const std::vector<double>& left_totals,
+                    const size_t node,
+                    std::vector<double>& terms) {
+                const auto nnodes = fit_rows.sums.size();
+                auto k = nnodes + node;
+                terms[k] = halves_score(fit_rows, left_sums, left_totals, node);
+                for (k /= 2; k > 0; k /= 2) {
+                    terms[k] = terms[2 * k] + terms[2 * k + 1];
+                }
+                return terms[1];
+            }
+
+            template <typename WeightsT, typename InputIterator>
+            ObliviousTree<FloatT> fit_weighted(
+                    const Dataset<FloatT>& data,
+                    const WeightsT& weights,
+                    const InputIterator first,
+                    const InputIterator last,
+                    const size_t seed) const {
+                if (first == last) {
+                    throw std::invalid_argument("Must have at least one entry");
+                }
+                if (m_params.max_depth > ObliviousTree<FloatT>::max_depth) {
+                    throw std::invalid_argument(
+                        "max_depth is too large for an oblivious tree");
+                }
+                check_col_fractions(m_params);
+
+                const auto nrows = data.nrow();
+                const auto ncols = data.ncol();
+                const FloatMatrix<FloatT>& xs = data.xs();
+                if (nrows >= std::numeric_limits<uint32_t>::max()) {
+                    throw std::length_error("Too many rows to fit");
+                }
+                const FloatT* ys = data.ys().data();
+
+                Workspace own_space;
+                Workspace& space = (
+                    m_workspace != nullptr ? *m_workspace : own_space);
+
+                FitRows& fit_rows = space.m_fit_rows;
+                fit_rows.rows.clear();
+                fit_rows.weights.assign(nrows, 0.0);
+                for (auto it = first; it != last; it = std::next(it)) {
+                    const auto row = *it;
+                    if (fit_rows.weights[row] == 0) {
+                        fit_rows.rows.push_back(row);
+                    }
+                    fit_rows.weights[row] += weights[row];
+                }
+                std::sort(fit_rows.rows.begin(), fit_rows.rows.end());
+
+                double total = 0;
+                double weighted_sum = 0;
+                for (const auto row : fit_rows.rows) {
+                    total += fit_rows.weights[row];
+                    weighted_sum += fit_rows.weights[row] * ys[row];
+                }
+                fit_rows.center = weighted_sum / total;
+                fit_rows.min_weight = total * 1e-12;
+                fit_rows.nodes.assign(nrows, 0);
+                fit_rows.sums.assign(1, 0.0);
+                fit_rows.totals.assign(1, total);
+
+                double sum_sq = 0;
+                for (const auto row : fit_rows.rows) {
+                    const double y = ys[row] - fit_rows.center;
+                    fit_rows.sums[0] += fit_rows.weights[row] * y;
+                    sum_sq += fit_rows.weights[row] * y * y;
+                }
+
+                // the prediction of every node of the current level
+                std::vector<FloatT>& means = space.m_means;
+                means.assign(1, fit_rows.center);
+                if (std::isnan(means[0])) {
+                    throw std::logic_error("Prediction is NaN");
+                }
+
+                std::vector<uint32_t>& split_cols = space.m_split_cols;
+                std::vector<FloatT>& split_vals = space.m_split_vals;
+                split_cols.clear();
+                split_vals.clear();
+                // as the RTree leaf test: too little variance to split
+                if (sum_sq / total < 1e-6) {
+                    return ObliviousTree<FloatT>(
+                        std::move(split_cols), std::move(split_vals),
+                        std::move(means));
+                }
+
+                // stream zero draws the tree's columns, stream `level + 1`
+                // those of a level, as RTree::Trainer numbers its nodes
+                std::vector<size_t>& tree_cols = space.m_tree_cols;
+                sample_columns(
+                    ncols, m_params.tree_col_fraction, seed, 0, tree_cols);
+                std::vector<size_t>& level_cols = space.m_level_cols;
+                level_cols.assign(tree_cols.begin(), tree_cols.end());
+
+                // held for the whole fit in case another fit replaces the
+                // cached bins
+                std::shared_ptr<const BinnedMatrix<FloatT>> bins;
+                if (m_params.split_method == SplitMethod::histogram) {
+                    bins = data.bins(
+                        m_params.max_bins, m_params.sketch_k, m_pool);
+                } else {
+                    space.m_cols.assign(
+                        data.column_index(), fit_rows.rows.begin(),
+                        fit_rows.rows.end(), &tree_cols);
+                }
+                const double min_gain = 1e-6 * total;
+
+                std::vector<ColumnSplit>& col_splits = space.m_col_splits;
+                col_splits.resize(tree_cols.size());
+                if (space.m_scratch.size() < tree_cols.size()) {
+                    space.m_scratch.resize(tree_cols.size());
+                }
+                for (size_t level = 0; level != m_params.max_depth; ++level) {
+                    const auto start = std::chrono::steady_clock::now();
+                    if (m_params.node_col_fraction != 1.0) {
+                        sample_columns(
+                            tree_cols.size(), m_params.node_col_fraction,
+                            seed, level + 1, level_cols);
+                        for (auto& col : level_cols) {
+                            col = tree_cols[col];
+                        }
+                    }
+                    const auto width = level_cols.size();
+                    parallel_for(m_pool, width, [&](const size_t k) {
+                        const auto col = level_cols[k];
+                        col_splits[k] = (
+                            bins != nullptr ?
+                            best_binned(
+                                *bins, ys, fit_rows, col, space.m_scratch[k]) :
+                            best_exact(
+                                data, space.m_cols, fit_rows, col,
+                                space.m_scratch[k]));
+                    });
+                    if (m_stats != nullptr) {
+                        size_t ncandidates = fit_rows.rows.size() * width;
+                        if (bins != nullptr) {
+                            ncandidates = 0;
+                            for (const auto col : level_cols) {
+                                ncandidates += bins->nbins(col);
+                            }
+                        }
+                        m_stats->add(
+                            ncandidates, std::chrono::steady_clock::now() - start);
+                    }
+
+                    // ties go to the lowest column
+                    size_t best = width;
+                    double best_gain = min_gain;
+                    for (size_t k = 0; k != width; ++k) {
+                        if (col_splits[k].found && col_splits[k].gain > best_gain) {
+                            best = k;
+                            best_gain = col_splits[k].gain;
+                        }
+                    }
+                    if (best == width) {
+                        break;
+                    }
+
+                    const auto best_col = level_cols[best];
+                    const auto val = col_splits[best].val;
+                    split_cols.push_back(best_col);
+                    split_vals.push_back(val);
+                    descend(
+                        xs, ys, best_col, val, fit_rows, means,
+                        space.m_parent_means);
+                }
+                return ObliviousTree<FloatT>(
+                    std::move(split_cols), std::move(split_vals),
+                    std::move(means));
+            }
+
+            /**
+             * Move every fitted row to its node in the next level and
+             * compute the sums and predictions of the new nodes.  Empty
+             * nodes predict the same as their parent.
+             */
+            static void descend(
+                    const FloatMatrix<FloatT>& xs,
+                    const FloatT* ys,
+                    const size_t col,
+                    const FloatT val,
+                    FitRows& fit_rows,
+                    std::vector<FloatT>& means,
+                    std::vector<FloatT>& parent_means) {
+                const auto nnodes = 2 * fit_rows.sums.size();
+                fit_rows.sums.assign(nnodes, 0.0);
+                fit_rows.totals.assign(nnodes, 0.0);
+                const FloatT* values = xs.col_data(col);
+                for (const auto row : fit_rows.rows) {
+                    const bool is_right = !(values[row] <= val);
+                    const auto node = 2 * fit_rows.nodes[row] + is_right;
+                    const double w = fit_rows.weights[row];
+                    fit_rows.nodes[row] = node;
+                    fit_rows.sums[node] += w * (ys[row] - fit_rows.center);
+                    fit_rows.totals[node] += w;
+                }
+
+                parent_means.swap(means);
+                means.resize(nnodes);
+                for (size_t node = 0; node != nnodes; ++node) {
+                    means[node] = (
+                        fit_rows.totals[node] > fit_rows.min_weight ?
+                        static_cast<FloatT>(
+                            fit_rows.center +
+                            fit_rows.sums[node] / fit_rows.totals[node]) :
+                        parent_means[node / 2]);
+                }
+            }
+
+            /**
+             * Scan the fitted rows of one column in sorted order, moving
+             * rows from the right half of their node to the left one at a
+             * time and scoring each distinct value.
+             */
+            static ColumnSplit best_exact(
+                    const Dataset<FloatT>& data,
+                    const SortedColumns& cols,
+                    const FitRows& fit_rows,
+                    const size_t col,
+                    ColumnScratch& scratch) {
+                const auto order = cols.begin(col, 0);
+                const auto nfit = cols.count();
+                const FloatT* values = data.xs().col_data(col);
+                const FloatT* ys = data.ys().data();
+                const auto nnodes = fit_rows.sums.size();
+
+                std::vector<double>& left_sums = scratch.left_sums;
+                std::vector<double>& left_totals = scratch.left_totals;
+                left_sums.assign(nnodes, 0.0);
+                left_totals.assign(nnodes, 0.0);
+                const double base = level_score(
+                    fit_rows, left_sums, left_totals, scratch.terms);
+
+                // only the node of the row that moved changes its score
+                double score = base;
+                ColumnSplit best;
+                bool has_prev = false;
+                bool nan_right = false;
+                FloatT prev = 0;
+                for (size_t k = 0; k != nfit; ++k) {
+                    const auto row = order[k];
+                    const auto x = values[row];
+                    if (std::isnan(x)) {
+                        // NaN sorts last and always goes right
+                        nan_right = true;
+                        break;
+                    }
+                    if (has_prev && prev < x) {
+                        consider(best, score - base, prev);
+                    }
+
+                    const auto node = fit_rows.nodes[row];
+                    const double w = fit_rows.weights[row];
+                    left_sums[node] += w * (ys[row] - fit_rows.center);
+                    left_totals[node] += w;
+                    score = update_term(
+                        fit_rows, left_sums, left_totals, node, scratch.terms);
+                    prev = x;
+                    has_prev = true;
+                }
+                if (has_prev && nan_right) {
+                    consider(best, score - base, prev);
+                }
+                return best;
+            }
+
+            /**
+             * Sum one column into per-node bins and score each bin edge.
+             */
+            static ColumnSplit best_binned(
+                    const BinnedMatrix<FloatT>& bins,
+                    const FloatT* ys,
+                    const FitRows& fit_rows,
+                    const size_t col,
+                    ColumnScratch& scratch) {
+                const auto nnodes = fit_rows.sums.size();
+                const auto nbins = bins.nbins(col);
+                // one more slot for NaN
+                const auto nslots = nbins + 1;
+
+                std::vector<double>& slot_sums = scratch.slot_sums;
+                std::vector<double>& slot_totals = scratch.slot_totals;
+                std::vector<size_t>& slot_rows = scratch.slot_rows;
+                slot_sums.assign(nnodes * nslots, 0.0);
+                slot_totals.assign(nnodes * nslots, 0.0);
+                slot_rows.assign(nslots, 0);
+                if (bins.code_bytes() == 1) {
+                    add_rows(
+                        bins.col_codes8(col), ys, fit_rows, nslots,
+                        slot_sums, slot_totals, slot_rows);
+                } else {
+                    add_rows(
+                        bins.col_codes16(col), ys, fit_rows, nslots,
+                        slot_sums, slot_totals, slot_rows);
+                }
+
+                std::vector<double>& left_sums = scratch.left_sums;
+                std::vector<double>& left_totals = scratch.left_totals;
+                left_sums.assign(nnodes, 0.0);
+                left_totals.assign(nnodes, 0.0);
+                const double base = level_score(
+                    fit_rows, left_sums, left_totals, scratch.terms);
+                const auto nfit = fit_rows.rows.size();
+
+                ColumnSplit best;
+                size_t nleft = 0;
+                for (size_t bin = 0; bin != nbins; ++bin) {
+                    if (slot_rows[bin] == 0) {
+                        continue;
+                    }
+                    nleft += slot_rows[bin];
+                    for (size_t node = 0; node != nnodes; ++node) {
+                        left_sums[node] += slot_sums[node * nslots + bin];
+                        left_totals[node] += slot_totals[node * nslots + bin];
+                    }
+                    if (nleft == nfit) {
+                        break;
+                    }
+                    const double score = level_score(
+                        fit_rows, left_sums, left_totals, scratch.terms);
+                    consider(best, score - base, bins.edge(col, bin));
+                }
+                return best;
+            }
+
+            template <typename CodeT>
+            static void add_rows(
+                    const CodeT* codes,
+                    const FloatT* ys,
+                    const FitRows& fit_rows,
+                    const size_t nslots,
+                    std::vector<double>& slot_sums,
+                    std::vector<double>& slot_totals,
+                    std::vector<size_t>& slot_rows) {
+                for (const auto row : fit_rows.rows) {
+                    const double w = fit_rows.weights[row];
+                    const auto slot = fit_rows.nodes[row] * nslots + codes[row];
+                    slot_sums[slot] += w * (ys[row] - fit_rows.center);
+                    slot_totals[slot] += w;
+                    ++slot_rows[codes[row]];
+                }
+            }
+
+            /**
+             * Keep a candidate if it beats the best so far; ties keep the
+             * lower value.
+             */
+            static void consider(
+                    ColumnSplit& best,
+                    const double gain,
+                    const FloatT val) {
+                if (!best.found || gain > best.gain) {
+                    best.gain = gain;
+                    best.val = val;
+                    best.found = true;
+                }
+            }
+    };
+}
+#endif //KMBNW_ODVB_OBLIVIOUS_TREE_H
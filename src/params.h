@@ -0,0 +1,171 @@
+/*
+ * Copyright 2017 Krysta M Bouzek
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef KMBNW_ODVB_PARAMS_H
+#define KMBNW_ODVB_PARAMS_H
+
+#include <cstddef>
+
+/*! \file */
+
+namespace oddvibe {
+    /**
+     * How an RTree::Trainer searches for split points.
+     */
+    enum class SplitMethod {
+        /**
+         * Consider every distinct feature value of every node.
+         */
+        exact,
+
+        /**
+         * Quantize each feature column into at most TreeParams::max_bins
+         * bins once per Dataset and search per-bin sums at each node.
+         */
+        histogram
+    };
+
+    /**
+     * The weak learner fitted in each round of boosting.
+     */
+    enum class TreeKind {
+        /**
+         * An RTree, which chooses its own split for every node.
+         */
+        rtree,
+
+        /**
+         * An ObliviousTree, which splits every node of a level on the same
+         * (feature, value) pair.
+         */
+        oblivious
+    };
+
+    /**
+     * Settings for fitting a single RTree.
+     * \sa RTree::Trainer
+     */
+    struct TreeParams {
+        /**
+         * The max depth/height of a fitted tree.
+         */
+        size_t max_depth = 6;
+
+        /**
+         * Split search strategy.
+         */
+        SplitMethod split_method = SplitMethod::exact;
+
+        /**
+         * The kind of tree Booster fits each round.
+         */
+        TreeKind tree_kind = TreeKind::rtree;
+
+        /**
+         * Max number of bins per feature column when `split_method` is
+         * SplitMethod::histogram.  Must be in `[2, 65535]`.  Up to 255
+         * bins store each feature value in one byte, more need two.
+         */
+        size_t max_bins = 255;
+
+        /**
+         * With SplitMethod::histogram, zero finds the bin edges by sorting
+         * each feature column.  Otherwise they are the cuts of a
+         * QuantileSketch of each column with this accuracy parameter
+         * (at least 8), built in one pass in memory that does not grow with
+         * the row count; the edges are then approximate quantiles.
+         */
+        size_t sketch_k = 0;
+
+        /**
+         * Number of threads used to search for splits, including the
+         * calling thread.  Zero means one per hardware thread.  The fitted
+         * trees do not depend on this setting.
+         */
+        size_t nthreads = 1;
+
+        /**
+         * Child subtrees of nodes shallower than this depth are fitted as
+         * parallel tasks when more than one thread is available.
+         */
+        size_t parallel_depth = 4;
+
+        /**
+         * Child subtrees of nodes with fewer rows than this are always
+         * fitted one after the other on the same thread.
+         */
+        size_t min_parallel_rows = 4096;
+
+        /**
+         * Fraction of the feature columns each tree may split on, drawn at
+         * random for every tree.  Must be in `(0, 1]`; at least one column
+         * is always drawn.
+         */
+        double tree_col_fraction = 1.0;
+
+        /**
+         * Fraction of the tree's columns searched for the split of each
+         * node (each level of an ObliviousTree), drawn at random for every
+         * node.  Must be in `(0, 1]`.  Split search time shrinks in
+         * proportion.
+         */
+        double node_col_fraction = 1.0;
+
+        /**
+         * When boosting, fit each tree to the distinct rows drawn that
+         * round, each weighted by how many times it was drawn, instead of
+         * to every draw.  The trees are the same up to rounding.
+         */
+        bool weight_samples = false;
+    };
+
+    /**
+     * When to stop boosting early because the normalized counts have
+     * stopped changing.
+     * \sa ConvergenceCheck
+     */
+    struct StopParams {
+        /**
+         * Never stop before this many rounds.
+         */
+        size_t min_rounds = 50;
+
+        /**
+         * Compare the normalized counts every this many rounds.
+         */
+        size_t check_every = 10;
+
+        /**
+         * Number of most-chosen rows that must stay the same between
+         * checks.  Zero disables this test.
+         */
+        size_t top_k = 10;
+
+        /**
+         * Largest mean absolute change of the normalized counts between
+         * checks that still counts as stable.  Normalized counts average
+         * about one, and between checks they change by roughly
+         * `check_every / rounds` of that.
+         */
+        double tolerance = 0.05;
+
+        /**
+         * Number of consecutive stable checks needed to stop.
+         */
+        size_t patience = 5;
+    };
+}
+#endif //KMBNW_ODVB_PARAMS_H
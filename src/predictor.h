@@ -0,0 +1,232 @@
+/*
+ * Copyright 2017 Krysta M Bouzek
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef KMBNW_ODVB_PREDICTOR_H
+#define KMBNW_ODVB_PREDICTOR_H
+
+#include <cstddef>
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+#include "float_matrix.h"
+#include "flat_tree.h"
+#include "thread_pool.h"
+
+/*! \file */
+
+namespace oddvibe {
+    /**
+     * Default rows per block of BlockPredictor; small enough that a
+     * block's features and predictions stay in cache.
+     */
+    constexpr size_t predict_block_rows = 4096;
+
+    /**
+     * Prediction engine that splits the rows of a feature matrix into
+     * cache-sized blocks and predicts the blocks on a thread pool.  Trees
+     * may be FlatTree or ObliviousTree instances.
+     *
+     * Each tree's nodes are bound to the matrix once per call and shared
+     * read-only by all threads.  Every thread takes a contiguous run of
+     * blocks and writes only its own rows of the output, so the results do
+     * not depend on the number of threads.  Scratch space is kept between
+     * calls, so predicting the same shapes again does not allocate.
+     */
+    template <typename FloatT>
+    class BlockPredictor {
+        public:
+            /**
+             * Create a new engine.
+             *
+             * \param pool Threads to predict blocks on; null to predict on
+             * the calling thread only.
+             * \param block_rows Rows per block.
+             */
+            explicit BlockPredictor(
+                    ThreadPool* pool = nullptr,
+                    const size_t block_rows = predict_block_rows) :
+                    m_pool(pool),
+                    m_block_rows(block_rows) {
+                if (block_rows == 0) {
+                    throw std::invalid_argument("block_rows must be positive");
+                }
+            }
+
+            BlockPredictor(BlockPredictor&& other) = default;
+            BlockPredictor& operator=(BlockPredictor&& other) = default;
+
+            BlockPredictor(const BlockPredictor& other) = delete;
+            BlockPredictor& operator=(const BlockPredictor& other) = delete;
+
+            ~BlockPredictor() = default;
+
+            /**
+             * Predict every row of a feature matrix.
+             *
+             * \param tree The tree to predict with.
+             * \param xs The feature matrix to generate predictions for.
+             * \param out Output for `xs.nrow()` predictions, one per row.
+             */
+            template <typename TreeT>
+            void predict(
+                    const TreeT& tree,
+                    const FloatMatrix<FloatT>& xs,
+                    FloatT* out) {
+                bind_trees(&tree, 1, xs);
+                const auto& bound = m_bound[0];
+                for_each_range(xs.nrow(), [&](
+                        const size_t, const size_t first, const size_t count) {
+                    tree.predict_bound(bound, first, first + count, out + first);
+                });
+            }
+
+            /**
+             * Predict every row of a feature matrix with each of a batch of
+             * trees.  All trees are applied to a block before moving on to
+             * the next, so the block's features are read from memory once.
+             *
+             * \param trees The trees to predict with.
+             * \param xs The feature matrix to generate predictions for.
+             * \param out Output for `trees.size() * xs.nrow()` predictions;
+             * tree `t`'s prediction for row `r` is written to
+             * `out[t * xs.nrow() + r]`.
+             */
+            template <typename TreeT>
+            void predict(
+                    const std::vector<TreeT>& trees,
+                    const FloatMatrix<FloatT>& xs,
+                    FloatT* out) {
+                const auto nrows = xs.nrow();
+                const auto ntrees = trees.size();
+                bind_trees(trees.data(), ntrees, xs);
+                for_each_range(nrows, [&](
+                        const size_t, const size_t first, const size_t count) {
+                    for (size_t t = 0; t != ntrees; ++t) {
+                        trees[t].predict_bound(
+                            m_bound[t], first, first + count,
+                            out + t * nrows + first);
+                    }
+                });
+            }
+
+            /**
+             * Predict every row of a feature matrix into per-thread scratch
+             * space and hand each block to a callback while it is still in
+             * cache.
+             *
+             * `on_block(first, count, yhats)` is called once per block with
+             * the first row of the block, its number of rows and its
+             * predictions.  Calls may come from several threads at once;
+             * without a pool of at least two threads they come from the
+             * calling thread in row order.
+             *
+             * \param tree The tree to predict with.
+             * \param xs The feature matrix to generate predictions for.
+             * \param on_block Function to call with each predicted block.
+             */
+            template <typename TreeT, typename BlockFn>
+            void for_each_block(
+                    const TreeT& tree,
+                    const FloatMatrix<FloatT>& xs,
+                    const BlockFn& on_block) {
+                bind_trees(&tree, 1, xs);
+                const auto& bound = m_bound[0];
+                const auto ntasks = task_count(xs.nrow());
+                if (m_yhats.size() < ntasks) {
+                    m_yhats.resize(ntasks);
+                }
+                for (size_t task = 0; task != ntasks; ++task) {
+                    m_yhats[task].resize(m_block_rows);
+                }
+                for_each_range(xs.nrow(), [&](
+                        const size_t task, const size_t first, const size_t count) {
+                    FloatT* yhats = m_yhats[task].data();
+                    tree.predict_bound(bound, first, first + count, yhats);
+                    on_block(first, count, static_cast<const FloatT*>(yhats));
+                });
+            }
+
+            /**
+             * \return True if blocks are predicted on more than one thread.
+             */
+            bool is_parallel() const {
+                return m_pool != nullptr && m_pool->size() > 1;
+            }
+
+            /**
+             * \return Rows per block.
+             */
+            size_t block_rows() const {
+                return m_block_rows;
+            }
+
+        private:
+            // tasks per thread, so that a slow thread does not hold up the
+            // others for long
+            static constexpr size_t tasks_per_thread = 4;
+
+            ThreadPool* m_pool;
+            size_t m_block_rows;
+
+            // scratch space; one set of bound nodes per tree and one block
+            // of predictions per task.  Both kinds of tree bind to the same
+            // node type.
+            std::vector<std::vector<typename FlatTree<FloatT>::BoundNode>> m_bound;
+            std::vector<std::vector<FloatT>> m_yhats;
+
+            template <typename TreeT>
+            void bind_trees(
+                    const TreeT* trees,
+                    const size_t ntrees,
+                    const FloatMatrix<FloatT>& xs) {
+                if (m_bound.size() < ntrees) {
+                    m_bound.resize(ntrees);
+                }
+                for (size_t t = 0; t != ntrees; ++t) {
+                    trees[t].bind(xs, m_bound[t]);
+                }
+            }
+
+            size_t block_count(const size_t nrows) const {
+                return (nrows + m_block_rows - 1) / m_block_rows;
+            }
+
+            size_t task_count(const size_t nrows) const {
+                const auto nthreads = (is_parallel() ? m_pool->size() : 1);
+                return std::min(block_count(nrows), nthreads * tasks_per_thread);
+            }
+
+            // call fn(task, first, count) for every block, each task taking
+            // a contiguous run of blocks
+            template <typename RangeFn>
+            void for_each_range(const size_t nrows, const RangeFn& fn) {
+                const auto nblocks = block_count(nrows);
+                const auto ntasks = task_count(nrows);
+                const auto block_rows = m_block_rows;
+                parallel_for(m_pool, ntasks, [&](const size_t task) {
+                    const auto first_block = task * nblocks / ntasks;
+                    const auto last_block = (task + 1) * nblocks / ntasks;
+                    for (size_t block = first_block; block != last_block; ++block) {
+                        const auto first = block * block_rows;
+                        fn(task, first, std::min(block_rows, nrows - first));
+                    }
+                });
+            }
+    };
+
+    template <typename FloatT>
+    constexpr size_t BlockPredictor<FloatT>::tasks_per_thread;
+}
+#endif //KMBNW_ODVB_PREDICTOR_H
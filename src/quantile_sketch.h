@@ -0,0 +1,433 @@
+/*
+ * Copyright 2017 Krysta M Bouzek
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef KMBNW_ODVB_QUANTILE_SKETCH_H
+#define KMBNW_ODVB_QUANTILE_SKETCH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cmath>
+#include <vector>
+#include <limits>
+#include <utility>
+#include <algorithm>
+#include <stdexcept>
+#include "float_matrix.h"
+#include "thread_pool.h"
+
+/*! \file */
+
+namespace oddvibe {
+    /**
+     * Default accuracy parameter of a QuantileSketch.
+     */
+    constexpr size_t default_sketch_k = 200;
+
+    /**
+     * Streaming, mergeable summary of the distribution of one feature
+     * column (a KLL sketch).
+     *
+     * Values are kept in levels; a value on level `h` stands for `2^h`
+     * values added.  When a level outgrows its capacity it is sorted and
+     * every other value moves up a level, so the sketch keeps at most about
+     * `3k` values however many are added, and the rank of any value it reports
+     * is off by a fraction of the count that shrinks roughly as `1 / k`.
+     * Until the first compaction every value is kept and quantiles are
+     * exact.
+     *
+     * Which half of a level moves up is decided by a generator seeded at
+     * construction, so the same values added and merged in the same order
+     * always give the same sketch.  The smallest and largest values are
+     * tracked exactly.  NaN values are not counted.
+     */
+    template <typename FloatT>
+    class QuantileSketch {
+        public:
+            /**
+             * Create an empty sketch.
+             *
+             * \param k Accuracy parameter: the capacity of the top level;
+             * must be at least 8.
+             * \param seed Seed for choosing which values to keep.
+             */
+            explicit QuantileSketch(
+                    const size_t k = default_sketch_k,
+                    const uint64_t seed = 0) :
+                    m_k(k),
+                    // xorshift needs a nonzero state
+                    m_rand_state((seed * 0x9E3779B97F4A7C15ULL) | 1) {
+                if (k < 8) {
+                    throw std::invalid_argument("Sketch k must be >= 8");
+                }
+                grow();
+            }
+
+            QuantileSketch(QuantileSketch&& other) = default;
+            QuantileSketch& operator=(QuantileSketch&& other) = default;
+
+            QuantileSketch(const QuantileSketch& other) = default;
+            QuantileSketch& operator=(const QuantileSketch& other) = default;
+
+            ~QuantileSketch() = default;
+
+            /**
+             * Add one value; NaN is ignored.
+             */
+            void add(const FloatT value) {
+                if (std::isnan(value)) {
+                    return;
+                }
+                if (m_count == 0 || value < m_min) {
+                    m_min = value;
+                }
+                if (m_count == 0 || value > m_max) {
+                    m_max = value;
+                }
+                ++m_count;
+                m_levels[0].push_back(value);
+                if (++m_size >= m_max_size) {
+                    compress();
+                }
+            }
+
+            /**
+             * Add the values of another sketch, as if every value added to
+             * `other` had been added here.
+             *
+             * \param other A sketch with the same k.
+             */
+            void merge(const QuantileSketch& other) {
+                if (other.m_k != m_k) {
+                    throw std::invalid_argument("Sketch k values do not match");
+                }
+                if (other.m_count == 0) {
+                    return;
+                }
+                if (m_count == 0 || other.m_min < m_min) {
+                    m_min = other.m_min;
+                }
+                if (m_count == 0 || other.m_max > m_max) {
+                    m_max = other.m_max;
+                }
+                m_count += other.m_count;
+
+                while (m_levels.size() < other.m_levels.size()) {
+                    grow();
+                }
+                for (size_t level = 0; level != other.m_levels.size(); ++level) {
+                    m_levels[level].insert(
+                        m_levels[level].end(),
+                        other.m_levels[level].begin(),
+                        other.m_levels[level].end());
+                }
+                m_size += other.m_size;
+                while (m_size >= m_max_size) {
+                    compress();
+                }
+            }
+
+            /**
+             * \return Number of non-NaN values added, including merged ones.
+             */
+            size_t count() const {
+                return m_count;
+            }
+
+            /**
+             * \return Number of values kept, which bounds the memory used.
+             */
+            size_t size() const {
+                return m_size;
+            }
+
+            /**
+             * \return The accuracy parameter.
+             */
+            size_t k() const {
+                return m_k;
+            }
+
+            /**
+             * \return The smallest value added, or NaN if there are none.
+             */
+            FloatT min() const {
+                return (
+                    m_count > 0 ?
+                    m_min : std::numeric_limits<FloatT>::quiet_NaN());
+            }
+
+            /**
+             * \return The largest value added, or NaN if there are none.
+             */
+            FloatT max() const {
+                return (
+                    m_count > 0 ?
+                    m_max : std::numeric_limits<FloatT>::quiet_NaN());
+            }
+
+            /**
+             * Estimate a quantile.
+             *
+             * \param q The fraction of values to be at or below the result,
+             * in `[0, 1]`.
+             * \return The smallest kept value with at least `q * count()`
+             * values estimated at or below it; min() for `q = 0`, max() for
+             * `q = 1` and NaN if the sketch is empty.
+             */
+            FloatT quantile(const double q) const {
+                if (!(q >= 0 && q <= 1)) {
+                    throw std::invalid_argument("Quantile must be in [0, 1]");
+                }
+                if (m_count == 0) {
+                    return std::numeric_limits<FloatT>::quiet_NaN();
+                }
+                if (q == 0) {
+                    return m_min;
+                }
+                if (q == 1) {
+                    return m_max;
+                }
+                const auto ranked = weighted_values();
+                const double target = q * m_count;
+                for (const auto& entry : ranked) {
+                    if (entry.second >= target) {
+                        return entry.first;
+                    }
+                }
+                return m_max;
+            }
+
+            /**
+             * Choose split candidates: the upper edges of at most
+             * `max_cuts` bins of about equal count.
+             *
+             * If the sketch keeps no more than `max_cuts` distinct values,
+             * every one of them is a cut; otherwise the cuts are the values
+             * at ranks `count() * b / max_cuts` for `b` in `[1, max_cuts]`.
+             * The last cut is always max(), so every value added falls at
+             * or below some cut.  Before the first compaction these are
+             * the edges BinnedMatrix finds by sorting the whole column.
+             *
+             * \param max_cuts Max number of cuts; must be at least 1.
+             * \return Distinct values in ascending order; empty if the
+             * sketch is empty.
+             */
+            std::vector<FloatT> cuts(const size_t max_cuts) const {
+                if (max_cuts == 0) {
+                    throw std::invalid_argument("Must allow at least one cut");
+                }
+                std::vector<FloatT> result;
+                if (m_count == 0) {
+                    return result;
+                }
+                auto ranked = weighted_values();
+                if (ranked.back().first < m_max) {
+                    // the largest value was compacted away
+                    ranked.emplace_back(m_max, ranked.back().second);
+                }
+
+                if (ranked.size() <= max_cuts) {
+                    for (const auto& entry : ranked) {
+                        result.push_back(entry.first);
+                    }
+                    return result;
+                }
+
+                size_t entry = 0;
+                for (size_t bin = 1; bin < max_cuts; ++bin) {
+                    // last value of the bin-th equal-count slice
+                    const auto rank = (bin * m_count) / max_cuts;
+                    if (rank == 0) {
+                        continue;
+                    }
+                    while (ranked[entry].second < rank) {
+                        ++entry;
+                    }
+                    if (result.empty() || result.back() < ranked[entry].first) {
+                        result.push_back(ranked[entry].first);
+                    }
+                }
+                if (result.empty() || result.back() < m_max) {
+                    result.push_back(m_max);
+                }
+                return result;
+            }
+
+        private:
+            // capacities shrink by this factor per level below the top
+            static constexpr double level_shrink = 2.0 / 3.0;
+
+            size_t m_k = default_sketch_k;
+            uint64_t m_rand_state = 1;
+            size_t m_count = 0;
+            size_t m_size = 0;
+            size_t m_max_size = 0;
+            FloatT m_min = 0;
+            FloatT m_max = 0;
+            // level h holds values of weight 2^h
+            std::vector<std::vector<FloatT>> m_levels;
+
+            size_t capacity(const size_t level) const {
+                const auto depth = m_levels.size() - level - 1;
+                const auto cap = std::ceil(std::pow(level_shrink, depth) * m_k);
+                return std::max<size_t>(2, static_cast<size_t>(cap));
+            }
+
+            void grow() {
+                m_levels.emplace_back();
+                m_max_size = 0;
+                for (size_t level = 0; level != m_levels.size(); ++level) {
+                    m_max_size += capacity(level);
+                }
+            }
+
+            /**
+             * \return One random bit (xorshift64).
+             */
+            size_t random_bit() {
+                m_rand_state ^= m_rand_state << 13;
+                m_rand_state ^= m_rand_state >> 7;
+                m_rand_state ^= m_rand_state << 17;
+                return m_rand_state >> 63;
+            }
+
+            /**
+             * Compact the lowest level that is at capacity: sort it and
+             * move every other value up a level.  An odd value out, the
+             * smallest, stays behind.
+             */
+            void compress() {
+                for (size_t level = 0; level != m_levels.size(); ++level) {
+                    if (m_levels[level].size() < capacity(level)) {
+                        continue;
+                    }
+                    if (level + 1 == m_levels.size()) {
+                        grow();
+                    }
+                    std::vector<FloatT>& values = m_levels[level];
+                    std::vector<FloatT>& above = m_levels[level + 1];
+                    std::sort(values.begin(), values.end());
+
+                    const auto nvalues = values.size();
+                    const auto kept = nvalues % 2;
+                    for (auto k = kept + random_bit(); k < nvalues; k += 2) {
+                        above.push_back(values[k]);
+                    }
+                    values.resize(kept);
+                    m_size -= (nvalues - kept) / 2;
+                    return;
+                }
+            }
+
+            /**
+             * \return Every distinct kept value in ascending order, paired
+             * with the estimated number of values at or below it.
+             */
+            std::vector<std::pair<FloatT, double>> weighted_values() const {
+                std::vector<std::pair<FloatT, double>> ranked;
+                ranked.reserve(m_size);
+                double weight = 1;
+                for (const auto& values : m_levels) {
+                    for (const auto value : values) {
+                        ranked.emplace_back(value, weight);
+                    }
+                    weight *= 2;
+                }
+                std::sort(ranked.begin(), ranked.end());
+
+                size_t ndistinct = 0;
+                double total = 0;
+                for (const auto& entry : ranked) {
+                    total += entry.second;
+                    if (ndistinct > 0 && ranked[ndistinct - 1].first == entry.first) {
+                        ranked[ndistinct - 1].second = total;
+                    } else {
+                        ranked[ndistinct++] = std::make_pair(entry.first, total);
+                    }
+                }
+                ranked.resize(ndistinct);
+                return ranked;
+            }
+    };
+
+    template <typename FloatT>
+    constexpr double QuantileSketch<FloatT>::level_shrink;
+
+    /**
+     * Minimum number of rows in each part of a column that
+     * sketch_columns() sketches separately.
+     */
+    constexpr size_t sketch_part_rows = 1 << 16;
+
+    /**
+     * Max number of parts sketch_columns() splits a column into.  Fixed,
+     * so that the sketches do not depend on the number of threads.
+     */
+    constexpr size_t max_sketch_parts = 8;
+
+    /**
+     * Sketch every column of a feature matrix in one pass.
+     *
+     * Long columns are cut into up to max_sketch_parts contiguous parts of
+     * at least sketch_part_rows rows, each part is sketched as a separate
+     * task, and the parts of each column are merged in order.  The result
+     * does not depend on the thread count.
+     *
+     * \param xs The feature matrix to sketch.
+     * \param k Accuracy parameter of every sketch.
+     * \param pool Threads to sketch with, or null to sketch on the calling
+     * thread.
+     * \return One sketch per column of `xs`.
+     */
+    template <typename FloatT>
+    std::vector<QuantileSketch<FloatT>> sketch_columns(
+            const FloatMatrix<FloatT>& xs,
+            const size_t k,
+            ThreadPool* pool = nullptr) {
+        const auto nrows = xs.nrow();
+        const auto ncols = xs.ncol();
+        const auto nparts = std::max<size_t>(
+            1, std::min(max_sketch_parts, nrows / sketch_part_rows));
+
+        std::vector<QuantileSketch<FloatT>> parts;
+        parts.reserve(ncols * nparts);
+        for (size_t task = 0; task != ncols * nparts; ++task) {
+            parts.emplace_back(k, task);
+        }
+        parallel_for(
+            pool,
+            ncols * nparts,
+            [&](const size_t task) {
+                const auto col = task / nparts;
+                const auto part = task % nparts;
+                const FloatT* const values = xs.col_data(col);
+                const auto last = ((part + 1) * nrows) / nparts;
+                for (size_t row = (part * nrows) / nparts; row != last; ++row) {
+                    parts[task].add(values[row]);
+                }
+            });
+
+        std::vector<QuantileSketch<FloatT>> sketches;
+        sketches.reserve(ncols);
+        for (size_t col = 0; col != ncols; ++col) {
+            sketches.push_back(std::move(parts[col * nparts]));
+            for (size_t part = 1; part != nparts; ++part) {
+                sketches.back().merge(parts[col * nparts + part]);
+            }
+        }
+        return sketches;
+    }
+}
+#endif //KMBNW_ODVB_QUANTILE_SKETCH_H
@@ -21,6 +21,10 @@ using DoubleVector = std::vector<double>;
 //' @param ys NumericVector for response variable
 //' @param nrounds Number of rounds of boosting
 //' @param seed Random seed to initialize boosting with
+//' @param nthreads Number of threads to fit trees with; 0 means one per
+//' core.  The result does not depend on the number of threads.
+//' @details A double matrix of features is used in place rather than
+//' copied.  The run can be interrupted between rounds of boosting.
 //' @return Normalized counts of training instances chosen for all rounds of
 //' boosting.  The largest relative value(s) are the potential outliers.
 //' For example, if the return value is \code{c(0.3, 2.3, 0.5, 6.4)}, then
@@ -69,13 +73,20 @@ NumericVector FindOutlierWeights(
         const NumericMatrix& xs,
         const NumericVector& ys,
         const size_t nrounds,
-        const size_t seed = 1480561820L) {
+        const size_t seed = 1480561820L,
+        const size_t nthreads = 1) {
 
-    oddvibe::Booster booster(seed);
+    oddvibe::TreeParams params;
+    params.nthreads = nthreads;
+    oddvibe::Booster booster(seed, params);
 
-    // move construct a Dataset
+    // throws out of fit_counts if the user interrupted R
+    booster.set_round_callback(
+        [](const size_t) { Rcpp::checkUserInterrupt(); });
+
+    // view R's column-major matrix rather than copying it
     const oddvibe::Dataset<double> data(
-        DoubleMatrix(xs.ncol(), Rcpp::as<DoubleVector>(xs)),
+        DoubleMatrix::view(xs.nrow(), xs.ncol(), REAL(xs)),
         Rcpp::as<DoubleVector>(ys));
 
     const auto result = booster.fit_counts(data, nrounds);
@@ -0,0 +1,128 @@
+/*
+ * Copyright 2017 Krysta M Bouzek
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cmath>
+#include <limits>
+#include <algorithm>
+#include <sstream>
+#include "round_stats.h"
+
+namespace oddvibe {
+    namespace {
+        void write_number(std::ostream& out, const double value) {
+            if (std::isfinite(value)) {
+                out << value;
+            } else {
+                out << "null";
+            }
+        }
+
+        void write_stats(
+                std::ostream& out,
+                const RoundStats& stats,
+                const char* indent) {
+            out << "{\n";
+            out << indent << "  \"round\": " << stats.round << ",\n";
+            out << indent << "  \"sample_seconds\": ";
+            write_number(out, stats.sample_seconds);
+            out << ",\n" << indent << "  \"fit_seconds\": ";
+            write_number(out, stats.fit_seconds);
+            out << ",\n" << indent << "  \"split_seconds\": ";
+            write_number(out, stats.split_seconds);
+            out << ",\n" << indent << "  \"flatten_seconds\": ";
+            write_number(out, stats.flatten_seconds);
+            out << ",\n" << indent << "  \"predict_seconds\": ";
+            write_number(out, stats.predict_seconds);
+            out << ",\n" << indent << "  \"reweight_seconds\": ";
+            write_number(out, stats.reweight_seconds);
+            out << ",\n" << indent << "  \"nnodes\": " << stats.nnodes;
+            out << ",\n" << indent << "  \"depth\": " << stats.depth;
+            out << ",\n" << indent << "  \"split_candidates\": "
+                << stats.split_candidates;
+            out << ",\n" << indent << "  \"epsilon\": ";
+            write_number(out, stats.update.epsilon);
+            out << ",\n" << indent << "  \"max_loss\": ";
+            write_number(out, stats.update.max_loss);
+            out << ",\n" << indent << "  \"beta\": ";
+            write_number(out, stats.update.beta);
+            out << ",\n" << indent << "  \"reset\": "
+                << (stats.update.reset ? "true" : "false");
+            out << "\n" << indent << "}";
+        }
+    }
+
+    void RoundStatsCollector::on_round(const RoundStats& stats) {
+        m_rounds.push_back(stats);
+    }
+
+    const std::vector<RoundStats>& RoundStatsCollector::rounds() const {
+        return m_rounds;
+    }
+
+    RoundStats RoundStatsCollector::totals() const {
+        RoundStats total;
+        for (const auto& stats : m_rounds) {
+            total.sample_seconds += stats.sample_seconds;
+            total.fit_seconds += stats.fit_seconds;
+            total.split_seconds += stats.split_seconds;
+            total.flatten_seconds += stats.flatten_seconds;
+            total.predict_seconds += stats.predict_seconds;
+            total.reweight_seconds += stats.reweight_seconds;
+            total.nnodes += stats.nnodes;
+            total.depth = std::max(total.depth, stats.depth);
+            total.split_candidates += stats.split_candidates;
+            total.update = stats.update;
+        }
+        total.round = m_rounds.size();
+        return total;
+    }
+
+    size_t RoundStatsCollector::nresets() const {
+        size_t count = 0;
+        for (const auto& stats : m_rounds) {
+            count += stats.update.reset;
+        }
+        return count;
+    }
+
+    void RoundStatsCollector::clear() {
+        m_rounds.clear();
+    }
+
+    void RoundStatsCollector::write_json(std::ostream& out) const {
+        const auto old_precision = out.precision(
+            std::numeric_limits<double>::max_digits10);
+
+        out << "{\n  \"nrounds\": " << m_rounds.size()
+            << ",\n  \"nresets\": " << nresets()
+            << ",\n  \"totals\": ";
+        write_stats(out, totals(), "  ");
+        out << ",\n  \"rounds\": [";
+        for (size_t k = 0; k != m_rounds.size(); ++k) {
+            out << (k == 0 ? "\n    " : ",\n    ");
+            write_stats(out, m_rounds[k], "    ");
+        }
+        out << (m_rounds.empty() ? "]" : "\n  ]") << "\n}\n";
+
+        out.precision(old_precision);
+    }
+
+    std::string RoundStatsCollector::json() const {
+        std::ostringstream out;
+        write_json(out);
+        return out.str();
+    }
+}
@@ -0,0 +1,244 @@
+/*
+ * Copyright 2017 Krysta M Bouzek
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef KMBNW_ODVB_ROUND_STATS_H
+#define KMBNW_ODVB_ROUND_STATS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <atomic>
+#include <chrono>
+#include <vector>
+#include <string>
+#include <ostream>
+
+/*! \file */
+
+namespace oddvibe {
+    /**
+     * How the sampling distribution changed at the end of a round.
+     * \sa SamplingDist::adjust_for_loss
+     */
+    struct LossUpdate {
+        /**
+         * The pmf-weighted loss of the round's tree.
+         */
+        double epsilon = 0;
+
+        /**
+         * The largest loss of any row.
+         */
+        double max_loss = 0;
+
+        /**
+         * `epsilon / (max_loss - epsilon)`; rows are reweighted by powers
+         * of it.
+         */
+        double beta = 0;
+
+        /**
+         * True if the tree was too poor (`epsilon >= max_loss / 2`) and
+         * the distribution went back to uniform.
+         */
+        bool reset = false;
+    };
+
+    /**
+     * Thread-safe tally of the split searches of one or more trees.
+     * \sa RTree::Trainer
+     */
+    class SplitSearchStats {
+        public:
+            SplitSearchStats() = default;
+
+            SplitSearchStats(const SplitSearchStats& other) = delete;
+            SplitSearchStats& operator=(const SplitSearchStats& other) = delete;
+
+            /**
+             * Record one split search.
+             *
+             * \param ncandidates Number of (feature, value) positions it
+             * scanned.
+             * \param elapsed How long it took.
+             */
+            void add(
+                    const size_t ncandidates,
+                    const std::chrono::steady_clock::duration elapsed) {
+                m_candidates += ncandidates;
+                m_nanos += std::chrono::duration_cast<
+                    std::chrono::nanoseconds>(elapsed).count();
+            }
+
+            /**
+             * Start a new tally.
+             */
+            void clear() {
+                m_candidates = 0;
+                m_nanos = 0;
+            }
+
+            /**
+             * \return Number of (feature, value) positions scanned.
+             */
+            size_t candidates() const {
+                return m_candidates;
+            }
+
+            /**
+             * \return Time spent searching, summed over threads.
+             */
+            double seconds() const {
+                return m_nanos * 1e-9;
+            }
+
+        private:
+            std::atomic<size_t> m_candidates{0};
+            std::atomic<uint64_t> m_nanos{0};
+    };
+
+    /**
+     * Measurements of a single round of boosting.
+     *
+     * The phases run one after another, so their times add up to about
+     * the time of the round, except that `split_seconds` is part of
+     * `fit_seconds` and is summed over every thread that searched.
+     */
+    struct RoundStats {
+        /**
+         * The round, starting at one.
+         */
+        size_t round = 0;
+
+        /**
+         * Time to draw the round's rows from the sampling distribution
+         * and tally them.
+         */
+        double sample_seconds = 0;
+
+        /**
+         * Time to fit the round's tree, including split search.
+         */
+        double fit_seconds = 0;
+
+        /**
+         * Time spent in split search while fitting, summed over threads.
+         */
+        double split_seconds = 0;
+
+        /**
+         * Time to copy the tree into its flat form for prediction.
+         */
+        double flatten_seconds = 0;
+
+        /**
+         * Time to predict every row and compute its loss.
+         */
+        double predict_seconds = 0;
+
+        /**
+         * Time to reweight the sampling distribution.
+         */
+        double reweight_seconds = 0;
+
+        /**
+         * Number of nodes (interior and leaf) of the tree.
+         */
+        size_t nnodes = 0;
+
+        /**
+         * Number of levels of the tree below the root.
+         */
+        size_t depth = 0;
+
+        /**
+         * Number of (feature, value) positions that split search scanned:
+         * rows times features of each node for exact search, and bins of
+         * every feature of each node for histogram search.
+         */
+        size_t split_candidates = 0;
+
+        /**
+         * The change made to the sampling distribution.
+         */
+        LossUpdate update;
+    };
+
+    /**
+     * Receives measurements of every round of boosting.
+     * \sa Booster::set_observer
+     */
+    class RoundObserver {
+        public:
+            virtual ~RoundObserver() = default;
+
+            /**
+             * Called after each round, on the thread that runs the fit.
+             *
+             * \param stats Measurements of the round.
+             */
+            virtual void on_round(const RoundStats& stats) = 0;
+    };
+
+    /**
+     * RoundObserver that keeps every round and writes them as JSON.
+     */
+    class RoundStatsCollector : public RoundObserver {
+        public:
+            RoundStatsCollector() = default;
+
+            void on_round(const RoundStats& stats) override;
+
+            /**
+             * \return Every round received, in order.
+             */
+            const std::vector<RoundStats>& rounds() const;
+
+            /**
+             * \return Sums over every round received, except that `round`
+             * is the number of rounds, `depth` is the deepest tree and
+             * `update` is that of the last round.
+             */
+            RoundStats totals() const;
+
+            /**
+             * \return Number of rounds that reset the distribution.
+             */
+            size_t nresets() const;
+
+            /**
+             * Forget every round received.
+             */
+            void clear();
+
+            /**
+             * Write the totals and every round as a JSON object.
+             * Non-finite numbers (e.g. `beta` when every loss is zero) are
+             * written as null.
+             *
+             * \param out Stream to write to.
+             */
+            void write_json(std::ostream& out) const;
+
+            /**
+             * \return The output of write_json() as a string.
+             */
+            std::string json() const;
+
+        private:
+            std::vector<RoundStats> m_rounds;
+    };
+}
+#endif //KMBNW_ODVB_ROUND_STATS_H
@@ -0,0 +1,176 @@
+/*
+ * Copyright 2017 Krysta M Bouzek
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef KMBNW_ODVB_ROUND_UPDATE_H
+#define KMBNW_ODVB_ROUND_UPDATE_H
+
+#include <cstddef>
+#include <chrono>
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+#include "math_x.h"
+#include "dataset.h"
+#include "flat_tree.h"
+#include "predictor.h"
+#include "thread_pool.h"
+#include "sampling_dist.h"
+#include "simd_kernels.h"
+#include "round_stats.h"
+
+/*! \file */
+
+namespace oddvibe {
+    /**
+     * Rows per block of the first pass of RoundUpdate; a multiple of
+     * simd_lanes so that the blocked sums match whole-vector sums.
+     */
+    constexpr size_t round_block_rows = 4096;
+
+    static_assert(
+        round_block_rows % simd_lanes == 0,
+        "Round blocks must hold whole sets of sum lanes");
+
+    /**
+     * End-of-round update of the sampling distribution, fused into two
+     * passes over preallocated buffers.
+     *
+     * The first pass walks the rows in blocks small enough to stay in
+     * cache: each block is predicted, its loss is stored, and the max loss
+     * and the pmf-weighted loss are accumulated.  The second pass
+     * reweights the distribution and sums it at the same time, leaving only
+     * the division by that sum.  Given a pool of threads the blocks of the
+     * first pass are predicted in parallel and the pmf-weighted loss is
+     * summed after them in row order.  The result is bit-identical to
+     * `pmf.adjust_for_loss(loss_seq(ys, tree.predict(xs)))`.
+     */
+    template <typename FloatT>
+    class RoundUpdate {
+        public:
+            /**
+             * Allocate buffers for a dataset.
+             *
+             * \param nrows Number of rows of the dataset to be updated.
+             * \param pool Threads to predict blocks of rows on; null to
+             * predict on the calling thread only.
+             */
+            explicit RoundUpdate(
+                    const size_t nrows,
+                    ThreadPool* pool = nullptr) :
+                m_loss(nrows),
+                m_block_max((nrows + round_block_rows - 1) / round_block_rows),
+                m_predictor(pool, round_block_rows) { }
+
+            RoundUpdate(RoundUpdate&& other) = default;
+            RoundUpdate& operator=(RoundUpdate&& other) = default;
+
+            RoundUpdate(const RoundUpdate& other) = delete;
+            RoundUpdate& operator=(const RoundUpdate& other) = delete;
+
+            ~RoundUpdate() = default;
+
+            /**
+             * Update `pmf` for the loss of `tree` on every row of `data`.
+             *
+             * \param tree The tree fitted this round; a FlatTree or an
+             * ObliviousTree.
+             * \param data The dataset being boosted.
+             * \param pmf The sampling distribution to update; must have one
+             * entry per row of `data`.
+             * \param stats If not null, the time of each pass is stored in
+             * its `predict_seconds` and `reweight_seconds`.
+             * \return How the distribution changed.
+             */
+            template <typename TreeT>
+            LossUpdate apply(
+                    const TreeT& tree,
+                    const Dataset<FloatT>& data,
+                    SamplingDist& pmf,
+                    RoundStats* stats = nullptr) {
+                typedef std::chrono::steady_clock clock;
+                const auto nrows = data.nrow();
+                if (nrows != m_loss.size() || nrows != pmf.weights().size()) {
+                    throw std::invalid_argument(
+                        "RoundUpdate size does not match data");
+                }
+
+                const auto& kernels = simd_kernels();
+                const FloatT* ys = data.ys().data();
+                const float* weights = pmf.weights().data();
+                double* loss = m_loss.data();
+
+                clock::time_point start;
+                if (stats != nullptr) {
+                    start = clock::now();
+                }
+
+                // blocks may finish in any order when predicted in
+                // parallel, so the weighted sum waits until they are done
+                const bool fused = !m_predictor.is_parallel();
+                double lanes[simd_lanes] = { 0 };
+                m_predictor.for_each_block(tree, data.xs(), [&](
+                        const size_t first,
+                        const size_t count,
+                        const FloatT* yhats) {
+                    squared_errors(ys + first, yhats, loss + first, count);
+                    m_block_max[first / round_block_rows] = kernels.max_value(
+                        loss + first, count);
+                    if (fused) {
+                        kernels.dot_lanes(weights + first, loss + first, count, lanes);
+                    }
+                });
+                if (!fused) {
+                    kernels.dot_lanes(weights, loss, nrows, lanes);
+                }
+
+                double max_loss = 0;
+                for (size_t block = 0; block != m_block_max.size(); ++block) {
+                    max_loss = (
+                        block == 0 ? m_block_max[block]
+                        : std::max(max_loss, m_block_max[block]));
+                }
+
+                if (stats == nullptr) {
+                    return pmf.adjust_for_loss(
+                        m_loss, max_loss, simd_lane_total(lanes));
+                }
+
+                const auto predicted = clock::now();
+                const auto update = pmf.adjust_for_loss(
+                    m_loss, max_loss, simd_lane_total(lanes));
+                const std::chrono::duration<double> predict_time = (
+                    predicted - start);
+                const std::chrono::duration<double> reweight_time = (
+                    clock::now() - predicted);
+                stats->predict_seconds = predict_time.count();
+                stats->reweight_seconds = reweight_time.count();
+                return update;
+            }
+
+            /**
+             * \return The loss of each row from the last call to apply().
+             */
+            const std::vector<double>& loss() const {
+                return m_loss;
+            }
+
+        private:
+            std::vector<double> m_loss;
+            std::vector<double> m_block_max;
+            BlockPredictor<FloatT> m_predictor;
+    };
+}
+#endif //KMBNW_ODVB_ROUND_UPDATE_H
@@ -21,20 +21,32 @@
 #include <memory>
 #include <cmath>
 #include <limits>
-#include <future>
+#include <mutex>
+#include <chrono>
+#include "params.h"
 #include "split_point.h"
+#include "histogram.h"
+#include "column_sample.h"
+#include "thread_pool.h"
+#include "round_stats.h"
 
 /*! \file */
 
 namespace oddvibe {
 
+    template <typename FloatT>
+    class FlatTree;
+
     /**
      * Regression decision tree
+     * \sa FlatTree
      */
     template <typename FloatT>
     class RTree {
         public:
             class Trainer;
+            class Workspace;
+            friend class FlatTree<FloatT>;
 
             RTree<FloatT>(RTree<FloatT>&& other) = default;
             RTree<FloatT>& operator=(RTree<FloatT>&& other) = default;
@@ -147,7 +159,34 @@ namespace oddvibe {
              *
              * \param max_depth The max depth/height of the fitted tree.
              */
-            Trainer(const size_t max_depth) : m_max_depth(max_depth) {}
+            Trainer(const size_t max_depth) {
+                m_params.max_depth = max_depth;
+            }
+
+            /**
+             * Create a new RTree Trainer.
+             *
+             * \param params Tree depth and split search settings.
+             * \param pool Threads to search for splits and fit subtrees
+             * with, or null to fit on the calling thread only.
+             * TreeParams::nthreads is not used by the Trainer; it is up to
+             * the owner of the pool.  The fitted tree does not depend on the
+             * number of threads.
+             * \param workspace Nodes and scratch space to fit with, or null
+             * to allocate them for every tree.  It must outlive the Trainer
+             * and be used by only one fit at a time.
+             * \param stats If not null, every split search is timed and
+             * tallied here.  It must outlive the Trainer.
+             */
+            explicit Trainer(
+                    const TreeParams& params,
+                    ThreadPool* pool = nullptr,
+                    Workspace* workspace = nullptr,
+                    SplitSearchStats* stats = nullptr) :
+                m_params(params),
+                m_pool(pool),
+                m_workspace(workspace),
+                m_stats(stats) {}
 
             Trainer(Trainer&& other) = delete;
             Trainer& operator=(Trainer&& other) = delete;
@@ -169,6 +208,9 @@ namespace oddvibe {
              * feature, and when depth has not exceeded the max depth of this
              * Trainer).
              *
+             * With SplitMethod::histogram only the bin edges of
+             * Dataset::bins() are considered as split values.
+             *
              * The elements from the range `[first, last]` are used to filter
              * the input data; they are row indices into the Dataset xs() and
              * ys() values that will be used for fitting.  On each left/right
@@ -182,6 +224,9 @@ namespace oddvibe {
              * \param depth The tree height at which the resulting RTree node
              * resides (used to limit tree height).  Each left/right call of
              * fit() will have its depth incremented by one.
+             * \param seed Random seed for drawing the columns of the tree
+             * and of each node when TreeParams::tree_col_fraction or
+             * TreeParams::node_col_fraction is below one.
              * \return A pointer to the RTree (node) at this level; the very
              * first call of fit() will return a pointer to the root of the tree.
              */
@@ -190,58 +235,666 @@ namespace oddvibe {
                     const Dataset<FloatT>& data,
                     const BidirectionalIterator first,
                     const BidirectionalIterator last,
-                    const size_t depth) const {
+                    const size_t depth,
+                    const size_t seed = 0) const {
+                return fit_weighted(
+                    data, UnitWeights(), first, last, depth, seed);
+            }
+
+            /**
+             * Fit an RTree to weighted rows.
+             *
+             * Each row in `[first, last]` contributes to node predictions
+             * and split errors in proportion to its weight, so a row listed
+             * once with weight `k` fits the same tree (up to rounding) as
+             * the same row listed `k` times with fit().  Work per node is
+             * proportional to the number of rows listed rather than to their
+             * total weight.
+             *
+             * \param data Feature matrix and response vector to fit.
+             * \param weights Weight of each row of `data`, indexed by row;
+             * must have `data.nrow()` elements.  The weights of the rows to
+             * fit must be positive.
+             * \param first BidirectionalIterator to the initial position of
+             * the row indexes, usually each listed once.
+             * \param last BidirectionalIterator to the final position of
+             * the row indexes.
+             * \param depth The tree height at which the resulting RTree node
+             * resides.
+             * \param seed Random seed for drawing columns.
+             * \return A pointer to the root of the fitted RTree.
+             * \sa fit()
+             */
+            template <typename BidirectionalIterator>
+            std::unique_ptr<RTree<FloatT>> fit(
+                    const Dataset<FloatT>& data,
+                    const std::vector<double>& weights,
+                    const BidirectionalIterator first,
+                    const BidirectionalIterator last,
+                    const size_t depth,
+                    const size_t seed = 0) const {
+                if (weights.size() != data.nrow()) {
+                    throw std::invalid_argument(
+                        "Must have one weight per row of data");
+                }
+                return fit_weighted(data, weights, first, last, depth, seed);
+            }
+
+            /**
+             * Fit an RTree to a quantized feature matrix alone.
+             *
+             * Uses histogram split search regardless of
+             * TreeParams::split_method, and partitions rows by bin code, so
+             * the FloatMatrix the bins were built from need not be kept in
+             * memory.  Split values are bin edges (see BinnedMatrix::edge()),
+             * so the fitted tree predicts on raw feature values directly and
+             * matches the tree fitted by fit() with SplitMethod::histogram
+             * on the same bins.
+             *
+             * \param bins Quantized feature matrix.
+             * \param ys Response vector, one value per row of `bins`.
+             * \param first BidirectionalIterator to the initial position of
+             * the row indexes.
+             * \param last BidirectionalIterator to the final position of
+             * the row indexes.
+             * \param depth The tree height at which the resulting RTree node
+             * resides.
+             * \param seed Random seed for drawing columns.
+             * \return A pointer to the root of the fitted RTree.
+             */
+            template <typename BidirectionalIterator>
+            std::unique_ptr<RTree<FloatT>> fit(
+                    const BinnedMatrix<FloatT>& bins,
+                    const std::vector<FloatT>& ys,
+                    const BidirectionalIterator first,
+                    const BidirectionalIterator last,
+                    const size_t depth,
+                    const size_t seed = 0) const {
+                if (bins.nrow() != ys.size()) {
+                    throw std::logic_error("X and Y row counts do not match");
+                }
                 if (first == last) {
                     throw std::invalid_argument("Must have at least one entry");
                 }
+                return fit_binned(
+                    bins, ys, UnitWeights(), first, last, depth, seed);
+            }
 
-                const FloatMatrix<FloatT>& xs = data.xs();
-                const std::vector<FloatT>& ys = data.ys();
-                const auto yhat = mean<FloatT>(ys, first, last);
+        private:
+            TreeParams m_params;
+            ThreadPool* m_pool = nullptr;
+            Workspace* m_workspace = nullptr;
+            SplitSearchStats* m_stats = nullptr;
+
+            /**
+             * The columns drawn for the tree being fitted.
+             */
+            struct ColumnDraw {
+                // ascending, or null if the tree may split on every column
+                const std::vector<size_t>* columns = nullptr;
+                size_t ncols = 0;
+                size_t seed = 0;
+            };
+
+            /**
+             * Draw the columns of a tree.
+             *
+             * \param ncols Number of feature columns.
+             * \param seed Random seed of the tree.
+             * \param storage Storage for the drawn columns.
+             */
+            ColumnDraw draw_columns(
+                    const size_t ncols,
+                    const size_t seed,
+                    std::vector<size_t>& storage) const {
+                check_col_fractions(m_params);
+                const auto tree_fraction = m_params.tree_col_fraction;
+
+                ColumnDraw draw;
+                draw.ncols = sampled_count(ncols, tree_fraction);
+                draw.seed = seed;
+                if (draw.ncols != ncols) {
+                    // stream zero; nodes are numbered from one
+                    sample_columns(ncols, tree_fraction, seed, 0, storage);
+                    draw.columns = &storage;
+                }
+                return draw;
+            }
+
+            /**
+             * Draw the columns searched for the split of a node.
+             *
+             * \param node Number of the node: one for the root, and
+             * `2 * node` and `2 * node + 1` for its children, so the draw
+             * does not depend on the order nodes are fitted in.
+             * \param scratch Holds the drawn columns.
+             * \return The drawn columns, or `draw.columns` if every column
+             * of the tree is searched.
+             */
+            const std::vector<size_t>* node_columns(
+                    const ColumnDraw& draw,
+                    const size_t node,
+                    SplitScratch<FloatT>& scratch) const {
+                if (m_params.node_col_fraction == 1.0) {
+                    return draw.columns;
+                }
+                std::vector<size_t>& drawn = scratch.columns;
+                sample_columns(
+                    draw.ncols, m_params.node_col_fraction, draw.seed, node,
+                    drawn);
+                if (draw.columns != nullptr) {
+                    for (auto& col : drawn) {
+                        col = (*draw.columns)[col];
+                    }
+                }
+                return &drawn;
+            }
+
+            /**
+             * Run a split search, recording it in the stats if there are
+             * any.
+             *
+             * \param ncandidates Number of (feature, value) positions the
+             * search scans.
+             * \param search Returns the best SplitPoint.
+             */
+            template <typename SearchFn>
+            SplitPoint<FloatT> search_split(
+                    const size_t ncandidates,
+                    const SearchFn& search) const {
+                if (m_stats == nullptr) {
+                    return search();
+                }
+                const auto start = std::chrono::steady_clock::now();
+                const auto split = search();
+                m_stats->add(
+                    ncandidates, std::chrono::steady_clock::now() - start);
+                return split;
+            }
+
+            /**
+             * \return A node holding `contents`, taken from the workspace
+             * if there is one.
+             */
+            std::unique_ptr<RTree<FloatT>> make_node(
+                    RTree<FloatT>&& contents) const {
+                if (m_workspace != nullptr) {
+                    return m_workspace->make_node(std::move(contents));
+                }
+                return std::unique_ptr<RTree<FloatT>>(
+                    new RTree<FloatT>(std::move(contents)));
+            }
+
+            /**
+             * \return An empty histogram with `nslots` slots, taken from the
+             * workspace if there is one.
+             */
+            Histogram take_histogram(const size_t nslots) const {
+                if (m_workspace != nullptr) {
+                    return m_workspace->take_histogram(nslots);
+                }
+                return Histogram(nslots);
+            }
+
+            /**
+             * Hand a histogram from take_histogram() back for reuse.
+             */
+            void give_back(Histogram& hist) const {
+                if (m_workspace != nullptr) {
+                    m_workspace->give_back(hist);
+                }
+            }
+
+            /**
+             * \return Split search scratch space, taken from the workspace
+             * if there is one.
+             */
+            SplitScratch<FloatT> take_scratch() const {
+                if (m_workspace != nullptr) {
+                    return m_workspace->take_scratch();
+                }
+                return SplitScratch<FloatT>();
+            }
+
+            /**
+             * Hand scratch space from take_scratch() back for reuse.
+             */
+            void give_back(SplitScratch<FloatT>& scratch) const {
+                if (m_workspace != nullptr) {
+                    m_workspace->give_back(scratch);
+                }
+            }
+
+            /**
+             * Fit the root node with either kind of row weights.
+             */
+            template <typename WeightsT, typename BidirectionalIterator>
+            std::unique_ptr<RTree<FloatT>> fit_weighted(
+                    const Dataset<FloatT>& data,
+                    const WeightsT& weights,
+                    const BidirectionalIterator first,
+                    const BidirectionalIterator last,
+                    const size_t depth,
+                    const size_t seed) const {
+                if (first == last) {
+                    throw std::invalid_argument("Must have at least one entry");
+                }
+
+                if (m_params.split_method == SplitMethod::histogram) {
+                    // held for the whole fit in case another fit replaces
+                    // the cached bins
+                    const auto bins = data.bins(
+                        m_params.max_bins, m_params.sketch_k, m_pool);
+                    return fit_binned(
+                        *bins, data.ys(), weights, first, last, depth, seed);
+                }
+
+                std::vector<size_t> own_tree_cols;
+                const auto draw = draw_columns(
+                    data.ncol(), seed,
+                    m_workspace != nullptr ?
+                    m_workspace->m_tree_cols : own_tree_cols);
+
+                // only the tree's columns are kept sorted
+                SortedColumns own_cols;
+                SortedColumns& cols = (
+                    m_workspace != nullptr ? m_workspace->m_cols : own_cols);
+                cols.assign(data.column_index(), first, last, draw.columns);
+                return fit_exact(
+                    data, weights, cols, draw, 1, 0, first, last, depth);
+            }
+
+            /**
+             * Fit the root node on bin codes.
+             */
+            template <typename WeightsT, typename BidirectionalIterator>
+            std::unique_ptr<RTree<FloatT>> fit_binned(
+                    const BinnedMatrix<FloatT>& bins,
+                    const std::vector<FloatT>& ys,
+                    const WeightsT& weights,
+                    const BidirectionalIterator first,
+                    const BidirectionalIterator last,
+                    const size_t depth,
+                    const size_t seed) const {
+                std::vector<size_t> own_tree_cols;
+                const auto draw = draw_columns(
+                    bins.ncol(), seed,
+                    m_workspace != nullptr ?
+                    m_workspace->m_tree_cols : own_tree_cols);
+
+                // only the tree's columns are summed
+                const double y_center = mean<FloatT>(ys, weights, first, last);
+                Histogram hist = take_histogram(bins.total_slots());
+                hist.add(
+                    bins, ys, y_center, first, last,
+                    pool_for(draw.ncols, std::distance(first, last)),
+                    weights, draw.columns);
+                auto tree = fit_hist(
+                    ys, weights, bins, y_center, draw, 1, first, last, depth,
+                    hist);
+                give_back(hist);
+                return tree;
+            }
+
+            /**
+             * \return The thread pool if a node with `count` rows of `ncols`
+             * features has enough work to be worth splitting up, or null
+             * otherwise.
+             */
+            ThreadPool* pool_for(const size_t ncols, const size_t count) const {
+                return (count * ncols < split_block_rows ? nullptr : m_pool);
+            }
+
+            /**
+             * Fit the two children of a node, in parallel if the node is
+             * shallow and large enough (see TreeParams::parallel_depth and
+             * TreeParams::min_parallel_rows) and serially otherwise.
+             *
+             * \param depth The depth of the parent node.
+             * \param count The number of rows in the parent node.
+             * \param fit_left Fits the left child.
+             * \param fit_right Fits the right child.
+             */
+            template <typename LeftFn, typename RightFn>
+            void fit_children(
+                    const size_t depth,
+                    const size_t count,
+                    const LeftFn& fit_left,
+                    const RightFn& fit_right) const {
+                if (m_pool == nullptr ||
+                        depth >= m_params.parallel_depth ||
+                        count < m_params.min_parallel_rows) {
+                    fit_left();
+                    fit_right();
+                } else {
+                    m_pool->parallel_for(
+                        2,
+                        [&fit_left, &fit_right](const size_t child) {
+                            if (child == 0) {
+                                fit_left();
+                            } else {
+                                fit_right();
+                            }
+                        });
+                }
+            }
+
+            /**
+             * Calculate the prediction for a node and decide whether it
+             * must be a leaf regardless of the split found.
+             */
+            template <typename WeightsT, typename BidirectionalIterator>
+            FloatT node_yhat(
+                    const std::vector<FloatT>& ys,
+                    const WeightsT& weights,
+                    const BidirectionalIterator first,
+                    const BidirectionalIterator last,
+                    const size_t depth,
+                    bool& force_leaf) const {
+                const auto yhat = mean<FloatT>(ys, weights, first, last);
                 if (std::isnan(yhat)) {
                     throw std::logic_error("Prediction is NaN");
                 }
 
-                bool force_leaf = (
-                    depth >= m_max_depth ||
-                    variance<FloatT>(ys, first, last) < 1e-6);
+                force_leaf = (
+                    depth >= m_params.max_depth ||
+                    variance<FloatT>(ys, weights, first, last) < 1e-6);
+                return yhat;
+            }
+
+            /**
+             * Fit a node whose rows are also kept sorted per column.
+             *
+             * \param cols Rows of every node, sorted per column; the
+             * segment of this node is partitioned in place for the children.
+             * \param draw The columns of the tree.
+             * \param node Number of this node; see node_columns().
+             * \param offset The start of this node's segment within `cols`.
+             */
+            template <typename WeightsT, typename BidirectionalIterator>
+            std::unique_ptr<RTree<FloatT>> fit_exact(
+                    const Dataset<FloatT>& data,
+                    const WeightsT& weights,
+                    SortedColumns& cols,
+                    const ColumnDraw& draw,
+                    const size_t node,
+                    const size_t offset,
+                    const BidirectionalIterator first,
+                    const BidirectionalIterator last,
+                    const size_t depth) const {
+                const FloatMatrix<FloatT>& xs = data.xs();
+
+                bool force_leaf = true;
+                const auto yhat = node_yhat(
+                    data.ys(), weights, first, last, depth, force_leaf);
 
                 if (!force_leaf) {
-                    const auto split = best_split(data, first, last);
+                    const size_t count = std::distance(first, last);
+                    auto scratch = take_scratch();
+                    const auto search_cols = node_columns(draw, node, scratch);
+                    const auto width = (
+                        search_cols != nullptr ?
+                        search_cols->size() : cols.ncol());
+                    const auto split = search_split(
+                        count * width,
+                        [&]() {
+                            return best_split(
+                                data, cols, offset, count, yhat, m_pool,
+                                weights, &scratch, search_cols);
+                        });
+                    give_back(scratch);
 
                     if (split.is_valid()) {
                         const auto pivot = split.partition_idx(xs, first, last);
+                        const auto nleft = cols.partition(
+                            offset,
+                            count,
+                            [&split, &xs](const size_t row) {
+                                return split.is_left(xs, row);
+                            });
+                        const auto roffset = offset + nleft;
 
+                        // the children own disjoint parts of every range;
+                        // every column of the tree is partitioned, since
+                        // they draw their own columns to search
                         const auto ndepth = depth + 1;
-                        auto left = std::async(
-                            std::launch::deferred,
-                            [this, &data, first, last, pivot, ndepth]() {
-                                return fit(data, first, pivot, ndepth);
-                            });
-                        auto right = std::async(
-                            std::launch::deferred,
-                            [this, &data, first, last, pivot, ndepth]() {
-                                return fit(data, pivot, last, ndepth);
+                        std::unique_ptr<RTree<FloatT>> ltree, rtree;
+                        fit_children(
+                            depth,
+                            count,
+                            [&]() {
+                                ltree = fit_exact(
+                                    data, weights, cols, draw, 2 * node,
+                                    offset, first, pivot, ndepth);
+                            },
+                            [&]() {
+                                rtree = fit_exact(
+                                    data, weights, cols, draw, 2 * node + 1,
+                                    roffset, pivot, last, ndepth);
                             });
+                        return make_node(RTree<FloatT>(
+                            yhat, split, std::move(ltree), std::move(rtree)));
+                    }
+                }
+                // leaf
+                return make_node(RTree<FloatT>(yhat));
+            }
+
+            /**
+             * Histogram counterpart of fit_exact(), which reads features
+             * only through their bin codes.
+             *
+             * \param draw The columns of the tree.
+             * \param node Number of this node; see node_columns().
+             * \param hist Histogram of the rows in `[first, last]`, summed
+             * over the columns of the tree.  It is
+             * overwritten with the histogram of one of the children: only
+             * the smaller child is summed from its rows, and the larger one
+             * is derived by subtracting it from the parent.
+             */
+            template <typename WeightsT, typename BidirectionalIterator>
+            std::unique_ptr<RTree<FloatT>> fit_hist(
+                    const std::vector<FloatT>& ys,
+                    const WeightsT& weights,
+                    const BinnedMatrix<FloatT>& bins,
+                    const double y_center,
+                    const ColumnDraw& draw,
+                    const size_t node,
+                    const BidirectionalIterator first,
+                    const BidirectionalIterator last,
+                    const size_t depth,
+                    Histogram& hist) const {
+                bool force_leaf = true;
+                const auto yhat = node_yhat(
+                    ys, weights, first, last, depth, force_leaf);
 
-                        // stuck on C++ 11 b/c the Debian Rcpp build forces it?
-                        // TODO I would like to fix that
-
-                        auto ltree = left.get();
-                        auto rtree = right.get();
-                        return std::unique_ptr<RTree<FloatT>>(
-                            new RTree<FloatT>(
-                                yhat,
-                                split,
-                                std::move(ltree),
-                                std::move(rtree)));
+                if (!force_leaf) {
+                    const size_t count = std::distance(first, last);
+                    auto scratch = take_scratch();
+                    const auto search_cols = node_columns(draw, node, scratch);
+                    size_t width = bins.ncol();
+                    size_t ncandidates = bins.total_slots() - bins.ncol();
+                    if (search_cols != nullptr) {
+                        width = search_cols->size();
+                        ncandidates = 0;
+                        for (const auto col : *search_cols) {
+                            ncandidates += bins.nbins(col);
+                        }
+                    }
+                    const auto split = search_split(
+                        ncandidates,
+                        [&]() {
+                            return best_split(
+                                bins, hist, pool_for(width, count), &scratch,
+                                search_cols);
+                        });
+                    give_back(scratch);
+
+                    if (split.is_valid()) {
+                        const auto pivot = split.partition_idx(bins, first, last);
+                        const size_t nleft = std::distance(first, pivot);
+                        const bool left_smaller = (nleft <= count - nleft);
+                        ThreadPool* const pool = pool_for(
+                            draw.ncols, std::min(nleft, count - nleft));
+
+                        Histogram small_hist = take_histogram(hist.size());
+                        if (left_smaller) {
+                            small_hist.add(
+                                bins, ys, y_center, first, pivot, pool,
+                                weights, draw.columns);
+                        } else {
+                            small_hist.add(
+                                bins, ys, y_center, pivot, last, pool,
+                                weights, draw.columns);
+                        }
+                        hist.subtract(small_hist);
+
+                        Histogram& left_hist = (left_smaller ? small_hist : hist);
+                        Histogram& right_hist = (left_smaller ? hist : small_hist);
+
+                        const auto ndepth = depth + 1;
+                        std::unique_ptr<RTree<FloatT>> ltree, rtree;
+                        fit_children(
+                            depth,
+                            count,
+                            [&]() {
+                                ltree = fit_hist(
+                                    ys, weights, bins, y_center, draw,
+                                    2 * node, first, pivot, ndepth,
+                                    left_hist);
+                            },
+                            [&]() {
+                                rtree = fit_hist(
+                                    ys, weights, bins, y_center, draw,
+                                    2 * node + 1, pivot, last, ndepth,
+                                    right_hist);
+                            });
+                        give_back(small_hist);
+                        return make_node(RTree<FloatT>(
+                            yhat, split, std::move(ltree), std::move(rtree)));
                     }
                 }
                 // leaf
-                return std::unique_ptr<RTree<FloatT>>(new RTree<FloatT>(yhat));
+                return make_node(RTree<FloatT>(yhat));
+            }
+    };
+
+    /**
+     * Reusable storage for fitting one RTree after another.
+     *
+     * Boosting fits a tree of about the same shape every round and throws
+     * the previous one away.  A Trainer given a Workspace takes its nodes,
+     * histograms, sorted row indexes, drawn columns and split search
+     * scratch space from here instead of the heap, and recycle() takes a
+     * finished tree's nodes back, so once the workspace has grown to the
+     * largest tree it sees, fitting allocates nothing.
+     * The nodes are ordinary heap nodes; a tree that is never recycled is
+     * freed as usual.
+     * \sa Trainer
+     */
+    template <typename FloatT>
+    class RTree<FloatT>::Workspace {
+        public:
+            Workspace() = default;
+
+            Workspace(Workspace&& other) = delete;
+            Workspace& operator=(Workspace&& other) = delete;
+
+            Workspace(const Workspace& other) = delete;
+            Workspace& operator=(const Workspace& other) = delete;
+
+            ~Workspace() = default;
+
+            /**
+             * Take the nodes of a tree that is no longer needed, to be
+             * reused by later fits.
+             *
+             * \param tree The tree to dismantle; may be null.
+             */
+            void recycle(std::unique_ptr<RTree<FloatT>> tree) {
+                if (!tree) {
+                    return;
+                }
+                std::lock_guard<std::mutex> guard(m_lock);
+                auto node = m_nodes.size();
+                m_nodes.push_back(std::move(tree));
+                for (; node != m_nodes.size(); ++node) {
+                    RTree<FloatT>& current = *m_nodes[node];
+                    if (!current.m_is_leaf) {
+                        m_nodes.push_back(std::move(current.m_left));
+                        m_nodes.push_back(std::move(current.m_right));
+                        current.m_is_leaf = true;
+                    }
+                }
             }
+
+            /**
+             * \return Number of nodes waiting to be reused.
+             */
+            size_t nfree() const {
+                std::lock_guard<std::mutex> guard(m_lock);
+                return m_nodes.size();
+            }
+
         private:
-            size_t m_max_depth;
+            friend class RTree<FloatT>::Trainer;
+
+            // guards the free lists; sibling subtrees may be fit in parallel
+            mutable std::mutex m_lock;
+            std::vector<std::unique_ptr<RTree<FloatT>>> m_nodes;
+            std::vector<Histogram> m_hists;
+            std::vector<SplitScratch<FloatT>> m_scratch;
+            SortedColumns m_cols;
+            std::vector<size_t> m_tree_cols;
+
+            std::unique_ptr<RTree<FloatT>> make_node(RTree<FloatT>&& contents) {
+                std::unique_lock<std::mutex> lock(m_lock);
+                if (m_nodes.empty()) {
+                    lock.unlock();
+                    return std::unique_ptr<RTree<FloatT>>(
+                        new RTree<FloatT>(std::move(contents)));
+                }
+                auto node = std::move(m_nodes.back());
+                m_nodes.pop_back();
+                lock.unlock();
+
+                *node = std::move(contents);
+                return node;
+            }
+
+            Histogram take_histogram(const size_t nslots) {
+                std::unique_lock<std::mutex> lock(m_lock);
+                if (m_hists.empty()) {
+                    lock.unlock();
+                    return Histogram(nslots);
+                }
+                Histogram hist = std::move(m_hists.back());
+                m_hists.pop_back();
+                lock.unlock();
+
+                hist.reset(nslots);
+                return hist;
+            }
+
+            void give_back(Histogram& hist) {
+                std::lock_guard<std::mutex> guard(m_lock);
+                m_hists.push_back(std::move(hist));
+            }
+
+            SplitScratch<FloatT> take_scratch() {
+                std::lock_guard<std::mutex> guard(m_lock);
+                if (m_scratch.empty()) {
+                    return SplitScratch<FloatT>();
+                }
+                SplitScratch<FloatT> scratch = std::move(m_scratch.back());
+                m_scratch.pop_back();
+                return scratch;
+            }
+
+            void give_back(SplitScratch<FloatT>& scratch) {
+                std::lock_guard<std::mutex> guard(m_lock);
+                m_scratch.push_back(std::move(scratch));
+            }
     };
 }
 #endif //KMBNW_ODVB_RTREE_H
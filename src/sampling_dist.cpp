@@ -14,9 +14,11 @@
  * limitations under the License.
  */
 
+#include <cmath>
 #include <algorithm>
 #include <stdexcept>
 #include "sampling_dist.h"
+#include "simd_kernels.h"
 #include "math_x.h"
 
 namespace oddvibe {
@@ -31,36 +33,60 @@ namespace oddvibe {
         std::fill(m_pmf.begin(), m_pmf.end(), 1.0 / m_pmf.size());
     }
 
-    void SamplingDist::adjust_for_loss(const std::vector<double>& loss) {
+    LossUpdate SamplingDist::adjust_for_loss(const std::vector<double>& loss) {
         if (loss.size() != m_size) {
             throw std::invalid_argument(
                 "Loss vector must be same size as distribution");
         }
-        const double max_loss = *std::max_element(loss.begin(), loss.end());
+        const auto& kernels = simd_kernels();
+        return adjust_for_loss(
+            loss,
+            kernels.max_value(loss.data(), m_size),
+            kernels.dot(m_pmf.data(), loss.data(), m_size));
+    }
 
-        double epsilon = 0.0;
-        const auto sz = loss.size();
-        for (size_t k = 0; k != sz; ++k) {
-            epsilon += m_pmf[k] * loss[k];
+    LossUpdate SamplingDist::adjust_for_loss(
+            const std::vector<double>& loss,
+            const double max_loss,
+            const double epsilon) {
+        if (loss.size() != m_size) {
+            throw std::invalid_argument(
+                "Loss vector must be same size as distribution");
         }
-
         const double beta = epsilon / (max_loss - epsilon);
 
-        if (epsilon < 0.5 * max_loss) {
-            std::transform(
-                m_pmf.begin(),
-                m_pmf.end(),
-                loss.begin(),
-                m_pmf.begin(),
-                [beta, max_loss](float pmf_k, double loss_k) {
-                    return (float) (pow(beta, 1 - loss_k / max_loss) * pmf_k);
-                });
-        }  else {
-            //std::cout << "RESET" << std::endl;
-            // reset to uniform distribution
-            reset();
+        LossUpdate update;
+        update.epsilon = epsilon;
+        update.max_loss = max_loss;
+        update.beta = beta;
+
+        if (epsilon < 0.5 * max_loss && beta > 0) {
+            // reweight and sum in one pass, then divide by the sum
+            const auto& kernels = simd_kernels();
+            double lanes[simd_lanes] = { 0 };
+            kernels.reweight_sum_lanes(
+                m_pmf.data(), loss.data(), m_size, std::log(beta), max_loss,
+                lanes);
+            kernels.divide(m_pmf.data(), m_size, simd_lane_total(lanes));
+        } else {
+            if (epsilon < 0.5 * max_loss) {
+                // log(0) is not finite; only the rows at max_loss keep weight
+                std::transform(
+                    m_pmf.begin(),
+                    m_pmf.end(),
+                    loss.begin(),
+                    m_pmf.begin(),
+                    [beta, max_loss](float pmf_k, double loss_k) {
+                        return (float) (pow(beta, 1 - loss_k / max_loss) * pmf_k);
+                    });
+            } else {
+                // reset to uniform distribution
+                reset();
+                update.reset = true;
+            }
+            normalize(m_pmf);
         }
-        normalize(m_pmf);
+        return update;
     }
 
     std::discrete_distribution<size_t>
@@ -68,4 +94,8 @@ namespace oddvibe {
         return std::discrete_distribution<size_t>(m_pmf.begin(), m_pmf.end());
     }
 
+    const std::vector<float>& SamplingDist::weights() const {
+        return m_pmf;
+    }
+
 }
@@ -15,6 +15,7 @@
  */
 #include <vector>
 #include <random>
+#include "round_stats.h"
 
 #ifndef KMBNW_ODVB_SAMPLING_DIST_H
 #define KMBNW_ODVB_SAMPLING_DIST_H
@@ -39,9 +40,29 @@ namespace oddvibe {
              * \loss The loss for each row of input data.  This must be the
              * same size() as the distribution being updated, and will throw
              * an exception if it is not.
+             * \return How the distribution changed.
              * \sa Booster::fit
              */
-            void adjust_for_loss(const std::vector<double>& loss);
+            LossUpdate adjust_for_loss(const std::vector<double>& loss);
+
+            /**
+             * Update the distribution from a loss vector whose max and
+             * pmf-weighted mean are already known.
+             *
+             * This is the second half of adjust_for_loss(), for callers
+             * that compute `max_loss` and `epsilon` while they compute the
+             * loss; the result is the same bit for bit when they are
+             * computed as SimdKernels::max_value and SimdKernels::dot would.
+             *
+             * \param loss The loss for each row of input data.
+             * \param max_loss The largest element of `loss`.
+             * \param epsilon The sum of `weights()[k] * loss[k]`.
+             * \return How the distribution changed.
+             */
+            LossUpdate adjust_for_loss(
+                const std::vector<double>& loss,
+                const double max_loss,
+                const double epsilon);
 
             /**
              * \return A copy of the discrete empirical distribution underlying
@@ -49,6 +70,11 @@ namespace oddvibe {
              */
             std::discrete_distribution<size_t> empirical_dist() const;
 
+            /**
+             * \return The probability of sampling each row, in row order.
+             */
+            const std::vector<float>& weights() const;
+
       private:
             size_t m_size;
             std::vector<float> m_pmf;
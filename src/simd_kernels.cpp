@@ -0,0 +1,680 @@
+/*
+ * Copyright 2017 Krysta M Bouzek
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include "simd_kernels.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define ODDVIBE_X86_SIMD 1
+#include <immintrin.h>
+#endif
+
+// Every kernel must round exactly like its scalar twin, so a compiler must
+// not fuse a multiply and an add into an FMA in one and not the other.
+#ifdef __GNUC__
+#pragma GCC optimize ("fp-contract=off")
+#endif
+
+namespace oddvibe {
+    namespace {
+        constexpr size_t nlanes = simd_lanes;
+
+        // Cephes exp(): exp(x) = 2^n * exp(r) with |r| <= ln(2) / 2 and a
+        // Pade approximation of exp(r).
+        constexpr double exp_min_arg = -700.0;
+        constexpr double exp_max_arg = 700.0;
+        constexpr double log2e = 1.4426950408889634073599;
+        constexpr double ln2_hi = 6.93145751953125E-1;
+        constexpr double ln2_lo = 1.42860682030941723212E-6;
+        constexpr double exp_p0 = 1.26177193074810590878E-4;
+        constexpr double exp_p1 = 3.02994407707441961300E-2;
+        constexpr double exp_p2 = 9.99999999999999999910E-1;
+        constexpr double exp_q0 = 3.00198505138664455042E-6;
+        constexpr double exp_q1 = 2.52448340349684104192E-3;
+        constexpr double exp_q2 = 2.27265548208155028766E-1;
+        constexpr double exp_q3 = 2.00000000000000000009E0;
+        // adding then subtracting this rounds to the nearest integer
+        constexpr double round_shift = 6755399441055744.0;
+        // n + this holds n + 1023 in its low mantissa bits
+        constexpr double exp_bias_shift = 4503599627371519.0;
+
+        double combine_lanes(const double* lanes) {
+            return simd_lane_total(lanes);
+        }
+
+        /**
+         * exp(x), clamped to `[exp_min_arg, exp_max_arg]`; within about
+         * one ulp.
+         */
+        double exp_scalar(double x) {
+            x = std::min(std::max(x, exp_min_arg), exp_max_arg);
+            const double n = (x * log2e + round_shift) - round_shift;
+            x = x - n * ln2_hi;
+            x = x - n * ln2_lo;
+            const double xx = x * x;
+            const double px = x * ((exp_p0 * xx + exp_p1) * xx + exp_p2);
+            const double qx = ((exp_q0 * xx + exp_q1) * xx + exp_q2) * xx +
+                exp_q3;
+            const double r = 1.0 + 2.0 * (px / (qx - px));
+
+            uint64_t bits;
+            const double biased = n + exp_bias_shift;
+            std::memcpy(&bits, &biased, sizeof(bits));
+            bits <<= 52;
+            double scale;
+            std::memcpy(&scale, &bits, sizeof(scale));
+            return r * scale;
+        }
+
+        void squared_error_f32_scalar(
+                const float* observed,
+                const float* predicted,
+                double* loss,
+                const size_t n) {
+            for (size_t k = 0; k != n; ++k) {
+                const double diff = predicted[k] - observed[k];
+                loss[k] = diff * diff;
+            }
+        }
+
+        void squared_error_f64_scalar(
+                const double* observed,
+                const double* predicted,
+                double* loss,
+                const size_t n) {
+            for (size_t k = 0; k != n; ++k) {
+                const double diff = predicted[k] - observed[k];
+                loss[k] = diff * diff;
+            }
+        }
+
+        double max_value_scalar(const double* xs, const size_t n) {
+            return *std::max_element(xs, xs + n);
+        }
+
+        void dot_lanes_scalar(
+                const float* weights,
+                const double* xs,
+                const size_t n,
+                double* lanes) {
+            for (size_t k = 0; k != n; ++k) {
+                lanes[k % nlanes] += static_cast<double>(weights[k]) * xs[k];
+            }
+        }
+
+        double dot_scalar(const float* weights, const double* xs, const size_t n) {
+            double lanes[nlanes] = { 0 };
+            dot_lanes_scalar(weights, xs, n, lanes);
+            return combine_lanes(lanes);
+        }
+
+        void sum_lanes_scalar(const float* xs, const size_t n, double* lanes) {
+            for (size_t k = 0; k != n; ++k) {
+                lanes[k % nlanes] += xs[k];
+            }
+        }
+
+        double sum_scalar(const float* xs, const size_t n) {
+            double lanes[nlanes] = { 0 };
+            sum_lanes_scalar(xs, n, lanes);
+            return combine_lanes(lanes);
+        }
+
+        void reweight_scalar(
+                float* pmf,
+                const double* loss,
+                const size_t n,
+                const double log_beta,
+                const double max_loss) {
+            for (size_t k = 0; k != n; ++k) {
+                const double power = 1.0 - loss[k] / max_loss;
+                pmf[k] = static_cast<float>(
+                    exp_scalar(power * log_beta) * pmf[k]);
+            }
+        }
+
+        void reweight_sum_lanes_scalar(
+                float* pmf,
+                const double* loss,
+                const size_t n,
+                const double log_beta,
+                const double max_loss,
+                double* lanes) {
+            reweight_scalar(pmf, loss, n, log_beta, max_loss);
+            sum_lanes_scalar(pmf, n, lanes);
+        }
+
+        void divide_scalar(float* xs, const size_t n, const double divisor) {
+            for (size_t k = 0; k != n; ++k) {
+                xs[k] = static_cast<float>(xs[k] / divisor);
+            }
+        }
+
+        const SimdKernels scalar_kernels = {
+            SimdLevel::scalar,
+            squared_error_f32_scalar,
+            squared_error_f64_scalar,
+            max_value_scalar,
+            dot_scalar,
+            sum_scalar,
+            reweight_scalar,
+            divide_scalar,
+            dot_lanes_scalar,
+            sum_lanes_scalar,
+            reweight_sum_lanes_scalar
+        };
+
+#ifdef ODDVIBE_X86_SIMD
+        // ---- AVX2: four doubles per register, two registers per 8 lanes
+
+#define ODDVIBE_AVX2 __attribute__((target("avx2")))
+
+        ODDVIBE_AVX2
+        __m256d exp_avx2(__m256d x) {
+            x = _mm256_min_pd(
+                _mm256_max_pd(x, _mm256_set1_pd(exp_min_arg)),
+                _mm256_set1_pd(exp_max_arg));
+            const __m256d shift = _mm256_set1_pd(round_shift);
+            const __m256d n = _mm256_sub_pd(
+                _mm256_add_pd(_mm256_mul_pd(x, _mm256_set1_pd(log2e)), shift),
+                shift);
+            x = _mm256_sub_pd(x, _mm256_mul_pd(n, _mm256_set1_pd(ln2_hi)));
+            x = _mm256_sub_pd(x, _mm256_mul_pd(n, _mm256_set1_pd(ln2_lo)));
+            const __m256d xx = _mm256_mul_pd(x, x);
+
+            __m256d px = _mm256_add_pd(
+                _mm256_mul_pd(_mm256_set1_pd(exp_p0), xx),
+                _mm256_set1_pd(exp_p1));
+            px = _mm256_add_pd(_mm256_mul_pd(px, xx), _mm256_set1_pd(exp_p2));
+            px = _mm256_mul_pd(x, px);
+
+            __m256d qx = _mm256_add_pd(
+                _mm256_mul_pd(_mm256_set1_pd(exp_q0), xx),
+                _mm256_set1_pd(exp_q1));
+            qx = _mm256_add_pd(_mm256_mul_pd(qx, xx), _mm256_set1_pd(exp_q2));
+            qx = _mm256_add_pd(_mm256_mul_pd(qx, xx), _mm256_set1_pd(exp_q3));
+
+            const __m256d r = _mm256_add_pd(
+                _mm256_set1_pd(1.0),
+                _mm256_mul_pd(
+                    _mm256_set1_pd(2.0),
+                    _mm256_div_pd(px, _mm256_sub_pd(qx, px))));
+
+            const __m256i bits = _mm256_slli_epi64(
+                _mm256_castpd_si256(
+                    _mm256_add_pd(n, _mm256_set1_pd(exp_bias_shift))),
+                52);
+            return _mm256_mul_pd(r, _mm256_castsi256_pd(bits));
+        }
+
+        ODDVIBE_AVX2
+        void squared_error_f32_avx2(
+                const float* observed,
+                const float* predicted,
+                double* loss,
+                const size_t n) {
+            size_t k = 0;
+            for (; k + 8 <= n; k += 8) {
+                const __m256 diff = _mm256_sub_ps(
+                    _mm256_loadu_ps(predicted + k),
+                    _mm256_loadu_ps(observed + k));
+                const __m256d lo = _mm256_cvtps_pd(_mm256_castps256_ps128(diff));
+                const __m256d hi = _mm256_cvtps_pd(_mm256_extractf128_ps(diff, 1));
+                _mm256_storeu_pd(loss + k, _mm256_mul_pd(lo, lo));
+                _mm256_storeu_pd(loss + k + 4, _mm256_mul_pd(hi, hi));
+            }
+            squared_error_f32_scalar(observed + k, predicted + k, loss + k, n - k);
+        }
+
+        ODDVIBE_AVX2
+        void squared_error_f64_avx2(
+                const double* observed,
+                const double* predicted,
+                double* loss,
+                const size_t n) {
+            size_t k = 0;
+            for (; k + 4 <= n; k += 4) {
+                const __m256d diff = _mm256_sub_pd(
+                    _mm256_loadu_pd(predicted + k),
+                    _mm256_loadu_pd(observed + k));
+                _mm256_storeu_pd(loss + k, _mm256_mul_pd(diff, diff));
+            }
+            squared_error_f64_scalar(observed + k, predicted + k, loss + k, n - k);
+        }
+
+        ODDVIBE_AVX2
+        double max_value_avx2(const double* xs, const size_t n) {
+            if (n < 4) {
+                return max_value_scalar(xs, n);
+            }
+            __m256d best = _mm256_loadu_pd(xs);
+            size_t k = 4;
+            for (; k + 4 <= n; k += 4) {
+                best = _mm256_max_pd(best, _mm256_loadu_pd(xs + k));
+            }
+            double lanes[4];
+            _mm256_storeu_pd(lanes, best);
+            double result = std::max(
+                std::max(lanes[0], lanes[1]), std::max(lanes[2], lanes[3]));
+            for (; k != n; ++k) {
+                result = std::max(result, xs[k]);
+            }
+            return result;
+        }
+
+        ODDVIBE_AVX2
+        void dot_lanes_avx2(
+                const float* weights,
+                const double* xs,
+                const size_t n,
+                double* lanes) {
+            __m256d acc_lo = _mm256_loadu_pd(lanes);
+            __m256d acc_hi = _mm256_loadu_pd(lanes + 4);
+            size_t k = 0;
+            for (; k + nlanes <= n; k += nlanes) {
+                acc_lo = _mm256_add_pd(acc_lo, _mm256_mul_pd(
+                    _mm256_cvtps_pd(_mm_loadu_ps(weights + k)),
+                    _mm256_loadu_pd(xs + k)));
+                acc_hi = _mm256_add_pd(acc_hi, _mm256_mul_pd(
+                    _mm256_cvtps_pd(_mm_loadu_ps(weights + k + 4)),
+                    _mm256_loadu_pd(xs + k + 4)));
+            }
+            _mm256_storeu_pd(lanes, acc_lo);
+            _mm256_storeu_pd(lanes + 4, acc_hi);
+            dot_lanes_scalar(weights + k, xs + k, n - k, lanes);
+        }
+
+        ODDVIBE_AVX2
+        double dot_avx2(const float* weights, const double* xs, const size_t n) {
+            double lanes[nlanes] = { 0 };
+            dot_lanes_avx2(weights, xs, n, lanes);
+            return combine_lanes(lanes);
+        }
+
+        ODDVIBE_AVX2
+        void sum_lanes_avx2(const float* xs, const size_t n, double* lanes) {
+            __m256d acc_lo = _mm256_loadu_pd(lanes);
+            __m256d acc_hi = _mm256_loadu_pd(lanes + 4);
+            size_t k = 0;
+            for (; k + nlanes <= n; k += nlanes) {
+                acc_lo = _mm256_add_pd(
+                    acc_lo, _mm256_cvtps_pd(_mm_loadu_ps(xs + k)));
+                acc_hi = _mm256_add_pd(
+                    acc_hi, _mm256_cvtps_pd(_mm_loadu_ps(xs + k + 4)));
+            }
+            _mm256_storeu_pd(lanes, acc_lo);
+            _mm256_storeu_pd(lanes + 4, acc_hi);
+            sum_lanes_scalar(xs + k, n - k, lanes);
+        }
+
+        ODDVIBE_AVX2
+        double sum_avx2(const float* xs, const size_t n) {
+            double lanes[nlanes] = { 0 };
+            sum_lanes_avx2(xs, n, lanes);
+            return combine_lanes(lanes);
+        }
+
+        /**
+         * Reweight four pmf values in place and return them as doubles.
+         */
+        ODDVIBE_AVX2
+        __m256d reweight4_avx2(
+                float* pmf,
+                const double* loss,
+                const __m256d max_v,
+                const __m256d log_beta_v) {
+            const __m256d power = _mm256_sub_pd(
+                _mm256_set1_pd(1.0), _mm256_div_pd(_mm256_loadu_pd(loss), max_v));
+            const __m256d scale = exp_avx2(_mm256_mul_pd(power, log_beta_v));
+            const __m256d old = _mm256_cvtps_pd(_mm_loadu_ps(pmf));
+            const __m128 updated = _mm256_cvtpd_ps(_mm256_mul_pd(scale, old));
+            _mm_storeu_ps(pmf, updated);
+            return _mm256_cvtps_pd(updated);
+        }
+
+        ODDVIBE_AVX2
+        void reweight_avx2(
+                float* pmf,
+                const double* loss,
+                const size_t n,
+                const double log_beta,
+                const double max_loss) {
+            const __m256d max_v = _mm256_set1_pd(max_loss);
+            const __m256d log_beta_v = _mm256_set1_pd(log_beta);
+            size_t k = 0;
+            for (; k + 4 <= n; k += 4) {
+                reweight4_avx2(pmf + k, loss + k, max_v, log_beta_v);
+            }
+            reweight_scalar(pmf + k, loss + k, n - k, log_beta, max_loss);
+        }
+
+        ODDVIBE_AVX2
+        void reweight_sum_lanes_avx2(
+                float* pmf,
+                const double* loss,
+                const size_t n,
+                const double log_beta,
+                const double max_loss,
+                double* lanes) {
+            const __m256d max_v = _mm256_set1_pd(max_loss);
+            const __m256d log_beta_v = _mm256_set1_pd(log_beta);
+            __m256d acc_lo = _mm256_loadu_pd(lanes);
+            __m256d acc_hi = _mm256_loadu_pd(lanes + 4);
+            size_t k = 0;
+            for (; k + nlanes <= n; k += nlanes) {
+                acc_lo = _mm256_add_pd(acc_lo, reweight4_avx2(
+                    pmf + k, loss + k, max_v, log_beta_v));
+                acc_hi = _mm256_add_pd(acc_hi, reweight4_avx2(
+                    pmf + k + 4, loss + k + 4, max_v, log_beta_v));
+            }
+            _mm256_storeu_pd(lanes, acc_lo);
+            _mm256_storeu_pd(lanes + 4, acc_hi);
+            reweight_sum_lanes_scalar(
+                pmf + k, loss + k, n - k, log_beta, max_loss, lanes);
+        }
+
+        ODDVIBE_AVX2
+        void divide_avx2(float* xs, const size_t n, const double divisor) {
+            const __m256d div_v = _mm256_set1_pd(divisor);
+            size_t k = 0;
+            for (; k + 4 <= n; k += 4) {
+                const __m256d x = _mm256_cvtps_pd(_mm_loadu_ps(xs + k));
+                _mm_storeu_ps(xs + k, _mm256_cvtpd_ps(_mm256_div_pd(x, div_v)));
+            }
+            divide_scalar(xs + k, n - k, divisor);
+        }
+
+#undef ODDVIBE_AVX2
+
+        const SimdKernels avx2_kernels = {
+            SimdLevel::avx2,
+            squared_error_f32_avx2,
+            squared_error_f64_avx2,
+            max_value_avx2,
+            dot_avx2,
+            sum_avx2,
+            reweight_avx2,
+            divide_avx2,
+            dot_lanes_avx2,
+            sum_lanes_avx2,
+            reweight_sum_lanes_avx2
+        };
+
+        // ---- AVX-512: eight doubles per register, one register per 8 lanes
+
+#define ODDVIBE_AVX512 __attribute__((target("avx512f")))
+
+// GCC warns about the deliberately undefined inputs of some intrinsics
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+
+        ODDVIBE_AVX512
+        __m512d exp_avx512(__m512d x) {
+            x = _mm512_min_pd(
+                _mm512_max_pd(x, _mm512_set1_pd(exp_min_arg)),
+                _mm512_set1_pd(exp_max_arg));
+            const __m512d shift = _mm512_set1_pd(round_shift);
+            const __m512d n = _mm512_sub_pd(
+                _mm512_add_pd(_mm512_mul_pd(x, _mm512_set1_pd(log2e)), shift),
+                shift);
+            x = _mm512_sub_pd(x, _mm512_mul_pd(n, _mm512_set1_pd(ln2_hi)));
+            x = _mm512_sub_pd(x, _mm512_mul_pd(n, _mm512_set1_pd(ln2_lo)));
+            const __m512d xx = _mm512_mul_pd(x, x);
+
+            __m512d px = _mm512_add_pd(
+                _mm512_mul_pd(_mm512_set1_pd(exp_p0), xx),
+                _mm512_set1_pd(exp_p1));
+            px = _mm512_add_pd(_mm512_mul_pd(px, xx), _mm512_set1_pd(exp_p2));
+            px = _mm512_mul_pd(x, px);
+
+            __m512d qx = _mm512_add_pd(
+                _mm512_mul_pd(_mm512_set1_pd(exp_q0), xx),
+                _mm512_set1_pd(exp_q1));
+            qx = _mm512_add_pd(_mm512_mul_pd(qx, xx), _mm512_set1_pd(exp_q2));
+            qx = _mm512_add_pd(_mm512_mul_pd(qx, xx), _mm512_set1_pd(exp_q3));
+
+            const __m512d r = _mm512_add_pd(
+                _mm512_set1_pd(1.0),
+                _mm512_mul_pd(
+                    _mm512_set1_pd(2.0),
+                    _mm512_div_pd(px, _mm512_sub_pd(qx, px))));
+
+            const __m512i bits = _mm512_slli_epi64(
+                _mm512_castpd_si512(
+                    _mm512_add_pd(n, _mm512_set1_pd(exp_bias_shift))),
+                52);
+            return _mm512_mul_pd(r, _mm512_castsi512_pd(bits));
+        }
+
+        ODDVIBE_AVX512
+        void squared_error_f32_avx512(
+                const float* observed,
+                const float* predicted,
+                double* loss,
+                const size_t n) {
+            size_t k = 0;
+            for (; k + 8 <= n; k += 8) {
+                const __m512d diff = _mm512_cvtps_pd(_mm256_sub_ps(
+                    _mm256_loadu_ps(predicted + k),
+                    _mm256_loadu_ps(observed + k)));
+                _mm512_storeu_pd(loss + k, _mm512_mul_pd(diff, diff));
+            }
+            squared_error_f32_scalar(observed + k, predicted + k, loss + k, n - k);
+        }
+
+        ODDVIBE_AVX512
+        void squared_error_f64_avx512(
+                const double* observed,
+                const double* predicted,
+                double* loss,
+                const size_t n) {
+            size_t k = 0;
+            for (; k + 8 <= n; k += 8) {
+                const __m512d diff = _mm512_sub_pd(
+                    _mm512_loadu_pd(predicted + k),
+                    _mm512_loadu_pd(observed + k));
+                _mm512_storeu_pd(loss + k, _mm512_mul_pd(diff, diff));
+            }
+            squared_error_f64_scalar(observed + k, predicted + k, loss + k, n - k);
+        }
+
+        ODDVIBE_AVX512
+        double max_value_avx512(const double* xs, const size_t n) {
+            if (n < 8) {
+                return max_value_scalar(xs, n);
+            }
+            __m512d best = _mm512_loadu_pd(xs);
+            size_t k = 8;
+            for (; k + 8 <= n; k += 8) {
+                best = _mm512_max_pd(best, _mm512_loadu_pd(xs + k));
+            }
+            double result = _mm512_reduce_max_pd(best);
+            for (; k != n; ++k) {
+                result = std::max(result, xs[k]);
+            }
+            return result;
+        }
+
+        ODDVIBE_AVX512
+        void dot_lanes_avx512(
+                const float* weights,
+                const double* xs,
+                const size_t n,
+                double* lanes) {
+            __m512d acc = _mm512_loadu_pd(lanes);
+            size_t k = 0;
+            for (; k + nlanes <= n; k += nlanes) {
+                acc = _mm512_add_pd(acc, _mm512_mul_pd(
+                    _mm512_cvtps_pd(_mm256_loadu_ps(weights + k)),
+                    _mm512_loadu_pd(xs + k)));
+            }
+            _mm512_storeu_pd(lanes, acc);
+            dot_lanes_scalar(weights + k, xs + k, n - k, lanes);
+        }
+
+        ODDVIBE_AVX512
+        double dot_avx512(const float* weights, const double* xs, const size_t n) {
+            double lanes[nlanes] = { 0 };
+            dot_lanes_avx512(weights, xs, n, lanes);
+            return combine_lanes(lanes);
+        }
+
+        ODDVIBE_AVX512
+        void sum_lanes_avx512(const float* xs, const size_t n, double* lanes) {
+            __m512d acc = _mm512_loadu_pd(lanes);
+            size_t k = 0;
+            for (; k + nlanes <= n; k += nlanes) {
+                acc = _mm512_add_pd(acc, _mm512_cvtps_pd(_mm256_loadu_ps(xs + k)));
+            }
+            _mm512_storeu_pd(lanes, acc);
+            sum_lanes_scalar(xs + k, n - k, lanes);
+        }
+
+        ODDVIBE_AVX512
+        double sum_avx512(const float* xs, const size_t n) {
+            double lanes[nlanes] = { 0 };
+            sum_lanes_avx512(xs, n, lanes);
+            return combine_lanes(lanes);
+        }
+
+        /**
+         * Reweight eight pmf values in place and return them as doubles.
+         */
+        ODDVIBE_AVX512
+        __m512d reweight8_avx512(
+                float* pmf,
+                const double* loss,
+                const __m512d max_v,
+                const __m512d log_beta_v) {
+            const __m512d power = _mm512_sub_pd(
+                _mm512_set1_pd(1.0), _mm512_div_pd(_mm512_loadu_pd(loss), max_v));
+            const __m512d scale = exp_avx512(_mm512_mul_pd(power, log_beta_v));
+            const __m512d old = _mm512_cvtps_pd(_mm256_loadu_ps(pmf));
+            const __m256 updated = _mm512_cvtpd_ps(_mm512_mul_pd(scale, old));
+            _mm256_storeu_ps(pmf, updated);
+            return _mm512_cvtps_pd(updated);
+        }
+
+        ODDVIBE_AVX512
+        void reweight_avx512(
+                float* pmf,
+                const double* loss,
+                const size_t n,
+                const double log_beta,
+                const double max_loss) {
+            const __m512d max_v = _mm512_set1_pd(max_loss);
+            const __m512d log_beta_v = _mm512_set1_pd(log_beta);
+            size_t k = 0;
+            for (; k + 8 <= n; k += 8) {
+                reweight8_avx512(pmf + k, loss + k, max_v, log_beta_v);
+            }
+            reweight_scalar(pmf + k, loss + k, n - k, log_beta, max_loss);
+        }
+
+        ODDVIBE_AVX512
+        void reweight_sum_lanes_avx512(
+                float* pmf,
+                const double* loss,
+                const size_t n,
+                const double log_beta,
+                const double max_loss,
+                double* lanes) {
+            const __m512d max_v = _mm512_set1_pd(max_loss);
+            const __m512d log_beta_v = _mm512_set1_pd(log_beta);
+            __m512d acc = _mm512_loadu_pd(lanes);
+            size_t k = 0;
+            for (; k + nlanes <= n; k += nlanes) {
+                acc = _mm512_add_pd(acc, reweight8_avx512(
+                    pmf + k, loss + k, max_v, log_beta_v));
+            }
+            _mm512_storeu_pd(lanes, acc);
+            reweight_sum_lanes_scalar(
+                pmf + k, loss + k, n - k, log_beta, max_loss, lanes);
+        }
+
+        ODDVIBE_AVX512
+        void divide_avx512(float* xs, const size_t n, const double divisor) {
+            const __m512d div_v = _mm512_set1_pd(divisor);
+            size_t k = 0;
+            for (; k + 8 <= n; k += 8) {
+                const __m512d x = _mm512_cvtps_pd(_mm256_loadu_ps(xs + k));
+                _mm256_storeu_ps(xs + k, _mm512_cvtpd_ps(_mm512_div_pd(x, div_v)));
+            }
+            divide_scalar(xs + k, n - k, divisor);
+        }
+
+#pragma GCC diagnostic pop
+#undef ODDVIBE_AVX512
+
+        const SimdKernels avx512_kernels = {
+            SimdLevel::avx512,
+            squared_error_f32_avx512,
+            squared_error_f64_avx512,
+            max_value_avx512,
+            dot_avx512,
+            sum_avx512,
+            reweight_avx512,
+            divide_avx512,
+            dot_lanes_avx512,
+            sum_lanes_avx512,
+            reweight_sum_lanes_avx512
+        };
+#endif
+    }
+
+    const SimdKernels* simd_kernels(const SimdLevel level) {
+        switch (level) {
+            case SimdLevel::scalar:
+                return &scalar_kernels;
+#ifdef ODDVIBE_X86_SIMD
+            case SimdLevel::avx2:
+                return (__builtin_cpu_supports("avx2") ? &avx2_kernels : nullptr);
+            case SimdLevel::avx512:
+                return (
+                    __builtin_cpu_supports("avx512f") ?
+                    &avx512_kernels : nullptr);
+#endif
+            default:
+                return nullptr;
+        }
+    }
+
+    const SimdKernels& simd_kernels() {
+        static const SimdKernels* const best = []() {
+            for (const auto level : { SimdLevel::avx512, SimdLevel::avx2 }) {
+                const auto kernels = simd_kernels(level);
+                if (kernels != nullptr) {
+                    return kernels;
+                }
+            }
+            return &scalar_kernels;
+        }();
+        return *best;
+    }
+
+    const char* simd_level_name(const SimdLevel level) {
+        switch (level) {
+            case SimdLevel::avx2:
+                return "avx2";
+            case SimdLevel::avx512:
+                return "avx512";
+            default:
+                return "scalar";
+        }
+    }
+}
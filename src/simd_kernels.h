@@ -0,0 +1,173 @@
+/*
+ * Copyright 2017 Krysta M Bouzek
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef KMBNW_ODVB_SIMD_KERNELS_H
+#define KMBNW_ODVB_SIMD_KERNELS_H
+
+#include <cstddef>
+
+/*! \file */
+
+namespace oddvibe {
+    /**
+     * Instruction sets that the per-round kernels are built for.
+     */
+    enum class SimdLevel {
+        /**
+         * Plain C++; available everywhere.
+         */
+        scalar,
+
+        /**
+         * 256-bit AVX2 on x86.
+         */
+        avx2,
+
+        /**
+         * 512-bit AVX-512F on x86.
+         */
+        avx512
+    };
+
+    /**
+     * Number of double accumulators that SimdKernels sums are kept in.
+     */
+    constexpr size_t simd_lanes = 8;
+
+    /**
+     * Kernels for the passes over every row that end each boosting round.
+     *
+     * Every implementation returns bit-identical results: sums are kept
+     * in eight interleaved double lanes (element `k` goes to lane `k % 8`)
+     * that are combined in a fixed order, exponentials use the same
+     * rational approximation, and no multiply-add is fused.  The instruction
+     * set in use therefore never changes which rows are sampled.
+     *
+     * The `*_lanes` kernels add into caller-owned lanes instead, so a long
+     * sum can be built up over consecutive blocks of rows and still match
+     * a single call, provided every block but the last has a multiple of
+     * simd_lanes rows; see simd_lane_total().
+     */
+    struct SimdKernels {
+        /**
+         * The instruction set these kernels use.
+         */
+        SimdLevel level;
+
+        /**
+         * `loss[k] = (predicted[k] - observed[k])^2`, with the difference
+         * taken in float and the square in double, as mse_err() does.
+         */
+        void (*squared_error_f32)(
+            const float* observed,
+            const float* predicted,
+            double* loss,
+            size_t n);
+
+        /**
+         * `loss[k] = (predicted[k] - observed[k])^2`.
+         */
+        void (*squared_error_f64)(
+            const double* observed,
+            const double* predicted,
+            double* loss,
+            size_t n);
+
+        /**
+         * \return The largest of `n >= 1` values, none of which may be NaN.
+         */
+        double (*max_value)(const double* xs, size_t n);
+
+        /**
+         * \return The sum of `weights[k] * xs[k]`.
+         */
+        double (*dot)(const float* weights, const double* xs, size_t n);
+
+        /**
+         * \return The sum of `xs[k]`, accumulated in double.
+         */
+        double (*sum)(const float* xs, size_t n);
+
+        /**
+         * `pmf[k] *= beta^(1 - loss[k] / max_loss)`, where
+         * `log_beta = log(beta)` is finite and `max_loss > 0`.
+         */
+        void (*reweight)(
+            float* pmf,
+            const double* loss,
+            size_t n,
+            double log_beta,
+            double max_loss);
+
+        /**
+         * `xs[k] /= divisor`, with the division done in double.
+         */
+        void (*divide)(float* xs, size_t n, double divisor);
+
+        /**
+         * Add `weights[k] * xs[k]` to `lanes[k % simd_lanes]`.
+         */
+        void (*dot_lanes)(
+            const float* weights,
+            const double* xs,
+            size_t n,
+            double* lanes);
+
+        /**
+         * Add `xs[k]` to `lanes[k % simd_lanes]`.
+         */
+        void (*sum_lanes)(const float* xs, size_t n, double* lanes);
+
+        /**
+         * reweight(), then add each new `pmf[k]` to
+         * `lanes[k % simd_lanes]`, in a single pass.
+         */
+        void (*reweight_sum_lanes)(
+            float* pmf,
+            const double* loss,
+            size_t n,
+            double log_beta,
+            double max_loss,
+            double* lanes);
+    };
+
+    /**
+     * \return The total of simd_lanes partial sums, combined in the same
+     * order as the sums returned by SimdKernels.
+     */
+    inline double simd_lane_total(const double* lanes) {
+        return ((lanes[0] + lanes[1]) + (lanes[2] + lanes[3])) +
+            ((lanes[4] + lanes[5]) + (lanes[6] + lanes[7]));
+    }
+
+    /**
+     * \return The kernels for the widest instruction set this CPU supports,
+     * chosen on first use.
+     */
+    const SimdKernels& simd_kernels();
+
+    /**
+     * \return The kernels for a given instruction set, or null if they were
+     * not built or this CPU does not support them.
+     */
+    const SimdKernels* simd_kernels(const SimdLevel level);
+
+    /**
+     * \return A short name for an instruction set, e.g. "avx2".
+     */
+    const char* simd_level_name(const SimdLevel level);
+}
+#endif //KMBNW_ODVB_SIMD_KERNELS_H
@@ -21,10 +21,14 @@
 #include <limits>
 #include <algorithm>
 #include <utility>
-#include <future>
-#include <unordered_set>
+#include <vector>
+#include <iterator>
+#include <cmath>
 #include "math_x.h"
 #include "dataset.h"
+#include "binned_matrix.h"
+#include "column_index.h"
+#include "thread_pool.h"
 
 /*! \file */
 
@@ -79,6 +83,15 @@ namespace oddvibe {
                 return !std::isnan(m_split_val);
             }
 
+            /**
+             * \return True if a row of a feature matrix belongs on the
+             * left hand side of this split, i.e.
+             * `mat(row, split_col()) <= split_val()`.
+             */
+            bool is_left(const FloatMatrix<FloatT>& mat, const size_t row) const {
+                return mat(row, m_split_col) <= m_split_val;
+            }
+
             /**
              * Partition the input sequence according to this instance.
              *
@@ -107,15 +120,311 @@ namespace oddvibe {
                     first,
                     last,
                     [this, &mat](const size_t row){
-                        return mat(row, this->m_split_col) <= this->m_split_val;
+                        return this->is_left(mat, row);
                     });
             }
 
+            /**
+             * Partition the input sequence by bin code.
+             *
+             * The binned counterpart of partition_idx() for a FloatMatrix:
+             * rows whose code in split_col() is no greater than
+             * `bins.bin_of(split_col(), split_val())` come first.  For a
+             * split whose value is a bin edge, such as the splits found by
+             * best_split() on a Histogram, this is the same partition as
+             * the one on the matrix the bins were built from, while reading
+             * 1 or 2 bytes per row instead of a FloatT.
+             *
+             * \param bins Quantized feature matrix.
+             * \param first BidirectionalIterator to the initial position of
+             * the row indexes.
+             * \param last BidirectionalIterator to the final position of
+             * the row indexes.
+             * \return Iterator to the first row of the second group.
+             */
+            template <typename BidirectionalIterator>
+            BidirectionalIterator
+            partition_idx(
+                const BinnedMatrix<FloatT>& bins,
+                BidirectionalIterator first,
+                BidirectionalIterator last)
+            const {
+                const auto code = bins.bin_of(m_split_col, m_split_val);
+                if (bins.code_bytes() == 1) {
+                    return partition_codes(
+                        bins.col_codes8(m_split_col), code, first, last);
+                }
+                return partition_codes(
+                    bins.col_codes16(m_split_col), code, first, last);
+            }
+
         private:
             size_t m_split_col = 0;
             FloatT m_split_val = std::numeric_limits<FloatT>::quiet_NaN();
+
+            template <typename CodeT, typename BidirectionalIterator>
+            static BidirectionalIterator partition_codes(
+                    const CodeT* codes,
+                    const size_t code,
+                    BidirectionalIterator first,
+                    BidirectionalIterator last) {
+                return std::partition(
+                    first,
+                    last,
+                    [codes, code](const size_t row) {
+                        return codes[row] <= code;
+                    });
+            }
     };
 
+    /**
+     * Number of sorted rows that best_split() scans as one unit of work.
+     *
+     * Running sums restart from per-block prefix sums at every block
+     * boundary.  Keeping this fixed (rather than dependent on the number of
+     * threads) makes the chosen split independent of the thread count.
+     */
+    constexpr size_t split_block_rows = 16384;
+
+    /**
+     * Lowest-error split found so far during a split search.
+     */
+    template <typename FloatT>
+    struct SplitCandidate {
+        size_t col = 0;
+        FloatT val = std::numeric_limits<FloatT>::quiet_NaN();
+        double err = std::numeric_limits<double>::max();
+
+        /**
+         * Replace this candidate with `other` if `other` has a strictly
+         * lower error.  Applying this to candidates in (column, value) order
+         * keeps the first of any tied candidates.
+         */
+        void keep_better(const SplitCandidate<FloatT>& other) {
+            if (other.err < err) {
+                *this = other;
+            }
+        }
+    };
+
+    /**
+     * Running weighted sums of the centered response over a range of sorted
+     * rows.
+     */
+    struct BlockSums {
+        double sum = 0;
+        double sum_sq = 0;
+        double weight = 0;
+
+        void add(const BlockSums& other) {
+            sum += other.sum;
+            sum_sq += other.sum_sq;
+            weight += other.weight;
+        }
+    };
+
+    /**
+     * Scratch space for the sorted best_split(), kept between calls so that
+     * repeated searches need not allocate.
+     */
+    template <typename FloatT>
+    struct SplitScratch {
+        // per (column, block) sums, and the sums of the blocks before each
+        std::vector<BlockSums> sums;
+        std::vector<BlockSums> befores;
+        // per column totals
+        std::vector<BlockSums> totals;
+        // per (column, block) lowest-error thresholds
+        std::vector<SplitCandidate<FloatT>> found;
+        // the columns sampled for a node; see TreeParams::node_col_fraction
+        std::vector<size_t> columns;
+    };
+
+    /**
+     * Sum the centered response over the rows of one block.
+     *
+     * \param ys Response vector.
+     * \param weights Weight of each row of `ys`; see UnitWeights.
+     * \param y_center Value subtracted from each response before summing.
+     * \param first RandomAccessIterator to the initial position of
+     * the sorted row indexes of the whole column.
+     * \param count Number of sorted rows in the whole column.
+     * \param block Zero-based block number; see split_block_rows.
+     */
+    template <typename FloatT, typename WeightsT, typename RandomAccessIterator>
+    BlockSums sum_sorted_block(
+            const std::vector<FloatT>& ys,
+            const WeightsT& weights,
+            const double y_center,
+            const RandomAccessIterator first,
+            const size_t count,
+            const size_t block) {
+        const auto begin = block * split_block_rows;
+        const auto end = std::min(count, begin + split_block_rows);
+        BlockSums sums;
+        for (auto k = begin; k < end; ++k) {
+            const double w = weights[first[k]];
+            const double y = ys[first[k]] - y_center;
+            sums.sum += w * y;
+            sums.sum_sq += w * y * y;
+            sums.weight += w;
+        }
+        return sums;
+    }
+
+    /**
+     * Score every threshold that falls inside one block of sorted rows.
+     *
+     * The rows `first[0] .. first[count - 1]` must be sorted by ascending
+     * `xs(row, col)`, with any rows whose feature value is NaN placed at the
+     * end (they always fall on the right).  Thresholds are the feature values
+     * at boundaries between two distinct values.
+     *
+     * \param data Input feature matrix and response vector.
+     * \param weights Weight of each row of `data`; see UnitWeights.
+     * \param col The zero-based feature column the rows are sorted by.
+     * \param y_center Value subtracted from each response before summing.
+     * \param first RandomAccessIterator to the initial position of
+     * the sorted row indexes of the whole column.
+     * \param count Number of sorted rows in the whole column.
+     * \param block Zero-based block number; see split_block_rows.
+     * \param before Sums over all rows of the blocks before this one.
+     * \param total Sums over all rows of the column.
+     * \return The first lowest-error threshold in the block; its error is
+     * the max double value if the block has no valid threshold.
+     */
+    template <typename FloatT, typename WeightsT, typename RandomAccessIterator>
+    SplitCandidate<FloatT> scan_sorted_block(
+            const Dataset<FloatT>& data,
+            const WeightsT& weights,
+            const size_t col,
+            const double y_center,
+            const RandomAccessIterator first,
+            const size_t count,
+            const size_t block,
+            const BlockSums& before,
+            const BlockSums& total) {
+        const FloatMatrix<FloatT>& xs = data.xs();
+        const std::vector<FloatT>& ys = data.ys();
+        const auto begin = block * split_block_rows;
+        const auto end = std::min(count, begin + split_block_rows);
+
+        SplitCandidate<FloatT> best;
+        best.col = col;
+
+        BlockSums left = before;
+        for (auto k = begin; k < end && k + 1 < count; ++k) {
+            const double w = weights[first[k]];
+            const double y = ys[first[k]] - y_center;
+            left.sum += w * y;
+            left.sum_sq += w * y * y;
+            left.weight += w;
+
+            const FloatT value = xs(first[k], col);
+            if (std::isnan(value)) {
+                // NaN rows sort last and always fall on the right
+                break;
+            }
+            const FloatT next_value = xs(first[k + 1], col);
+            if (value == next_value) {
+                // not a boundary between distinct feature values
+                continue;
+            }
+
+            const double err = (
+                sum_sq_err(left.sum, left.sum_sq, left.weight) +
+                sum_sq_err(
+                    total.sum - left.sum,
+                    total.sum_sq - left.sum_sq,
+                    total.weight - left.weight));
+
+            // TODO randomly allow the same error as best to 'win'
+            if (err < best.err) {
+                best.err = err;
+                best.val = value;
+            }
+        }
+        return best;
+    }
+
+    /**
+     * Number of split_block_rows sized blocks needed for `count` rows.
+     */
+    inline size_t split_block_count(const size_t count) {
+        return std::max<size_t>(
+            1, (count + split_block_rows - 1) / split_block_rows);
+    }
+
+    /**
+     * Find the lowest-error threshold for a single feature column.
+     *
+     * The elements from the range `[first, last]` are row indexes that have
+     * already been sorted by ascending `xs(row, col)`, with any rows whose
+     * feature value is NaN placed at the end.  A single pass over running
+     * sums of the response (centered on `y_center` to limit cancellation)
+     * scores every threshold between two distinct feature values.
+     *
+     * \param data Input feature matrix and response vector.
+     * \param weights Weight of each row of `data`; see UnitWeights.
+     * \param col The zero-based feature column the rows are sorted by.
+     * \param y_center Value subtracted from each response before summing;
+     * usually the mean response of the node.
+     * \param first RandomAccessIterator to the initial position of
+     * the sorted row indexes.
+     * \param last RandomAccessIterator to the final position of
+     * the sorted row indexes.
+     * \param sums Scratch space for the sums of each block.
+     * \return The first lowest-error threshold of the column; its error is
+     * the max double value if the column has no valid threshold.
+     */
+    template <typename FloatT, typename WeightsT, typename RandomAccessIterator>
+    SplitCandidate<FloatT> best_sorted_split(
+            const Dataset<FloatT>& data,
+            const WeightsT& weights,
+            const size_t col,
+            const double y_center,
+            const RandomAccessIterator first,
+            const RandomAccessIterator last,
+            std::vector<BlockSums>& sums) {
+        const size_t count = std::distance(first, last);
+        const auto nblocks = split_block_count(count);
+
+        BlockSums total;
+        sums.resize(nblocks);
+        for (size_t block = 0; block != nblocks; ++block) {
+            sums[block] = sum_sorted_block(
+                data.ys(), weights, y_center, first, count, block);
+            total.add(sums[block]);
+        }
+
+        SplitCandidate<FloatT> best;
+        BlockSums before;
+        for (size_t block = 0; block != nblocks; ++block) {
+            best.keep_better(scan_sorted_block(
+                data, weights, col, y_center, first, count, block, before,
+                total));
+            before.add(sums[block]);
+        }
+        return best;
+    }
+
+    /**
+     * Find the lowest-error threshold for a single feature column, as the
+     * other overload, with scratch space of its own.
+     */
+    template <typename FloatT, typename WeightsT, typename RandomAccessIterator>
+    SplitCandidate<FloatT> best_sorted_split(
+            const Dataset<FloatT>& data,
+            const WeightsT& weights,
+            const size_t col,
+            const double y_center,
+            const RandomAccessIterator first,
+            const RandomAccessIterator last) {
+        std::vector<BlockSums> sums;
+        return best_sorted_split(
+            data, weights, col, y_center, first, last, sums);
+    }
+
     /**
      * Create a new "best" SplitPoint.
      *
@@ -128,8 +437,13 @@ namespace oddvibe {
      * "Best" means that for a given feature matrix and rows to consider in
      * that matrix, a binary split done on the feature column and feature value
      * produce the lowest total error.  The lowest total error may not (and
-     * probably is not) unique; this function chooses the first such column and
-     * value that it finds that fulfills the criteria.
+     * probably is not) unique; this function chooses the lowest column and
+     * then the lowest value that fulfills the criteria.
+     *
+     * Each column is handled by sorting the row indexes by feature value
+     * once and scanning running sums of the response, so the cost per node is
+     * `O(ncol * n log n)` rather than one full pass over the rows for every
+     * unique feature value.
      *
      * \param data Input feature matrix and response vector.
      * \param first ForwardIterator to the initial position of
@@ -147,49 +461,151 @@ namespace oddvibe {
             const ForwardIterator first,
             const ForwardIterator last) {
         // TODO min size guard
-        size_t best_col = 0;
-        FloatT best_val = std::numeric_limits<FloatT>::quiet_NaN();
-        double best_err = std::numeric_limits<double>::max();
-
-        std::vector< std::future<double> > futures;
+        SplitCandidate<FloatT> best;
 
+        const FloatMatrix<FloatT>& xs = data.xs();
         const auto ncols = data.ncol();
+        const double y_center = mean<FloatT>(data.ys(), first, last);
 
-        const auto err_fn = [&data, first, last] (
-                const size_t col, const FloatT value) {
-            return data.calc_total_err(col, value, first, last);
-        };
+        std::vector<size_t> rows(first, last);
 
         for (size_t col = 0; col != ncols; ++col) {
-            const auto uniques = data.unique_x(col, first, last);
-            const auto uniq_sz = uniques.size();
-            if (uniq_sz < 2) {
-                continue;
+            const auto is_num = [&xs, col](const size_t row) {
+                return !std::isnan(xs(row, col));
+            };
+            const auto by_value = [&xs, col](const size_t lhs, const size_t rhs) {
+                return xs(lhs, col) < xs(rhs, col);
+            };
+
+            const auto nan_begin = std::partition(
+                rows.begin(), rows.end(), is_num);
+            std::sort(rows.begin(), nan_begin, by_value);
+
+            best.keep_better(best_sorted_split(
+                data, UnitWeights(), col, y_center, rows.begin(), rows.end()));
+        }
+        return SplitPoint<FloatT>(best.col, best.val);
+    }
+
+    /**
+     * Create a new "best" SplitPoint from rows that are already sorted.
+     *
+     * This chooses the same split as the iterator overload of best_split(),
+     * but takes the node's rows from SortedColumns so that no sorting is
+     * needed; each column costs a single pass over the node.
+     *
+     * With a ThreadPool, columns (and blocks of split_block_rows rows within
+     * large columns) are scanned in parallel.  Per-task results are combined
+     * in (column, block) order, so the chosen split does not depend on the
+     * number of threads.
+     *
+     * \param data Input feature matrix and response vector.
+     * \param cols Rows of every node, sorted per column.
+     * \param offset The start of the node's segment within `cols`.
+     * \param count The number of rows in the node.
+     * \param y_center Value subtracted from each response before summing;
+     * usually the mean response of the node.
+     * \param pool Threads to scan columns with, or null to scan them on
+     * the calling thread.
+     * \param weights Weight of each row of `data`; by default every row
+     * counts once per time it appears in `cols`.
+     * \param scratch Scratch space to reuse, or null to allocate it for
+     * this call.
+     * \param columns The columns to consider, in ascending order; each must
+     * be kept by `cols`.  Null considers every column of `cols`.  Work is
+     * proportional to the number of columns considered.
+     * \return A new SplitPoint instance that contains the best-split selection.
+     * If no such split could be found then the value of is_valid() from the
+     * returned SplitPoint will be false.
+     */
+    template <typename FloatT, typename WeightsT = UnitWeights>
+    SplitPoint<FloatT>
+    best_split(
+            const Dataset<FloatT>& data,
+            const SortedColumns& cols,
+            const size_t offset,
+            const size_t count,
+            const double y_center,
+            ThreadPool* pool = nullptr,
+            const WeightsT& weights = WeightsT(),
+            SplitScratch<FloatT>* scratch = nullptr,
+            const std::vector<size_t>* columns = nullptr) {
+        SplitCandidate<FloatT> best;
+        const std::vector<size_t>& search_cols = (
+            columns != nullptr ? *columns : cols.columns());
+        const auto ncols = search_cols.size();
+
+        SplitScratch<FloatT> own_scratch;
+        SplitScratch<FloatT>& space = (
+            scratch != nullptr ? *scratch : own_scratch);
+
+        // too little work to be worth handing to other threads
+        if (pool == nullptr || pool->size() < 2 ||
+                count * ncols < split_block_rows) {
+            for (const auto col : search_cols) {
+                const auto first = cols.begin(col, offset);
+                best.keep_better(best_sorted_split(
+                    data, weights, col, y_center, first, first + count,
+                    space.sums));
             }
+            return SplitPoint<FloatT>(best.col, best.val);
+        }
 
-            futures.clear();
-
-            std::transform(
-                uniques.begin(),
-                uniques.end(),
-                std::back_inserter(futures),
-                [&err_fn, col](const FloatT value) {
-                    return std::async(std::launch::deferred, err_fn, col, value);
-                });
-
-            for (size_t idx = 0; idx != uniq_sz; ++idx) {
-                // total squared error for left and right side of split_val
-                const auto err = futures[idx].get();
-
-                // TODO randomly allow the same error as best to 'win'
-                if (err < best_err) {
-                    best_col = col;
-                    best_val = uniques[idx];
-                    best_err = err;
-                }
+        const auto nblocks = split_block_count(count);
+        const auto ntasks = ncols * nblocks;
+
+        std::vector<BlockSums>& sums = space.sums;
+        sums.resize(ntasks);
+        pool->parallel_for(
+            ntasks,
+            [&](const size_t task) {
+                const auto col = search_cols[task / nblocks];
+                sums[task] = sum_sorted_block(
+                    data.ys(),
+                    weights,
+                    y_center,
+                    cols.begin(col, offset),
+                    count,
+                    task % nblocks);
+            });
+
+        // per-column totals and exclusive prefix sums, in block order
+        std::vector<BlockSums>& totals = space.totals;
+        std::vector<BlockSums>& befores = space.befores;
+        totals.assign(ncols, BlockSums());
+        befores.resize(ntasks);
+        for (size_t k = 0; k != ncols; ++k) {
+            BlockSums& total = totals[k];
+            for (size_t block = 0; block != nblocks; ++block) {
+                const auto task = k * nblocks + block;
+                befores[task] = total;
+                total.add(sums[task]);
             }
         }
-        return SplitPoint<FloatT>(best_col, best_val);
+
+        std::vector<SplitCandidate<FloatT>>& found = space.found;
+        found.resize(ntasks);
+        pool->parallel_for(
+            ntasks,
+            [&](const size_t task) {
+                const auto k = task / nblocks;
+                const auto col = search_cols[k];
+                found[task] = scan_sorted_block(
+                    data,
+                    weights,
+                    col,
+                    y_center,
+                    cols.begin(col, offset),
+                    count,
+                    task % nblocks,
+                    befores[task],
+                    totals[k]);
+            });
+
+        for (const auto& candidate : found) {
+            best.keep_better(candidate);
+        }
+        return SplitPoint<FloatT>(best.col, best.val);
     }
 }
 #endif //KMBNW_ODVB_SPLITPOINT_H
@@ -0,0 +1,135 @@
+/*
+ * Copyright 2017 Krysta M Bouzek
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <exception>
+#include <stdexcept>
+#include "thread_pool.h"
+
+namespace oddvibe {
+    /**
+     * Shared state of a single parallel_for() call.
+     */
+    struct ThreadPool::Loop {
+        const std::function<void(size_t)>* task = nullptr;
+        size_t ntasks = 0;
+        size_t next = 0;
+        size_t finished = 0;
+        std::exception_ptr error;
+    };
+
+    ThreadPool::ThreadPool(const size_t nthreads) : m_nthreads(nthreads) {
+        if (m_nthreads == 0) {
+            m_nthreads = std::thread::hardware_concurrency();
+        }
+        if (m_nthreads == 0) {
+            m_nthreads = 1;
+        }
+        for (size_t k = 1; k < m_nthreads; ++k) {
+            m_workers.emplace_back([this]() { work(); });
+        }
+    }
+
+    ThreadPool::~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> guard(m_lock);
+            m_stop = true;
+        }
+        m_wake.notify_all();
+        for (auto& worker : m_workers) {
+            worker.join();
+        }
+    }
+
+    size_t ThreadPool::size() const {
+        return m_nthreads;
+    }
+
+    void ThreadPool::parallel_for(
+            const size_t ntasks,
+            const std::function<void(size_t)>& task) {
+        if (ntasks == 0) {
+            return;
+        }
+        // lives until every task has finished, after which no other
+        // thread refers to it
+        Loop state;
+        Loop* const loop = &state;
+        loop->task = &task;
+        loop->ntasks = ntasks;
+
+        std::unique_lock<std::mutex> lock(m_lock);
+        m_loops.push_back(loop);
+        m_wake.notify_all();
+
+        // run this loop's tasks while any are unclaimed; after that, help
+        // with the newest other loop until the last of ours finishes, which
+        // may mean waiting for an unrelated task we picked up to end
+        while (loop->finished != loop->ntasks) {
+            if (!run_one(lock, loop)) {
+                m_wake.wait(lock);
+            }
+        }
+
+        if (loop->error) {
+            std::rethrow_exception(loop->error);
+        }
+    }
+
+    void ThreadPool::work() {
+        std::unique_lock<std::mutex> lock(m_lock);
+        while (!m_stop) {
+            if (!run_one(lock)) {
+                m_wake.wait(lock);
+            }
+        }
+    }
+
+    bool ThreadPool::run_one(
+            std::unique_lock<std::mutex>& lock,
+            Loop* const own) {
+        if (m_loops.empty()) {
+            return false;
+        }
+
+        // the caller's own loop first, then the newest loop: it is the most
+        // deeply nested one
+        Loop* const loop = (
+            own != nullptr && own->next != own->ntasks ? own : m_loops.back());
+        const auto idx = loop->next++;
+        if (loop->next == loop->ntasks) {
+            // loops whose tasks have all been claimed need no more help
+            m_loops.erase(std::find(m_loops.begin(), m_loops.end(), loop));
+        }
+
+        lock.unlock();
+        std::exception_ptr error;
+        try {
+            (*loop->task)(idx);
+        } catch (...) {
+            error = std::current_exception();
+        }
+        lock.lock();
+
+        if (error && !loop->error) {
+            loop->error = error;
+        }
+        if (++loop->finished == loop->ntasks) {
+            m_wake.notify_all();
+        }
+        return true;
+    }
+}
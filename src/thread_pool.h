@@ -0,0 +1,132 @@
+/*
+ * Copyright 2017 Krysta M Bouzek
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef KMBNW_ODVB_THREAD_POOL_H
+#define KMBNW_ODVB_THREAD_POOL_H
+
+#include <cstddef>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+/*! \file */
+
+namespace oddvibe {
+    /**
+     * Fixed-size pool of worker threads for data-parallel loops.
+     *
+     * A thread that calls parallel_for() takes part in running its tasks,
+     * and once they have all been claimed, while waiting for other threads
+     * to finish them, it runs tasks from the newest other loop in the pool.
+     * parallel_for() may therefore be called from inside a task without
+     * risk of deadlock.  Loops share one last-in, first-out list rather
+     * than per-thread queues, so a waiting caller may pick up a long
+     * unrelated task and return only after it ends.
+     */
+    class ThreadPool {
+        public:
+            /**
+             * Create a new pool.
+             *
+             * \param nthreads Total number of threads that run tasks,
+             * including the calling thread; `nthreads - 1` workers are
+             * started.  Zero means one per hardware thread.
+             */
+            explicit ThreadPool(const size_t nthreads);
+
+            ThreadPool(ThreadPool&& other) = delete;
+            ThreadPool& operator=(ThreadPool&& other) = delete;
+
+            ThreadPool(const ThreadPool& other) = delete;
+            ThreadPool& operator=(const ThreadPool& other) = delete;
+
+            /**
+             * Stop and join all worker threads.
+             */
+            ~ThreadPool();
+
+            /**
+             * \return Number of threads that run tasks, including the
+             * calling thread.
+             */
+            size_t size() const;
+
+            /**
+             * Run `task(k)` for every `k` in `[0, ntasks)` and wait for all of
+             * them to finish.
+             *
+             * Tasks run in no particular order and on no particular thread;
+             * callers that need deterministic results should have each task
+             * write to its own output slot and combine the slots in index
+             * order afterwards.  If any task throws, the remaining tasks are
+             * still run and the first exception is rethrown here.
+             *
+             * \param ntasks Number of tasks.
+             * \param task Function to call with each task index.
+             */
+            void parallel_for(
+                const size_t ntasks,
+                const std::function<void(size_t)>& task);
+
+            /**
+             * Run `task(k)` for every `k` in `[0, ntasks)`, as the other
+             * overload, without copying `task`; wrapping a reference in the
+             * std::function never allocates, however much the task captures.
+             */
+            template <typename TaskT>
+            void parallel_for(const size_t ntasks, const TaskT& task) {
+                parallel_for(
+                    ntasks, std::function<void(size_t)>(std::cref(task)));
+            }
+
+        private:
+            struct Loop;
+
+            size_t m_nthreads;
+            std::vector<std::thread> m_workers;
+            // loops that still have unclaimed tasks, oldest first
+            std::vector<Loop*> m_loops;
+            std::mutex m_lock;
+            std::condition_variable m_wake;
+            bool m_stop = false;
+
+            void work();
+            bool run_one(
+                std::unique_lock<std::mutex>& lock,
+                Loop* const own = nullptr);
+    };
+
+    /**
+     * Call `task(k)` for every `k` in `[0, ntasks)`, on `pool` if there is
+     * one and on the calling thread otherwise.
+     */
+    template <typename TaskT>
+    void parallel_for(
+            ThreadPool* pool,
+            const size_t ntasks,
+            const TaskT& task) {
+        if (pool == nullptr || pool->size() < 2 || ntasks < 2) {
+            for (size_t k = 0; k != ntasks; ++k) {
+                task(k);
+            }
+        } else {
+            pool->parallel_for(ntasks, task);
+        }
+    }
+}
+#endif //KMBNW_ODVB_THREAD_POOL_H